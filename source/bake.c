@@ -0,0 +1,726 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+
+#include "bake.h"
+#include "pool.h"
+
+/*of the longest side, added around the bounds*/
+#define BAKE_MARGIN		0.125f
+
+/*points per brick, one packet through scene_sample*/
+#define BRICK_POINTS	( BAKE_BRICK * BAKE_BRICK * BAKE_BRICK )
+
+/*random points the report compares*/
+#define REPORT_POINTS	65536
+
+typedef struct
+{
+	bake_t			*bake;
+	const scene_t	*scene;
+	const sdf_t		*sdf;
+	float			voxel;
+
+	/*distance at the center of every brick, then the bricks near a surface*/
+	float			*centers;
+	unsigned int	*used;
+
+	/*one per worker, each job only writes the one of the worker running it*/
+	int				*errs;
+	unsigned int	workers;
+} job_t;
+
+/*****************************************************************************/
+/*locals*/
+/* half float no larger than f, so baked distances stay conservative */
+static unsigned short 
+half_down( const float f )
+{
+	union { float f; unsigned int u; } v;
+	unsigned int	sign, mag;
+	int				exp;
+
+	v.f = f;
+	sign = ( v.u >> 16 ) & 0x8000;
+	exp = (int)( ( v.u >> 23 ) & 0xff ) - 127 + 15;
+	mag = v.u & 0x7fffff;
+
+	if ( exp >= 31 ) {
+		return (unsigned short)( sign | 0x7bff );
+	}
+
+	if ( exp <= 0 ) {
+		return (unsigned short)( sign ? 0x8400 : 0 );
+	}
+
+	/*truncation rounds positive values down and negative ones up*/
+	mag = ( (unsigned int)exp << 10 ) | ( mag >> 13 );
+	if ( sign && ( v.u & 0x1fff ) && mag < 0x7bff ) {
+		mag++;
+	}
+
+	return (unsigned short)( sign | mag );
+}
+
+static float 
+half_float( const unsigned short h )
+{
+	union { float f; unsigned int u; } v;
+	unsigned int exp = ( h >> 10 ) & 0x1f;
+
+	if ( exp == 0 ) {
+		v.u = (unsigned int)( h & 0x8000 ) << 16;
+		return v.f;
+	}
+
+	v.u = ( (unsigned int)( h & 0x8000 ) << 16 ) | ( ( exp - 15 + 127 ) << 23 ) | ( (unsigned int)( h & 0x3ff ) << 13 );
+
+	return v.f;
+}
+
+/* ERR when any worker failed */
+static int 
+job_err( const job_t *job )
+{
+	unsigned int	i;
+	int				err = OK;
+
+	for ( i = 0; i < job->workers; i++ ) {
+		err |= job->errs[i];
+	}
+
+	return err;
+}
+
+/* the static primitives at count points */
+static void 
+bake_points( const job_t *job, float *d, const float *px, const float *py, const float *pz, float *scratch, const unsigned int count )
+{
+	unsigned int i;
+
+	for ( i = 0; i < job->scene->baked; i++ ) {
+		scene_sample( &job->scene->prims[i], job->sdf, i == 0, d, px, py, pz, scratch, scratch + count, count );
+	}
+}
+
+/* one z slice of the dense volume, a row of x at a time */
+static void 
+bake_slice( void *userdata, const unsigned int z, const unsigned int worker )
+{
+	job_t			*job = (job_t *)userdata;
+	bake_t			*bake = job->bake;
+	float			*scratch, *px, *py, *pz, *d;
+	unsigned int	x, y, n = bake->size[0];
+
+	scratch = (float *)malloc( n * 8 * sizeof(float) );
+	if ( !scratch ) {
+		job->errs[worker] = ERR;
+		return;
+	}
+
+	px = scratch;
+	py = px + n;
+	pz = py + n;
+	d = pz + n;
+
+	for ( x = 0; x < n; x++ ) {
+		px[x] = bake->lo[_x_] + ( x + 0.5f ) * job->voxel;
+		pz[x] = bake->lo[_z_] + ( z + 0.5f ) * job->voxel;
+	}
+
+	for ( y = 0; y < bake->size[1]; y++ ) {
+		unsigned short *out = bake->voxels + ( z * bake->size[1] + y ) * n;
+
+		for ( x = 0; x < n; x++ ) {
+			py[x] = bake->lo[_y_] + ( y + 0.5f ) * job->voxel;
+		}
+
+		bake_points( job, d, px, py, pz, d + n, n );
+
+		for ( x = 0; x < n; x++ ) {
+			out[x] = half_down( d[x] );
+		}
+	}
+
+	free( scratch );
+}
+
+/* one z slice of brick centers */
+static void 
+bake_centers( void *userdata, const unsigned int z, const unsigned int worker )
+{
+	job_t			*job = (job_t *)userdata;
+	bake_t			*bake = job->bake;
+	const float		span = job->voxel * ( BAKE_BRICK - 1 );
+	float			*scratch, *px, *py, *pz;
+	unsigned int	x, y, n = bake->bricks[0];
+
+	scratch = (float *)malloc( n * 7 * sizeof(float) );
+	if ( !scratch ) {
+		job->errs[worker] = ERR;
+		return;
+	}
+
+	px = scratch;
+	py = px + n;
+	pz = py + n;
+
+	for ( x = 0; x < n; x++ ) {
+		px[x] = bake->lo[_x_] + ( x + 0.5f ) * span;
+		pz[x] = bake->lo[_z_] + ( z + 0.5f ) * span;
+	}
+
+	for ( y = 0; y < bake->bricks[1]; y++ ) {
+		for ( x = 0; x < n; x++ ) {
+			py[x] = bake->lo[_y_] + ( y + 0.5f ) * span;
+		}
+
+		bake_points( job, job->centers + ( z * bake->bricks[1] + y ) * n, px, py, pz, pz + n, n );
+	}
+
+	free( scratch );
+}
+
+/* every sample of one brick near a surface, into its place in the atlas */
+static void 
+bake_brick( void *userdata, const unsigned int brick, const unsigned int worker )
+{
+	job_t			*job = (job_t *)userdata;
+	bake_t			*bake = job->bake;
+	const unsigned short *entry = bake->index + job->used[brick] * 4;
+	float			*scratch, *px, *py, *pz, *d;
+	unsigned int	b[3], slot[3], x, y, z, i;
+	int				a;
+
+	scratch = (float *)malloc( BRICK_POINTS * 8 * sizeof(float) );
+	if ( !scratch ) {
+		job->errs[worker] = ERR;
+		return;
+	}
+
+	px = scratch;
+	py = px + BRICK_POINTS;
+	pz = py + BRICK_POINTS;
+	d = pz + BRICK_POINTS;
+
+	b[0] = job->used[brick] % bake->bricks[0];
+	b[1] = job->used[brick] / bake->bricks[0] % bake->bricks[1];
+	b[2] = job->used[brick] / bake->bricks[0] / bake->bricks[1];
+
+	for ( i = 0, z = 0; z < BAKE_BRICK; z++ ) {
+		for ( y = 0; y < BAKE_BRICK; y++ ) {
+			for ( x = 0; x < BAKE_BRICK; x++, i++ ) {
+				px[i] = bake->lo[_x_] + ( b[0] * ( BAKE_BRICK - 1 ) + x ) * job->voxel;
+				py[i] = bake->lo[_y_] + ( b[1] * ( BAKE_BRICK - 1 ) + y ) * job->voxel;
+				pz[i] = bake->lo[_z_] + ( b[2] * ( BAKE_BRICK - 1 ) + z ) * job->voxel;
+			}
+		}
+	}
+
+	bake_points( job, d, px, py, pz, d + BRICK_POINTS, BRICK_POINTS );
+
+	for ( a = 0; a < 3; a++ ) {
+		slot[a] = (unsigned int)half_float( entry[a] ) * BAKE_BRICK;
+	}
+
+	for ( i = 0, z = 0; z < BAKE_BRICK; z++ ) {
+		for ( y = 0; y < BAKE_BRICK; y++ ) {
+			unsigned short *out = bake->voxels + ( ( slot[2] + z ) * bake->size[1] + slot[1] + y ) * bake->size[0] + slot[0];
+
+			for ( x = 0; x < BAKE_BRICK; x++, i++ ) {
+				out[x] = half_down( d[i] );
+			}
+		}
+	}
+
+	free( scratch );
+}
+
+/* bricks near a surface get a place in the atlas, the others their least distance */
+static int 
+bake_sparse( bake_t *bake, job_t *job, pool_t *pool )
+{
+	const float		half = job->voxel * ( BAKE_BRICK - 1 ) * sqrtf( 3.0f ) * 0.5f;
+	unsigned int	count = bake->bricks[0] * bake->bricks[1] * bake->bricks[2];
+	unsigned int	i, side;
+	unsigned short	*entry;
+
+	bake->index = (unsigned short *)malloc( count * 4 * sizeof(unsigned short) );
+	job->centers = (float *)malloc( count * sizeof(float) );
+	job->used = (unsigned int *)malloc( count * sizeof(unsigned int) );
+	if ( !bake->index || !job->centers || !job->used ) {
+		return ERR;
+	}
+
+	pool_for( pool, bake->bricks[2], bake_centers, job );
+	if ( job_err( job ) != OK ) {
+		return ERR;
+	}
+
+	/*bricks the surface passes through, give or take a voxel diagonal*/
+	for ( i = 0; i < count; i++ ) {
+		if ( fabsf( job->centers[i] ) <= half + bake->error ) {
+			job->used[bake->used++] = i;
+		}
+	}
+
+	for ( side = 1; side * side * side < bake->used; side++ );
+
+	bake->size[0] = side * BAKE_BRICK;
+	bake->size[1] = side * BAKE_BRICK;
+	bake->size[2] = ( ( bake->used + side * side - 1 ) / ( side * side ) ) * BAKE_BRICK;
+	if ( bake->used == 0 ) {
+		bake->size[2] = BAKE_BRICK;
+	}
+
+	for ( i = 0; i < count; i++ ) {
+		entry = bake->index + i * 4;
+		entry[0] = entry[1] = entry[2] = half_down( -1.0f );
+		entry[3] = half_down( job->centers[i] - half );
+	}
+
+	for ( i = 0; i < bake->used; i++ ) {
+		entry = bake->index + job->used[i] * 4;
+		entry[0] = half_down( (float)( i % side ) );
+		entry[1] = half_down( (float)( i / side % side ) );
+		entry[2] = half_down( (float)( i / side / side ) );
+	}
+
+	bake->voxels = (unsigned short *)calloc( bake->size[0] * bake->size[1] * bake->size[2], sizeof(unsigned short) );
+	if ( !bake->voxels ) {
+		return ERR;
+	}
+
+	pool_for( pool, bake->used, bake_brick, job );
+
+	return OK;
+}
+
+/* least distance anywhere in every voxel or brick, the base of the min pyramid */
+static void 
+mip_base( const bake_t *bake, unsigned short *base )
+{
+	const unsigned short *entry, *brick;
+	unsigned int	i, x, y, z, count;
+	float			least;
+
+	if ( !bake->sparse ) {
+		count = bake->size[0] * bake->size[1] * bake->size[2];
+		for ( i = 0; i < count; i++ ) {
+			base[i] = half_down( half_float( bake->voxels[i] ) - bake->error * 0.5f );
+		}
+		return;
+	}
+
+	count = bake->bricks[0] * bake->bricks[1] * bake->bricks[2];
+	for ( i = 0; i < count; i++ ) {
+		entry = bake->index + i * 4;
+		if ( half_float( entry[0] ) < 0.0f ) {
+			base[i] = entry[3];
+			continue;
+		}
+
+		brick = bake->voxels + ( (unsigned int)half_float( entry[2] ) * BAKE_BRICK * bake->size[1] + (unsigned int)half_float( entry[1] ) * BAKE_BRICK ) * bake->size[0] + (unsigned int)half_float( entry[0] ) * BAKE_BRICK;
+		least = FLT_MAX;
+
+		for ( z = 0; z < BAKE_BRICK; z++ ) {
+			for ( y = 0; y < BAKE_BRICK; y++ ) {
+				for ( x = 0; x < BAKE_BRICK; x++ ) {
+					float d = half_float( brick[( z * bake->size[1] + y ) * bake->size[0] + x] );
+					least = d < least ? d : least;
+				}
+			}
+		}
+
+		/*no point of a brick is further than half a voxel diagonal from a sample*/
+		base[i] = half_down( least - bake->error * 0.5f );
+	}
+}
+
+/* every level of the min pyramid from the base, least over the children */
+static int 
+bake_pyramid( bake_t *bake )
+{
+	unsigned short	*child, *parent;
+	unsigned int	cs[3], ps[3], lo[3], hi[3], c[3], p[3];
+	unsigned int	level, top = 0, count = 0;
+	float			least;
+	int				a;
+
+	for ( a = 0; a < 3; a++ ) {
+		cs[a] = bake->sparse ? bake->bricks[a] : bake->size[a];
+		top = cs[a] > top ? cs[a] : top;
+	}
+
+	for ( bake->levels = 0; top >> bake->levels; bake->levels++ ) {
+		count += ( cs[0] >> bake->levels ? cs[0] >> bake->levels : 1 ) * ( cs[1] >> bake->levels ? cs[1] >> bake->levels : 1 ) * ( cs[2] >> bake->levels ? cs[2] >> bake->levels : 1 );
+	}
+
+	bake->mips = (unsigned short *)malloc( count * sizeof(unsigned short) );
+	if ( !bake->mips ) {
+		return ERR;
+	}
+
+	mip_base( bake, bake->mips );
+
+	for ( level = 1; level < bake->levels; level++ ) {
+		child = bake_mip( bake, level - 1, cs );
+		parent = bake_mip( bake, level, ps );
+
+		for ( p[2] = 0; p[2] < ps[2]; p[2]++ ) {
+			for ( p[1] = 0; p[1] < ps[1]; p[1]++ ) {
+				for ( p[0] = 0; p[0] < ps[0]; p[0]++ ) {
+					for ( a = 0; a < 3; a++ ) {
+						lo[a] = p[a] * 2;
+						hi[a] = p[a] == ps[a] - 1 ? cs[a] : lo[a] + 2;
+					}
+
+					least = FLT_MAX;
+					for ( c[2] = lo[2]; c[2] < hi[2]; c[2]++ ) {
+						for ( c[1] = lo[1]; c[1] < hi[1]; c[1]++ ) {
+							for ( c[0] = lo[0]; c[0] < hi[0]; c[0]++ ) {
+								float d = half_float( child[( c[2] * cs[1] + c[1] ) * cs[0] + c[0]] );
+								least = d < least ? d : least;
+							}
+						}
+					}
+
+					parent[( p[2] * ps[1] + p[1] ) * ps[0] + p[0]] = half_down( least );
+				}
+			}
+		}
+	}
+
+	return OK;
+}
+
+static float 
+texel( const bake_t *bake, int x, int y, int z )
+{
+	const int sx = (int)bake->size[0], sy = (int)bake->size[1], sz = (int)bake->size[2];
+
+	x = x < 0 ? 0 : ( x >= sx ? sx - 1 : x );
+	y = y < 0 ? 0 : ( y >= sy ? sy - 1 : y );
+	z = z < 0 ? 0 : ( z >= sz ? sz - 1 : z );
+
+	return half_float( bake->voxels[( z * bake->size[1] + y ) * bake->size[0] + x] );
+}
+
+/* linear filtering of texel centers at t, in texels */
+static float 
+trilinear( const bake_t *bake, const vec3_t t )
+{
+	float	f[3], d = 0.0f, w;
+	int		i[3], c, a;
+
+	for ( a = 0; a < 3; a++ ) {
+		i[a] = (int)floorf( t[a] );
+		f[a] = t[a] - i[a];
+	}
+
+	for ( c = 0; c < 8; c++ ) {
+		w = 1.0f;
+		for ( a = 0; a < 3; a++ ) {
+			w *= ( c >> a ) & 1 ? f[a] : 1.0f - f[a];
+		}
+
+		d += w * texel( bake, i[0] + ( c & 1 ), i[1] + ( ( c >> 1 ) & 1 ), i[2] + ( ( c >> 2 ) & 1 ) );
+	}
+
+	return d;
+}
+
+/* index entry of the brick around p, b in bricks */
+static const unsigned short* 
+bake_entry( const bake_t *bake, const vec3_t p, vec3_t b )
+{
+	int i[3], a;
+
+	for ( a = 0; a < 3; a++ ) {
+		b[a] = ( p[a] - bake->lo[a] ) / bake->extent[a] * bake->bricks[a];
+		i[a] = (int)b[a] < (int)bake->bricks[a] ? (int)b[a] : (int)bake->bricks[a] - 1;
+		b[a] -= i[a];
+	}
+
+	return bake->index + ( ( i[2] * bake->bricks[1] + i[1] ) * bake->bricks[0] + i[0] ) * 4;
+}
+
+static float 
+report_random( unsigned int *seed )
+{
+	*seed = *seed * 1664525u + 1013904223u;
+
+	return ( *seed >> 8 ) / 16777216.0f;
+}
+
+/*****************************************************************************/
+/*exports*/
+int 
+bake_build( bake_t *bake, const scene_t *scene, const unsigned int voxels, const unsigned int threads )
+{
+	job_t			job;
+	pool_t			*pool;
+	vec3_t			lo, hi, plo, phi;
+	float			side = 0.0f, span;
+	unsigned int	i, dense = 1;
+	int				a, err = OK;
+
+	memset( bake, 0, sizeof(bake_t) );
+	memset( &job, 0, sizeof(job_t) );
+
+	if ( scene->baked == 0 || voxels == 0 ) {
+		return OK;
+	}
+
+	for ( a = 0; a < 3; a++ ) {
+		lo[a] = FLT_MAX;
+		hi[a] = -FLT_MAX;
+	}
+
+	/*unbounded shapes such as planes are sampled inside the bounds of the rest*/
+	for ( i = 0; i < scene->baked; i++ ) {
+		if ( !scene_bounds( &scene->prims[i], NULL, plo, phi ) ) {
+			continue;
+		}
+
+		for ( a = 0; a < 3; a++ ) {
+			lo[a] = plo[a] < lo[a] ? plo[a] : lo[a];
+			hi[a] = phi[a] > hi[a] ? phi[a] : hi[a];
+		}
+	}
+
+	for ( a = 0; a < 3; a++ ) {
+		side = hi[a] - lo[a] > side ? hi[a] - lo[a] : side;
+	}
+
+	job.voxel = side * ( 1.0f + BAKE_MARGIN * 2.0f ) / voxels;
+	bake->error = job.voxel * sqrtf( 3.0f );
+
+	for ( a = 0; a < 3; a++ ) {
+		bake->size[a] = (unsigned int)ceilf( ( hi[a] - lo[a] + side * BAKE_MARGIN * 2.0f ) / job.voxel );
+		dense *= bake->size[a];
+	}
+
+	/*past the budget the samples sit on brick corners instead of voxel centers*/
+	bake->sparse = dense * sizeof(unsigned short) > BAKE_DENSE_MAX;
+	span = bake->sparse ? job.voxel * ( BAKE_BRICK - 1 ) : job.voxel;
+
+	for ( a = 0; a < 3; a++ ) {
+		bake->bricks[a] = bake->sparse ? ( bake->size[a] + BAKE_BRICK - 2 ) / ( BAKE_BRICK - 1 ) : bake->size[a];
+		bake->extent[a] = bake->bricks[a] * span;
+		bake->lo[a] = ( lo[a] + hi[a] - bake->extent[a] ) * 0.5f;
+	}
+
+	pool = pool_create( threads );
+	if ( !pool ) {
+		return ERR;
+	}
+
+	job.bake = bake;
+	job.scene = scene;
+	job.sdf = sdf_select();
+	job.workers = pool_workers( pool );
+	job.errs = (int *)calloc( job.workers, sizeof(int) );
+	if ( !job.errs ) {
+		pool_destroy( pool );
+		return ERR;
+	}
+
+	if ( bake->sparse ) {
+		err = bake_sparse( bake, &job, pool );
+	}
+	else {
+		memcpy( bake->size, bake->bricks, sizeof(bake->size) );
+		memset( bake->bricks, 0, sizeof(bake->bricks) );
+
+		bake->voxels = (unsigned short *)malloc( dense * sizeof(unsigned short) );
+		if ( bake->voxels ) {
+			pool_for( pool, bake->size[2], bake_slice, &job );
+		}
+		else {
+			err = ERR;
+		}
+	}
+
+	pool_destroy( pool );
+	err |= job_err( &job );
+	free( job.errs );
+	free( job.centers );
+	free( job.used );
+
+	if ( err == OK ) {
+		err = bake_pyramid( bake );
+	}
+
+	if ( err != OK ) {
+		bake_release( bake );
+		return ERR;
+	}
+
+	return OK;
+}
+
+void 
+bake_release( bake_t *bake )
+{
+	free( bake->voxels );
+	free( bake->index );
+	free( bake->mips );
+	memset( bake, 0, sizeof(bake_t) );
+}
+
+unsigned short* 
+bake_mip( const bake_t *bake, const unsigned int level, unsigned int size[3] )
+{
+	unsigned short	*mip = bake->mips;
+	unsigned int	l;
+	int				a;
+
+	for ( l = 0; l <= level; l++ ) {
+		if ( l > 0 ) {
+			mip += size[0] * size[1] * size[2];
+		}
+
+		for ( a = 0; a < 3; a++ ) {
+			size[a] = bake->sparse ? bake->bricks[a] : bake->size[a];
+			size[a] = size[a] >> l ? size[a] >> l : 1;
+		}
+	}
+
+	return mip;
+}
+
+bool 
+bake_sample( const bake_t *bake, const vec3_t p, float *d )
+{
+	const unsigned short *entry;
+	vec3_t	b, t;
+	int		a;
+
+	for ( a = 0; a < 3; a++ ) {
+		b[a] = ( p[a] - bake->lo[a] ) / bake->extent[a];
+		if ( b[a] < 0.0f || b[a] > 1.0f ) {
+			return FALSE;
+		}
+	}
+
+	if ( !bake->sparse ) {
+		for ( a = 0; a < 3; a++ ) {
+			t[a] = b[a] * bake->size[a] - 0.5f;
+		}
+
+		*d = trilinear( bake, t );
+		return TRUE;
+	}
+
+	entry = bake_entry( bake, p, b );
+	if ( half_float( entry[0] ) < 0.0f ) {
+		*d = half_float( entry[3] );
+		return TRUE;
+	}
+
+	for ( a = 0; a < 3; a++ ) {
+		t[a] = half_float( entry[a] ) * BAKE_BRICK + b[a] * ( BAKE_BRICK - 1 );
+	}
+
+	*d = trilinear( bake, t );
+
+	return TRUE;
+}
+
+void 
+bake_report( const bake_t *bake, const scene_t *scene )
+{
+	job_t			job;
+	float			*scratch, *px, *py, *pz, *d;
+	vec3_t			p, b;
+	double			dense, bytes, sum = 0.0, slack = 0.0;
+	float			s, e, worst = 0.0f;
+	unsigned int	i, count = 0, empty = 0, over = 0, seed = 1;
+	unsigned int	bricks = bake->bricks[0] * bake->bricks[1] * bake->bricks[2];
+	int				a;
+
+	if ( !bake->voxels ) {
+		return;
+	}
+
+	/*the dense volume the same samples would take*/
+	dense = 1.0;
+	for ( a = 0; a < 3; a++ ) {
+		dense *= bake->sparse ? bake->bricks[a] * ( BAKE_BRICK - 1 ) + 1 : bake->size[a];
+	}
+	dense *= sizeof(unsigned short);
+
+	bytes = (double)bake->size[0] * bake->size[1] * bake->size[2] * sizeof(unsigned short);
+
+	if ( bake->sparse ) {
+		bytes += bricks * 4 * sizeof(unsigned short);
+
+		fprintf( stdout, "bake: %u of %ux%ux%u bricks used (%.1f%%), %u bytes per brick and %u per index entry\n",
+				 bake->used, bake->bricks[0], bake->bricks[1], bake->bricks[2], 100.0 * bake->used / bricks,
+				 (unsigned int)( BRICK_POINTS * sizeof(unsigned short) ), (unsigned int)( 4 * sizeof(unsigned short) ) );
+	}
+
+	fprintf( stdout, "bake: %.2f MB against %.2f MB dense (%.1fx)\n", bytes / 1048576.0, dense / 1048576.0, dense / bytes );
+
+	if ( bake->mips ) {
+		unsigned int top[3];
+		const unsigned short *end = bake_mip( bake, bake->levels - 1, top ) + top[0] * top[1] * top[2];
+
+		fprintf( stdout, "bake: %u levels of min pyramid, %.2f MB\n", bake->levels, ( end - bake->mips ) * sizeof(unsigned short) / 1048576.0 );
+	}
+
+	scratch = (float *)malloc( REPORT_POINTS * 9 * sizeof(float) );
+	if ( !scratch ) {
+		return;
+	}
+
+	px = scratch;
+	py = px + REPORT_POINTS;
+	pz = py + REPORT_POINTS;
+	d = pz + REPORT_POINTS;
+
+	for ( i = 0; i < REPORT_POINTS; i++ ) {
+		px[i] = bake->lo[_x_] + report_random( &seed ) * bake->extent[_x_];
+		py[i] = bake->lo[_y_] + report_random( &seed ) * bake->extent[_y_];
+		pz[i] = bake->lo[_z_] + report_random( &seed ) * bake->extent[_z_];
+	}
+
+	memset( &job, 0, sizeof(job_t) );
+	job.scene = scene;
+	job.sdf = sdf_select();
+	bake_points( &job, d, px, py, pz, d + REPORT_POINTS, REPORT_POINTS );
+
+	/*interpolated samples against the scene, the bounds of empty bricks only have to stay below it*/
+	for ( i = 0; i < REPORT_POINTS; i++ ) {
+		p[_x_] = px[i];
+		p[_y_] = py[i];
+		p[_z_] = pz[i];
+		if ( !bake_sample( bake, p, &s ) ) {
+			continue;
+		}
+
+		if ( bake->sparse && half_float( bake_entry( bake, p, b )[0] ) < 0.0f ) {
+			slack += d[i] - s;
+			over += s > d[i];
+			empty++;
+			continue;
+		}
+
+		e = fabsf( s - d[i] );
+		sum += e;
+		worst = e > worst ? e : worst;
+		over += s - bake->error > d[i];
+		count++;
+	}
+
+	fprintf( stdout, "bake: %u samples, error mean %.4f max %.4f against %.4f allowed\n", count, count ? sum / count : 0.0, worst, bake->error );
+	if ( bake->sparse ) {
+		fprintf( stdout, "bake: %u in empty bricks, bound %.4f below the scene on average\n", empty, empty ? slack / empty : 0.0 );
+	}
+	fprintf( stdout, "bake: %u of %u random points over the scene\n", over, REPORT_POINTS );
+
+	free( scratch );
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#ifndef __bake_h_
+#define __bake_h_
+
+#include "scene.h"
+
+/*samples per side of a brick, neighbours share their faces, has to match BAKE_BRICK in frag.glsl*/
+#define BAKE_BRICK		8
+
+/*dense volumes up to this many bytes, brick maps past it*/
+#define BAKE_DENSE_MAX	( 16 * 1024 * 1024 )
+
+/*
+	the leading static primitives of a scene sampled into the _bake texture of frag.glsl,
+	as half floats rounded down so samples never overstate the distance
+
+	dense: size[] voxels sampled at their centers, x first, then y, then z
+
+	bricks: the volume is cut into bricks[] bricks of BAKE_BRICK^3 samples on their
+	corners; the ones near a surface are sampled into the atlas, the others only keep
+	the least distance any of their points can have; index holds one rgba half per
+	brick, the atlas position of the brick in bricks or -1, and that distance
+*/
+typedef struct
+{
+	unsigned short	*voxels;
+	unsigned int	size[3];
+
+	bool			sparse;
+	unsigned short	*index;
+	unsigned int	bricks[3];
+	unsigned int	used;
+
+	vec3_t			lo;
+	/*world size of the volume*/
+	vec3_t			extent;
+	/*voxel diagonal, trilinear samples are never further than that from scene_dist()*/
+	float			error;
+
+	/*
+		min pyramid, the _bake_mip texture: level 0 holds the least distance anywhere in
+		each voxel, or brick, every level above the least of its children; the last texel
+		of a row also takes the odd child, so it reaches to the end of the volume
+	*/
+	unsigned short	*mips;
+	unsigned int	levels;
+} bake_t;
+
+/* voxels along the longest side of the bounds plus a margin, threads 0 for one per core */
+int		bake_build( bake_t *bake, const scene_t *scene, const unsigned int voxels, const unsigned int threads );
+void	bake_release( bake_t *bake );
+
+/* texels of a level of the min pyramid, size[] set to its dimensions */
+unsigned short	*bake_mip( const bake_t *bake, const unsigned int level, unsigned int size[3] );
+
+/* the trilinear sample frag.glsl takes at p, before the error is taken off, FALSE outside */
+bool	bake_sample( const bake_t *bake, const vec3_t p, float *d );
+
+/* bytes, brick occupancy and the error against scene_sample() at random points near surfaces */
+void	bake_report( const bake_t *bake, const scene_t *scene );
+
+#endif/*__bake_h_*/
\ No newline at end of file
@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+
+#include "bvh.h"
+
+typedef struct
+{
+	unsigned int	prim;
+	vec3_t			lo;
+	vec3_t			hi;
+} leaf_t;
+
+/*****************************************************************************/
+/*locals*/
+static void 
+leaf_bounds( leaf_t *leaf, const scene_prim_t *prim, scene_value_fn value )
+{
+	int i;
+
+	if ( !scene_bounds( prim, value, leaf->lo, leaf->hi ) ) {
+		for ( i = 0; i < 3; i++ ) {
+			leaf->lo[i] = -FLT_MAX;
+			leaf->hi[i] = FLT_MAX;
+		}
+	}
+}
+
+static void 
+node_merge( bvh_node_t *node, const bvh_node_t *a, const bvh_node_t *b )
+{
+	int i;
+
+	for ( i = 0; i < 3; i++ ) {
+		node->lo[i] = a->lo[i] < b->lo[i] ? a->lo[i] : b->lo[i];
+		node->hi[i] = a->hi[i] > b->hi[i] ? a->hi[i] : b->hi[i];
+	}
+}
+
+static int			sort_axis;
+
+static int 
+leaf_compare( const void *a, const void *b )
+{
+	const leaf_t *la = (const leaf_t *)a;
+	const leaf_t *lb = (const leaf_t *)b;
+	float ca = la->lo[sort_axis] + la->hi[sort_axis];
+	float cb = lb->lo[sort_axis] + lb->hi[sort_axis];
+
+	return ( ca > cb ) - ( ca < cb );
+}
+
+/* median split on the longest axis of the leaf centers, returns the node after the subtree */
+static unsigned int 
+node_build( bvh_node_t *nodes, unsigned int node, leaf_t *leaves, const unsigned int count )
+{
+	vec3_t			lo, hi;
+	unsigned int	i, half, second;
+	int				a;
+
+	if ( count == 1 ) {
+		memcpy( nodes[node].lo, leaves[0].lo, sizeof(vec3_t) );
+		memcpy( nodes[node].hi, leaves[0].hi, sizeof(vec3_t) );
+		nodes[node].prim = (int)leaves[0].prim;
+		nodes[node].skip = node + 1;
+
+		return node + 1;
+	}
+
+	for ( a = 0; a < 3; a++ ) {
+		lo[a] = FLT_MAX;
+		hi[a] = -FLT_MAX;
+
+		for ( i = 0; i < count; i++ ) {
+			float c = ( leaves[i].lo[a] + leaves[i].hi[a] ) * 0.5f;
+
+			lo[a] = c < lo[a] ? c : lo[a];
+			hi[a] = c > hi[a] ? c : hi[a];
+		}
+	}
+
+	sort_axis = 0;
+	for ( a = 1; a < 3; a++ ) {
+		if ( hi[a] - lo[a] > hi[sort_axis] - lo[sort_axis] ) {
+			sort_axis = a;
+		}
+	}
+
+	qsort( leaves, count, sizeof(leaf_t), leaf_compare );
+
+	half = count / 2;
+	second = node_build( nodes, node + 1, leaves, half );
+
+	nodes[node].prim = -1;
+	nodes[node].skip = node_build( nodes, second, leaves + half, count - half );
+	node_merge( &nodes[node], &nodes[node + 1], &nodes[second] );
+
+	return nodes[node].skip;
+}
+
+/*****************************************************************************/
+/*exports*/
+int 
+bvh_build( bvh_t *bvh, const scene_t *scene, scene_value_fn value )
+{
+	leaf_t			*leaves;
+	unsigned int	i, end, count, node = 0;
+
+	bvh->nodes = NULL;
+	bvh->count = 0;
+	bvh->dynamic = FALSE;
+
+	if ( scene->runs == 0 ) {
+		return OK;
+	}
+
+	for ( i = 0; i < scene->count; i++ ) {
+		if ( scene->prims[i].run >= 0 ) {
+			bvh->count += 2;
+			bvh->dynamic |= scene_dynamic( &scene->prims[i] );
+		}
+	}
+	bvh->count -= scene->runs;
+
+	bvh->nodes = (bvh_node_t *)calloc( bvh->count, sizeof(bvh_node_t) );
+	leaves = (leaf_t *)malloc( scene->count * sizeof(leaf_t) );
+	if ( !bvh->nodes || !leaves ) {
+		free( leaves );
+		bvh_release( bvh );
+		return ERR;
+	}
+
+	for ( i = 0; i < scene->count; i = end ) {
+		for ( end = i, count = 0; end < scene->count && scene->prims[end].run == scene->prims[i].run; end++, count++ ) {
+			leaves[count].prim = end;
+			leaf_bounds( &leaves[count], &scene->prims[end], value );
+		}
+
+		if ( scene->prims[i].run >= 0 ) {
+			node = node_build( bvh->nodes, node, leaves, count );
+		}
+	}
+
+	free( leaves );
+
+	return OK;
+}
+
+bool 
+bvh_refit( bvh_t *bvh, const scene_t *scene, scene_value_fn value )
+{
+	leaf_t			leaf;
+	bvh_node_t		*node, old;
+	unsigned int	i;
+	bool			changed = FALSE;
+
+	if ( !bvh->dynamic ) {
+		return FALSE;
+	}
+
+	/*children come after their parent, so backwards every child is final before its parent*/
+	for ( i = bvh->count; i-- > 0; ) {
+		node = &bvh->nodes[i];
+		old = *node;
+
+		if ( node->prim >= 0 ) {
+			if ( !scene_dynamic( &scene->prims[node->prim] ) ) {
+				continue;
+			}
+
+			leaf_bounds( &leaf, &scene->prims[node->prim], value );
+			memcpy( node->lo, leaf.lo, sizeof(vec3_t) );
+			memcpy( node->hi, leaf.hi, sizeof(vec3_t) );
+		}
+		else {
+			node_merge( node, &bvh->nodes[i + 1], &bvh->nodes[bvh->nodes[i + 1].skip] );
+		}
+
+		changed |= memcmp( &old, node, sizeof(bvh_node_t) ) != 0;
+	}
+
+	return changed;
+}
+
+void 
+bvh_release( bvh_t *bvh )
+{
+	free( bvh->nodes );
+	bvh->nodes = NULL;
+	bvh->count = 0;
+	bvh->dynamic = FALSE;
+}
\ No newline at end of file
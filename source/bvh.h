@@ -0,0 +1,37 @@
+#ifndef __bvh_h_
+#define __bvh_h_
+
+#include "scene.h"
+
+/*
+	one node of the _bvh shader storage buffer, std430 layout of bvh_node_t in frag.glsl
+
+	nodes of a run are depth first: a node's first child is the next node, the second
+	one follows the first child's subtree; skip is the node after the subtree, where the
+	walk goes when the box is further than the scene so far
+*/
+typedef struct
+{
+	float	lo[3];
+	int		prim;	/*scene index for leaves, -1 for inner nodes*/
+	float	hi[3];
+	int		skip;
+} bvh_node_t;
+
+typedef struct
+{
+	bvh_node_t		*nodes;
+	unsigned int	count;
+	/*some bounds follow glsl names, refit every frame*/
+	bool			dynamic;
+} bvh_t;
+
+/* runs of the scene one after the other, unknown values give boxes that never cull */
+int		bvh_build( bvh_t *bvh, const scene_t *scene, scene_value_fn value );
+
+/* bounds of moving primitives updated in place, the tree stays; TRUE when a node changed */
+bool	bvh_refit( bvh_t *bvh, const scene_t *scene, scene_value_fn value );
+
+void	bvh_release( bvh_t *bvh );
+
+#endif/*__bvh_h_*/
\ No newline at end of file
@@ -1,14 +1,23 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 #include "core.h"
+#include "stats.h"
 
 #define BUFSIZE			64
 
 static GLFWwindow*		wnd = NULL;
 static unsigned int		mouse_buttons = 0;
 
+/*headless offscreen target*/
+static bool				headless = FALSE;
+static GLuint			fbo = 0;
+static GLuint			fbo_color = 0;
+static unsigned int		fbo_width = 0;
+static unsigned int		fbo_height = 0;
+
 static RDFInitF         rdf_init = NULL;
 static RDFFinishF		rdf_finish = NULL;
 static RDFKeysF			rdf_keys = NULL;
@@ -63,6 +72,17 @@ check_opengl_version( int major, int minor )
 static void 
 wnd_destroy()
 {
+	if ( fbo ) {
+		glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+		glDeleteFramebuffers( 1, &fbo );
+		fbo = 0;
+	}
+
+	if ( fbo_color ) {
+		glDeleteRenderbuffers( 1, &fbo_color );
+		fbo_color = 0;
+	}
+
 	if ( wnd != NULL )
 	{
 		glfwMakeContextCurrent( NULL );
@@ -146,6 +166,36 @@ wnd_keys( GLFWwindow *wnd, int key, int scancode, int action, int flags )
 	case GLFW_KEY_F5:
 		rdfkey = RDFKEY_F5;
 		break;
+	case GLFW_KEY_F2:
+		rdfkey = RDFKEY_F2;
+		break;
+	case GLFW_KEY_F3:
+		rdfkey = RDFKEY_F3;
+		break;
+	case GLFW_KEY_F4:
+		rdfkey = RDFKEY_F4;
+		break;
+	case GLFW_KEY_F6:
+		rdfkey = RDFKEY_F6;
+		break;
+	case GLFW_KEY_F7:
+		rdfkey = RDFKEY_F7;
+		break;
+	case GLFW_KEY_F8:
+		rdfkey = RDFKEY_F8;
+		break;
+	case GLFW_KEY_F9:
+		rdfkey = RDFKEY_F9;
+		break;
+	case GLFW_KEY_F10:
+		rdfkey = RDFKEY_F10;
+		break;
+	case GLFW_KEY_F11:
+		rdfkey = RDFKEY_F11;
+		break;
+	case GLFW_KEY_F12:
+		rdfkey = RDFKEY_F12;
+		break;
 	case GLFW_KEY_W:
 		rdfkey = RDFKEY_W;
 		break;
@@ -208,6 +258,8 @@ wnd_finish( void )
 		rdf_finish();
 	}
 
+	stats_release();
+
 	wnd_destroy( wnd );
 }
 
@@ -218,6 +270,7 @@ wnd_loop( void )
 	float	time, delta, prevtime = .0f;
 	float	frame_time = .0f;
 	int		fps = 0;
+	int		present = stats_stage( "present" );
 
 	char	buf[BUFSIZE];
 	
@@ -232,7 +285,7 @@ wnd_loop( void )
 		fps++;
 
 		if ( frame_time > 1.0f ) {
-			_snprintf_s( buf, BUFSIZE, BUFSIZE, "RDF - %d fps", fps );
+			_snprintf_s( buf, BUFSIZE, BUFSIZE, "RDF - %d fps, cpu %.2f ms, gpu %.2f ms", fps, stats_frame_cpu_ms(), stats_frame_gpu_ms() );
 			glfwSetWindowTitle( wnd, buf );
 
 			fps = 0;
@@ -243,11 +296,18 @@ wnd_loop( void )
 			rdf_time( time );
 		}
 
+		stats_frame_begin();
+
 		if ( rdf_update != NULL && !glfwGetWindowAttrib( wnd, GLFW_ICONIFIED ) ) {
 			rdf_update();
 		}
 
+		stats_begin( present );
 		glfwSwapBuffers( wnd );
+		stats_end( present );
+
+		stats_frame_end();
+
 		glfwPollEvents();
 
 		if ( glfwWindowShouldClose( wnd ) ) {
@@ -270,8 +330,157 @@ run( void )
 	return OK;
 }
 
+/* nearest-rank percentile of a sorted sample set */
+static double 
+bench_percentile( const double *sorted, const unsigned int count, const double pct )
+{
+	unsigned int rank = (unsigned int)ceil( pct / 100.0 * count );
+
+	if ( rank < 1 ) {
+		rank = 1;
+	}
+
+	return sorted[rank - 1];
+}
+
+static int 
+bench_cmp( const void *a, const void *b )
+{
+	double da = *(const double *)a;
+	double db = *(const double *)b;
+
+	return ( da > db ) - ( da < db );
+}
+
+static void 
+bench_report( const char *name, double *samples, const unsigned int count )
+{
+	qsort( samples, count, sizeof(double), bench_cmp );
+
+	fprintf( stdout, "%-4s min %8.3f  p50 %8.3f  p99 %8.3f  max %8.3f ms\n", 
+			 name, 
+			 samples[0], 
+			 bench_percentile( samples, count, 50.0 ), 
+			 bench_percentile( samples, count, 99.0 ), 
+			 samples[count - 1] );
+}
+
+/* saves the headless target, rows are flipped to top first */
+static int 
+bench_capture( const char *path )
+{
+	unsigned char	*rgb;
+	unsigned int	row;
+	int				status;
+
+	rgb = (unsigned char *)malloc( fbo_width * fbo_height * 3 );
+	if ( !rgb ) {
+		return ERR;
+	}
+
+	glBindFramebuffer( GL_READ_FRAMEBUFFER, fbo );
+	glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+
+	for ( row = 0; row < fbo_height; row++ ) {
+		glReadPixels( 0, fbo_height - 1 - row, fbo_width, 1, GL_RGB, GL_UNSIGNED_BYTE, rgb + row * fbo_width * 3 );
+	}
+
+	status = SOIL_save_image( path, SOIL_SAVE_TYPE_BMP, fbo_width, fbo_height, 3, rgb ) ? OK : ERR;
+	if ( status != OK ) {
+		fprintf( stderr, "could not write \"%s\"\n", path );
+	}
+
+	free( rgb );
+
+	return status;
+}
+
+/* fixed frame count, fixed time step, no swap; gpu results are read back once at the end */
+int 
+run_bench( const unsigned int frames, const float step, const char *capture )
+{
+	GLuint		*queries;
+	GLuint64	elapsed;
+	double		*cpu, *gpu;
+	double		start;
+	unsigned int i;
+
+	if ( wnd == NULL || !headless || frames == 0 ) {
+		return ERR;
+	}
+
+	queries = (GLuint *)calloc( frames, sizeof(GLuint) );
+	cpu = (double *)calloc( frames, sizeof(double) );
+	gpu = (double *)calloc( frames, sizeof(double) );
+
+	if ( !queries || !cpu || !gpu ) {
+		free( queries );
+		free( cpu );
+		free( gpu );
+		return ERR;
+	}
+
+	wnd_init();
+
+	glGenQueries( frames, queries );
+
+	/*untimed first frame, absorbs lazy shader and resource setup in the driver*/
+	glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+	if ( rdf_update != NULL ) {
+		rdf_update();
+	}
+	glFinish();
+
+	for ( i = 0; i < frames; i++ ) {
+		glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+
+		if ( rdf_time != NULL ) {
+			rdf_time( step * i );
+		}
+
+		start = glfwGetTime();
+		glBeginQuery( GL_TIME_ELAPSED, queries[i] );
+
+		if ( rdf_update != NULL ) {
+			rdf_update();
+		}
+
+		glEndQuery( GL_TIME_ELAPSED );
+		glFlush();
+		cpu[i] = ( glfwGetTime() - start ) * 1000.0;
+	}
+
+	glFinish();
+
+	if ( capture != NULL ) {
+		bench_capture( capture );
+	}
+
+	fprintf( stdout, "frame\tcpu_ms\tgpu_ms\n" );
+	for ( i = 0; i < frames; i++ ) {
+		glGetQueryObjectui64v( queries[i], GL_QUERY_RESULT, &elapsed );
+		gpu[i] = (double)elapsed / 1000000.0;
+
+		fprintf( stdout, "%u\t%.3f\t%.3f\n", i, cpu[i], gpu[i] );
+	}
+
+	fprintf( stdout, "%u frames at %ux%u, step %.4f s\n", frames, fbo_width, fbo_height, step );
+	bench_report( "cpu", cpu, frames );
+	bench_report( "gpu", gpu, frames );
+
+	glDeleteQueries( frames, queries );
+
+	free( queries );
+	free( cpu );
+	free( gpu );
+
+	wnd_finish();
+
+	return OK;
+}
+
 static int 
-wnd_create( const char *title, const unsigned int width, const unsigned int height, const bool fullscreen )
+wnd_create( const char *title, const unsigned int width, const unsigned int height, const bool fullscreen, const bool visible )
 {
 	const GLFWvidmode	*system;
 
@@ -304,8 +513,10 @@ wnd_create( const char *title, const unsigned int width, const unsigned int heig
 	glfwWindowHint( GLFW_CONTEXT_VERSION_MAJOR, OGL_VER_MAJOR );
 	glfwWindowHint( GLFW_CONTEXT_VERSION_MINOR, OGL_VER_MINOR );
 	glfwWindowHint( GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE );
-	glfwWindowHint( GLFW_SAMPLES, 16 );
+	/*single sampled, frames are resolved with glBlitFramebuffer*/
+	glfwWindowHint( GLFW_SAMPLES, 0 );
 	glfwWindowHint( GLFW_RESIZABLE, GL_TRUE );
+	glfwWindowHint( GLFW_VISIBLE, visible ? GL_TRUE : GL_FALSE );
 
 	wnd = glfwCreateWindow( wnd_width, wnd_height, title, display, NULL );
 	if ( wnd == NULL ) {
@@ -347,6 +558,12 @@ wnd_create( const char *title, const unsigned int width, const unsigned int heig
 void 
 wnd_size( int *width, int *height )
 {
+	if ( headless ) {
+		*width = fbo_width;
+		*height = fbo_height;
+		return;
+	}
+
 	glfwGetWindowSize( wnd, width, height );
 
 	if ( *width < 1 ) {
@@ -358,11 +575,55 @@ wnd_size( int *width, int *height )
 	}
 }
 
+GLuint 
+wnd_framebuffer( void )
+{
+	return fbo;
+}
+
 /*TODO: add cmdline params*/
 int 
 setup_opengl( void )
 {
-	return wnd_create( "RDF_GL", 800, 600, FALSE );
+	return wnd_create( "RDF_GL", 800, 600, FALSE, TRUE );
+}
+
+/*
+	hidden window used only for its context, all rendering goes to fbo;
+	glfw 3.0 has no windowless context, so this still needs a display
+*/
+int 
+setup_headless( const unsigned int width, const unsigned int height )
+{
+	GLenum	status;
+
+	if ( wnd_create( "RDF_GL", width, height, FALSE, FALSE ) != OK ) {
+		fprintf( stderr, "headless mode needs a display for its hidden window, e.g. run it under xvfb-run\n" );
+		return ERR;
+	}
+
+	fprintf( stderr, "GL_RENDERER: %s\n", (char *)glGetString( GL_RENDERER ) );
+
+	glGenRenderbuffers( 1, &fbo_color );
+	glBindRenderbuffer( GL_RENDERBUFFER, fbo_color );
+	glRenderbufferStorage( GL_RENDERBUFFER, GL_RGBA8, width, height );
+
+	glGenFramebuffers( 1, &fbo );
+	glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+	glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, fbo_color );
+
+	status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+	if ( status != GL_FRAMEBUFFER_COMPLETE ) {
+		fprintf( stderr, "headless framebuffer incomplete (0x%x)\n", status );
+		wnd_destroy();
+		return ERR;
+	}
+
+	headless = TRUE;
+	fbo_width = width;
+	fbo_height = height;
+
+	return OK;
 }
 
 void 
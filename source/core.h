@@ -44,7 +44,17 @@ typedef unsigned char	bool;
 #define RDFKEY_RIGHT			14
 #define RDFKEY_DOWN				15
 #define RDFKEY_UP				16
-#define RDFKEY_UNUSED			17
+#define RDFKEY_F2				17
+#define RDFKEY_F3				18
+#define RDFKEY_F4				19
+#define RDFKEY_F6				20
+#define RDFKEY_F7				21
+#define RDFKEY_F8				22
+#define RDFKEY_F9				23
+#define RDFKEY_F10				24
+#define RDFKEY_F11				25
+#define RDFKEY_F12				26
+#define RDFKEY_UNUSED			27
 
 #define GLFW_KEY_MOUSECLICK_LEFT	GLFW_KEY_LAST + 1
 #define GLFW_KEY_MOUSECLICK_RIGHT	GLFW_KEY_LAST + 2
@@ -68,7 +78,10 @@ void	set_mouse(RDFMouseF callback);
 void	set_mouse_scroll(RDFMouseScrollF callback);
 
 void	wnd_size(int*, int*);
+GLuint	wnd_framebuffer(void);
 int		setup_opengl(void);
+int		setup_headless(const unsigned int width, const unsigned int height);
 int		run(void);
+int		run_bench(const unsigned int frames, const float step, const char *capture);
 
 #endif/*__core_h_*/
@@ -0,0 +1,815 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "pool.h"
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <time.h>
+#endif/*_WIN32*/
+
+/*keep in sync with frag.glsl*/
+#define FOV			2.5f
+#define GAMMA		2.2f
+
+#define TR_EPSILON	1e-3f
+#define NEPSILON	1e-3f
+#define VIEW_DIST	128.0f
+#define MAX_STEPS	256
+
+#define VIS_START	( TR_EPSILON * 5.0f )
+#define VIS_SS		32.0f
+#define VIS_STEPS	64
+#define OCC_STEPS	5
+
+#define MAT_SKY			-1.0f
+#define MAT_RED			1.0f
+#define MAT_BLUE		2.0f
+#define MAT_GREEN		3.0f
+#define MAT_OBSIDIAN	4.0f
+#define MAT_PEARL		4.5f
+#define MAT_EMERALD		4.6f
+#define MAT_ALUMINIUM	4.7f
+#define MAT_FLESH		5.0f
+#define MAT_GOLD		5.5f
+#define MAT_TEX2_2D		7.0f
+#define MAT_TEX1_3D		6.5f
+#define MAT_TEX2_3D		8.5f
+#define MAT_OCEAN		9.0f
+#define MAT_MOSS		10.0f
+#define MAT_MOSS_TEX	10.5f
+#define MAT_FLOOR_TEX	11.0f
+
+/*pixels per tile side, one tile is one pool job*/
+#define TILE_SIZE	16
+
+static const vec3_t SUN_COL = { 1.00f, 1.00f, 1.00f };
+static const vec3_t SKY_COL = { 0.02f, 0.22f, 0.52f };
+static const vec3_t HOR_COL = { 0.32f, 0.32f, 0.32f };
+
+typedef struct
+{
+	float	dist;
+	float	mat;
+} de_t;
+
+typedef struct
+{
+	vec3_t	albedo;
+	float	fr0;
+	float	gloss;
+} mat_t;
+
+typedef struct
+{
+	vec3_t	pos;
+	vec3_t	nor;
+	vec3_t	rd;
+	float	mat;
+	float	dist;
+} point_t;
+
+/*per frame constants, the globals at the top of frag.glsl*/
+typedef struct
+{
+	float	time;
+	float	halftime;
+	float	quartertime;
+	float	time8;
+	float	sinhalftime;
+	float	coshalftime;
+	float	sinpacky;
+	vec3_t	sun;
+} state_t;
+
+typedef struct
+{
+	unsigned char		*rgb;
+	unsigned int		width;
+	unsigned int		height;
+	unsigned int		tiles_x;
+	const cpu_camera_t	*camera;
+	state_t				state;
+} job_t;
+
+typedef struct
+{
+	int				width;
+	int				height;
+	unsigned char	*data;
+} texture_t;
+
+static texture_t	textures[CPU_TEXTURES];
+
+/*****************************************************************************/
+/*glsl helpers*/
+static RDFINLINE float 
+clampf( const float v, const float lo, const float hi )
+{
+	return ( v < lo ) ? lo : ( ( v > hi ) ? hi : v );
+}
+
+static RDFINLINE float 
+maxf( const float a, const float b )
+{
+	return ( a > b ) ? a : b;
+}
+
+static RDFINLINE float 
+minf( const float a, const float b )
+{
+	return ( a < b ) ? a : b;
+}
+
+static RDFINLINE float 
+mixf( const float a, const float b, const float t )
+{
+	return a + ( b - a ) * t;
+}
+
+static RDFINLINE void 
+vec3_set( vec3_t dest, const float x, const float y, const float z )
+{
+	dest[_x_] = x;
+	dest[_y_] = y;
+	dest[_z_] = z;
+}
+
+/* dest = a + b * s */
+static RDFINLINE void 
+vec3_madd( vec3_t dest, const vec3_t a, const vec3_t b, const float s )
+{
+	dest[_x_] = a[_x_] + b[_x_] * s;
+	dest[_y_] = a[_y_] + b[_y_] * s;
+	dest[_z_] = a[_z_] + b[_z_] * s;
+}
+
+static RDFINLINE float 
+vec3_dist( const vec3_t a, const vec3_t b )
+{
+	vec3_t d;
+
+	vec3_sub( d, a, b );
+
+	return vec3_length( d );
+}
+
+/*rotations use radians and the sign convention of frag.glsl*/
+static RDFINLINE void 
+rotate_y( vec3_t dest, const vec3_t v, const float angle )
+{
+	float cosa = cosf( angle );
+	float sina = sinf( angle );
+	float x = v[_x_], y = v[_y_], z = v[_z_];
+
+	dest[_x_] = cosa * x - sina * z;
+	dest[_y_] = y;
+	dest[_z_] = sina * x + cosa * z;
+}
+
+static RDFINLINE void 
+rotate_z( vec3_t dest, const vec3_t v, const float angle )
+{
+	float cosa = cosf( angle );
+	float sina = sinf( angle );
+	float x = v[_x_], y = v[_y_], z = v[_z_];
+
+	dest[_x_] = cosa * x - sina * y;
+	dest[_y_] = sina * x + cosa * y;
+	dest[_z_] = z;
+}
+
+/*****************************************************************************/
+/*distance primitives*/
+static RDFINLINE float 
+de_sphere( const vec3_t p, const vec3_t o, const float r )
+{
+	return vec3_dist( o, p ) - r;
+}
+
+static RDFINLINE float 
+de_plane( const vec3_t p, const vec3_t n, const float h )
+{
+	return vec3_dot( p, n ) + h;
+}
+
+static RDFINLINE float 
+de_segment( const vec3_t p, const vec3_t a, const vec3_t b, const float r )
+{
+	vec3_t pa, ba, d;
+	float h;
+
+	vec3_sub( pa, p, a );
+	vec3_sub( ba, b, a );
+	h = clampf( vec3_dot( pa, ba ) / vec3_dot( ba, ba ), 0.0f, 1.0f );
+	vec3_madd( d, pa, ba, -h );
+
+	return vec3_length( d ) - r;
+}
+
+static RDFINLINE float 
+de_prism( const vec3_t p, const float hx, const float hy, const vec3_t a )
+{
+	float qx = fabsf( p[_x_] );
+	float qz = fabsf( p[_z_] );
+
+	return maxf( qz - hy, maxf( qx * a[_x_] + p[_y_] * a[_y_], -p[_y_] * a[_z_] ) - hx );
+}
+
+static RDFINLINE float 
+de_box( const vec3_t p, const vec3_t o, const vec3_t dim )
+{
+	vec3_t d, m;
+
+	d[_x_] = fabsf( o[_x_] - p[_x_] ) - dim[_x_];
+	d[_y_] = fabsf( o[_y_] - p[_y_] ) - dim[_y_];
+	d[_z_] = fabsf( o[_z_] - p[_z_] ) - dim[_z_];
+
+	vec3_set( m, maxf( d[_x_], 0.0f ), maxf( d[_y_], 0.0f ), maxf( d[_z_], 0.0f ) );
+
+	return minf( maxf( d[_x_], maxf( d[_y_], d[_z_] ) ), 0.0f ) + vec3_length( m );
+}
+
+static RDFINLINE float 
+smin( const float a, const float b, const float k )
+{
+	float h = clampf( 0.5f + 0.5f * ( b - a ) / k, 0.0f, 1.0f );
+
+	return mixf( b, a, h ) - k * h * ( 1.0f - h );
+}
+
+static RDFINLINE de_t 
+de_union( const de_t de1, const de_t de2 )
+{
+	return ( de1.dist < de2.dist ) ? de1 : de2;
+}
+
+static RDFINLINE de_t 
+de_carve( const de_t de1, const de_t de2 )
+{
+	de_t det = de1;
+
+	det.dist = -de1.dist;
+
+	return ( det.dist > de2.dist ) ? det : de2;
+}
+
+/*****************************************************************************/
+/*scene, mirrors the non _PACKY scene() of frag.glsl*/
+static de_t 
+packy( const state_t *st, const vec3_t p )
+{
+	static const vec3_t mouth_a = { 0.50f, 0.25f, 1.0f };
+	static const vec3_t eye_l = { 0.65f, 0.65f, 0.35f };
+	static const vec3_t eye_r = { 0.65f, 0.65f, -0.35f };
+	static const vec3_t arm_l[3] = { { 0.0f, 0.15f, 0.95f }, { 0.05f, 0.0f, 1.25f }, { 0.25f, 0.3f, 1.45f } };
+	static const vec3_t arm_r[3] = { { 0.0f, 0.15f, -0.95f }, { 0.05f, 0.0f, -1.25f }, { 0.25f, -0.3f, -1.45f } };
+
+	de_t	de, part;
+	vec3_t	q;
+	float	arm_1, arm_2;
+
+	de.mat = MAT_GREEN;
+	de.dist = vec3_length( (float *)p ) - 1.0f;
+
+	vec3_set( q, p[_x_] - ( 1.25f + st->sinpacky ), p[_y_] + 0.55f, p[_z_] );
+	rotate_z( q, q, 0.87f );
+
+	part.dist = de_prism( q, 0.5f, 1.25f, mouth_a );
+	part.mat = MAT_FLESH;
+	de = de_carve( part, de );
+
+	part.dist = de_sphere( p, eye_l, 0.08f );
+	part.mat = MAT_OBSIDIAN;
+	de = de_union( part, de );
+
+	part.dist = de_sphere( p, eye_r, 0.08f );
+	part.mat = MAT_OBSIDIAN;
+	de = de_union( part, de );
+
+	/* left arm */
+	arm_1 = de_segment( p, arm_l[0], arm_l[1], 0.05f );
+	arm_2 = de_segment( p, arm_l[1], arm_l[2], 0.05f );
+	part.dist = smin( arm_1, arm_2, 0.05f );
+	part.mat = MAT_GREEN;
+	de = de_union( part, de );
+
+	/* right arm */
+	arm_1 = de_segment( p, arm_r[0], arm_r[1], 0.05f );
+	arm_2 = de_segment( p, arm_r[1], arm_r[2], 0.05f );
+	part.dist = smin( arm_1, arm_2, 0.05f );
+	part.mat = MAT_GREEN;
+	de = de_union( part, de );
+
+	return de;
+}
+
+static de_t 
+facult( const vec3_t p )
+{
+	/*origin, extents, material of every box in frag.glsl order*/
+	static const float boxes[][7] = {
+		{ 0.0f, -0.75f,  0.00f, 0.05f, 0.02f, 0.40f, MAT_OBSIDIAN },
+		{ 0.0f, -0.71f,  0.00f, 0.05f, 0.02f, 0.38f, MAT_ALUMINIUM },
+		{ 0.0f, -0.67f,  0.00f, 0.05f, 0.02f, 0.36f, MAT_OBSIDIAN },
+		{ 0.0f, -0.63f,  0.00f, 0.05f, 0.04f, 0.32f, MAT_PEARL },
+		{ 0.0f, -0.40f,  0.26f, 0.05f, 0.20f, 0.05f, MAT_ALUMINIUM },
+		{ 0.0f, -0.40f,  0.13f, 0.05f, 0.20f, 0.05f, MAT_ALUMINIUM },
+		{ 0.0f, -0.40f,  0.00f, 0.05f, 0.20f, 0.05f, MAT_ALUMINIUM },
+		{ 0.0f, -0.40f, -0.13f, 0.05f, 0.20f, 0.05f, MAT_ALUMINIUM },
+		{ 0.0f, -0.40f, -0.26f, 0.05f, 0.20f, 0.05f, MAT_ALUMINIUM },
+		{ 0.0f, -0.16f,  0.00f, 0.05f, 0.04f, 0.32f, MAT_OBSIDIAN },
+	};
+	static const vec3_t roof_a = { 0.14f, 0.4f, 2.5f };
+
+	de_t	de;
+	vec3_t	q;
+	float	d1;
+	int		i;
+
+	de.dist = de_box( p, boxes[0], boxes[0] + 3 );
+	de.mat = boxes[0][6];
+
+	for ( i = 1; i < (int)( sizeof(boxes) / sizeof(boxes[0]) ); i++ ) {
+		d1 = de_box( p, boxes[i], boxes[i] + 3 );
+
+		if ( d1 < de.dist ) {
+			de.dist = d1;
+			de.mat = boxes[i][6];
+		}
+	}
+
+	rotate_y( q, p, 1.57079633f );
+	q[_y_] += 0.10f;
+	d1 = de_prism( q, 0.05f, 0.05f, roof_a );
+
+	if ( d1 < de.dist ) {
+		de.dist = d1;
+		de.mat = MAT_OBSIDIAN;
+	}
+
+	return de;
+}
+
+static de_t 
+gogu( const state_t *st, const vec3_t p )
+{
+	/*eye centers, radii, materials*/
+	static const float eyes[4][5] = {
+		{ 0.95f, 0.35f,  0.25f, 0.15f, MAT_PEARL },
+		{ 1.05f, 0.38f,  0.25f, 0.05f, MAT_BLUE },
+		{ 0.95f, 0.35f, -0.25f, 0.15f, MAT_PEARL },
+		{ 1.05f, 0.38f, -0.25f, 0.05f, MAT_BLUE },
+	};
+	static const vec3_t body = { 0.0f, 0.25f, 0.0f };
+
+	de_t	de;
+	float	bump, eye;
+	int		i;
+
+	de.mat = MAT_FLESH;
+
+	bump = 0.035f * sinf( 8.0f * st->time ) * sinf( 2.0f * p[_y_] ) * sinf( 16.0f * p[_z_] );
+	de.dist = vec3_length( (float *)p ) - 1.15f + bump;
+
+	for ( i = 0; i < 4; i++ ) {
+		eye = vec3_dist( p, eyes[i] ) - eyes[i][3];
+
+		if ( eye < de.dist ) {
+			de.dist = eye;
+			de.mat = eyes[i][4];
+		}
+	}
+
+	de.dist = smin( de.dist, de_sphere( p, body, 1.15f ), 0.05f );
+
+	return de;
+}
+
+static de_t 
+scene( const state_t *st, const vec3_t p )
+{
+	static const vec3_t up = { 0.0f, 1.0f, 0.0f };
+	static const vec3_t facult_pos = { 15.0f, 3.0f, 15.0f };
+	static const vec3_t packy_pos = { 10.0f, 0.0f, 15.0f };
+	static const vec3_t gogu_pos = { 10.0f, 0.0f, 20.0f };
+
+	de_t	de, de2;
+	vec3_t	q;
+
+	de.dist = de_plane( p, up, 1.0f );
+	de.mat = MAT_ALUMINIUM;
+
+	vec3_sub( q, p, facult_pos );
+	rotate_y( q, q, st->time );
+	vec3_scale( q, 1.0f / 5.0f );
+	de2 = facult( q );
+	de2.dist *= 5.0f;
+
+	de = de_union( de, de2 );
+
+	if ( de_sphere( p, packy_pos, 1.5f ) < de.dist ) {
+		vec3_sub( q, p, packy_pos );
+		rotate_y( q, q, st->quartertime );
+		de = de_union( packy( st, q ), de );
+	}
+
+	if ( de_sphere( p, gogu_pos, 1.5f ) < de.dist ) {
+		vec3_sub( q, p, gogu_pos );
+		rotate_y( q, q, -st->halftime );
+		de = de_union( gogu( st, q ), de );
+	}
+
+	return de;
+}
+
+/*****************************************************************************/
+/*tracing*/
+static void 
+normal( const state_t *st, vec3_t n, const vec3_t p )
+{
+	vec3_t a, b;
+	int i;
+
+	for ( i = 0; i < 3; i++ ) {
+		vec3_mov( a, p );
+		vec3_mov( b, p );
+		a[i] += NEPSILON;
+		b[i] -= NEPSILON;
+
+		n[i] = scene( st, a ).dist - scene( st, b ).dist;
+	}
+
+	vec3_normalize( n );
+}
+
+static void 
+trace( const state_t *st, point_t *px, const vec3_t ro, const vec3_t rd, const float maxd )
+{
+	de_t	de;
+	int		i;
+
+	px->mat = MAT_SKY;
+	px->dist = TR_EPSILON * 2.0f;
+
+	for ( i = 0; i < MAX_STEPS; i++ ) {
+		vec3_madd( px->pos, ro, rd, px->dist );
+		de = scene( st, px->pos );
+		px->mat = de.mat;
+		if ( ( fabsf( de.dist ) < TR_EPSILON ) || ( px->dist > maxd ) ) {
+			break;
+		}
+		px->dist += de.dist;
+	}
+
+	if ( px->dist > maxd ) {
+		px->mat = MAT_SKY;
+		px->dist = maxd;
+	}
+}
+
+static float 
+vis( const state_t *st, const vec3_t ro, const vec3_t rd, const float maxd )
+{
+	vec3_t	p;
+	float	d = VIS_START;
+	float	visf = 1.0f;
+	float	dist;
+	int		i;
+
+	for ( i = 0; i < VIS_STEPS && d < maxd; i++ ) {
+		vec3_madd( p, ro, rd, d );
+		dist = scene( st, p ).dist;
+		visf = minf( visf, VIS_SS * dist / d );
+		d += dist;
+	}
+
+	return clampf( visf, 0.0f, 1.0f );
+}
+
+static float 
+occ( const state_t *st, const vec3_t ro, const vec3_t rd )
+{
+	vec3_t	p;
+	float	occf = 1.0f;
+	float	occt = 0.0f;
+	float	d;
+	int		i;
+
+	for ( i = 0; i < OCC_STEPS; i++ ) {
+		d = (float)i * 0.05f + TR_EPSILON;
+		vec3_madd( p, ro, rd, d );
+		occt += -( scene( st, p ).dist - d ) * occf;
+		occf *= 0.75f;
+	}
+
+	return clampf( 1.0f - OCC_STEPS * occt, 0.0f, 1.0f );
+}
+
+/*****************************************************************************/
+/*materials and shading*/
+static void 
+texture_sample( vec3_t dest, const unsigned int unit, const float u, const float v )
+{
+	const texture_t		*tex = &textures[unit];
+	const unsigned char	*t00, *t10, *t01, *t11;
+	float	x, y, fx, fy;
+	int		x0, y0, x1, y1, i;
+
+	if ( !tex->data ) {
+		vec3_set( dest, 0.0f, 0.0f, 0.0f );
+		return;
+	}
+
+	/*GL_LINEAR, GL_REPEAT*/
+	x = u * tex->width - 0.5f;
+	y = v * tex->height - 0.5f;
+	fx = x - floorf( x );
+	fy = y - floorf( y );
+
+	x0 = (int)floorf( x ) % tex->width;
+	y0 = (int)floorf( y ) % tex->height;
+	x0 += ( x0 < 0 ) ? tex->width : 0;
+	y0 += ( y0 < 0 ) ? tex->height : 0;
+	x1 = ( x0 + 1 ) % tex->width;
+	y1 = ( y0 + 1 ) % tex->height;
+
+	t00 = tex->data + ( y0 * tex->width + x0 ) * 3;
+	t10 = tex->data + ( y0 * tex->width + x1 ) * 3;
+	t01 = tex->data + ( y1 * tex->width + x0 ) * 3;
+	t11 = tex->data + ( y1 * tex->width + x1 ) * 3;
+
+	for ( i = 0; i < 3; i++ ) {
+		dest[i] = mixf( mixf( t00[i], t10[i], fx ), mixf( t01[i], t11[i], fx ), fy ) / 255.0f;
+	}
+}
+
+static void 
+texture3d( vec3_t dest, const unsigned int unit, const vec3_t p, const vec3_t n, const float scale )
+{
+	vec3_t x, y, z;
+
+	texture_sample( x, unit, p[_y_] * scale, p[_z_] * scale );
+	texture_sample( y, unit, p[_z_] * scale, p[_x_] * scale );
+	texture_sample( z, unit, p[_x_] * scale, p[_y_] * scale );
+
+	vec3_scale( x, fabsf( n[_x_] ) );
+	vec3_madd( dest, x, y, fabsf( n[_y_] ) );
+	vec3_madd( dest, dest, z, fabsf( n[_z_] ) );
+}
+
+static void 
+object( mat_t *mat, const vec3_t p, const vec3_t n, const float matid )
+{
+	/*albedo, gloss, fr0 of the untextured materials*/
+	static const float flat[][6] = {
+		{ MAT_GREEN,	 0.196078f, 0.8f, 0.196078f,		0.0f,	0.0f },
+		{ MAT_OBSIDIAN,	 0.05f, 0.05f, 0.05f,				10.5f,	0.0f },
+		{ MAT_ALUMINIUM, 0.329412f, 0.329412f, 0.329412f,	1.5f,	1.0f },
+		{ MAT_PEARL,	 0.95f, 0.95f, 0.95f,				1.5f,	0.0f },
+		{ MAT_GOLD,		 0.85f, 0.45f, 0.0f,				5.0f,	0.3f },
+		{ MAT_RED,		 0.9f, 0.2f, 0.2f,					0.0f,	0.0f },
+		{ MAT_BLUE,		 0.05f, 0.05f, 0.95f,				10.5f,	0.0f },
+		{ MAT_FLESH,	 0.9f, 0.1f, 0.1f,					1.0f,	0.5f },
+		{ MAT_OCEAN,	 0.0f, 0.05f, 0.05f,				1.0f,	0.2f },
+		{ MAT_EMERALD,	 0.07568f, 0.61424f, 0.07568f,		0.6f,	0.2f },
+		{ MAT_MOSS,		 0.15f, 0.35f, 0.15f,				0.025f,	0.0f },
+	};
+	int i;
+
+	memset( mat, 0, sizeof(mat_t) );
+
+	for ( i = 0; i < (int)( sizeof(flat) / sizeof(flat[0]) ); i++ ) {
+		if ( matid == flat[i][0] ) {
+			vec3_mov( mat->albedo, flat[i] + 1 );
+			mat->gloss = flat[i][4];
+			mat->fr0 = flat[i][5];
+			return;
+		}
+	}
+
+	if ( matid == MAT_TEX2_2D ) {
+		texture_sample( mat->albedo, 1, p[_x_] * 0.10f, p[_z_] * 0.10f );
+	}
+	else if ( matid == MAT_TEX1_3D ) {
+		texture3d( mat->albedo, 0, p, n, 0.45f );
+	}
+	else if ( matid == MAT_TEX2_3D ) {
+		texture3d( mat->albedo, 1, p, n, 0.2f );
+	}
+	else if ( matid == MAT_MOSS_TEX ) {
+		texture3d( mat->albedo, 2, p, n, 0.2f );
+		mat->gloss = 0.025f;
+	}
+	else if ( matid == MAT_FLOOR_TEX ) {
+		texture_sample( mat->albedo, 1, p[_x_] * 0.2f, p[_z_] * 0.2f );
+	}
+}
+
+static void 
+background( vec3_t dest, const state_t *st, const vec3_t rd )
+{
+	float sun = maxf( vec3_dot( rd, st->sun ), 0.0f );
+	float v = 1.0f - maxf( rd[_y_], 0.0f );
+	float s = minf( powf( sun, 512.0f ) * 1.5f, 1.0f );
+	int i;
+
+	for ( i = 0; i < 3; i++ ) {
+		dest[i] = clampf( mixf( SKY_COL[i], HOR_COL[i], v ) + SUN_COL[i] * s, 0.0f, 1.0f );
+	}
+}
+
+static void 
+shade( vec3_t dest, const state_t *st, const point_t *px, const mat_t *mat )
+{
+	vec3_t	refl;
+	float	ao, amb, dif, sh, pp, spe, fre, nrd;
+	int		i;
+
+	ao = occ( st, px->pos, px->nor );
+	amb = clampf( 0.5f + 0.5f * px->nor[_y_], 0.0f, 1.0f );
+	dif = maxf( 0.0f, vec3_dot( px->nor, st->sun ) );
+	sh = vis( st, px->pos, st->sun, VIEW_DIST );
+
+	/*reflect( rd, n )*/
+	nrd = vec3_dot( px->nor, px->rd );
+	vec3_madd( refl, px->rd, px->nor, -2.0f * nrd );
+
+	pp = clampf( vec3_dot( refl, st->sun ), 0.0f, 1.0f );
+	spe = sh * powf( pp, 64.0f );
+	fre = ao * powf( clampf( 1.0f + nrd, 0.0f, 1.0f ), 2.0f );
+
+	for ( i = 0; i < 3; i++ ) {
+		float brdf = 0.20f * amb * HOR_COL[i] * ao + 0.50f * dif * sh * SUN_COL[i] + ao * 0.30f;
+
+		dest[i] = mat->albedo[i] * brdf + mat->gloss * mat->albedo[i] * spe + mat->fr0 * fre * ( 0.5f + 0.5f * mat->albedo[i] );
+	}
+}
+
+static void 
+render( vec3_t dest, const state_t *st, const vec3_t ro, const vec3_t rd )
+{
+	point_t	px;
+	mat_t	mat;
+
+	trace( st, &px, ro, rd, VIEW_DIST );
+
+	if ( px.mat < 0.0f ) {
+		background( dest, st, rd );
+		return;
+	}
+
+	normal( st, px.nor, px.pos );
+	vec3_mov( px.rd, rd );
+
+	object( &mat, px.pos, px.nor, px.mat );
+	shade( dest, st, &px, &mat );
+}
+
+/*****************************************************************************/
+/*tiles*/
+static void 
+render_tile( void *userdata, const unsigned int tile, const unsigned int worker )
+{
+	job_t			*job = (job_t *)userdata;
+	const cpu_camera_t *cam = job->camera;
+	unsigned char	*out;
+	vec3_t			rgb, rd;
+	float			aspect = (float)job->width / (float)job->height;
+	float			u, v;
+	unsigned int	x, y, x0, y0, x1, y1;
+	int				i;
+
+	(void)worker;
+
+	x0 = ( tile % job->tiles_x ) * TILE_SIZE;
+	y0 = ( tile / job->tiles_x ) * TILE_SIZE;
+	x1 = ( x0 + TILE_SIZE < job->width ) ? x0 + TILE_SIZE : job->width;
+	y1 = ( y0 + TILE_SIZE < job->height ) ? y0 + TILE_SIZE : job->height;
+
+	for ( y = y0; y < y1; y++ ) {
+		/*gl_FragCoord has its origin at the bottom left*/
+		v = ( ( job->height - 1 - y ) + 0.5f ) / job->height * 2.0f - 1.0f;
+		out = job->rgb + ( y * job->width + x0 ) * 3;
+
+		for ( x = x0; x < x1; x++ ) {
+			u = ( ( x + 0.5f ) / job->width * 2.0f - 1.0f ) * aspect;
+
+			vec3_mov( rd, cam->dir );
+			vec3_scale( rd, FOV );
+			vec3_madd( rd, rd, cam->right, u );
+			vec3_madd( rd, rd, cam->up, v );
+			vec3_normalize( rd );
+
+			render( rgb, &job->state, cam->pos, rd );
+
+			/*postprocess*/
+			for ( i = 0; i < 3; i++ ) {
+				*out++ = (unsigned char)( powf( clampf( rgb[i], 0.0f, 1.0f ), 1.0f / GAMMA ) * 255.0f + 0.5f );
+			}
+		}
+	}
+}
+
+static double 
+cpu_clock( void )
+{
+#ifdef _WIN32
+	LARGE_INTEGER freq, now;
+
+	QueryPerformanceFrequency( &freq );
+	QueryPerformanceCounter( &now );
+
+	return (double)now.QuadPart / (double)freq.QuadPart;
+#else
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+/*****************************************************************************/
+/*exports*/
+int 
+cpu_texture( const unsigned int unit, const char *path )
+{
+	texture_t *tex;
+
+	if ( unit >= CPU_TEXTURES ) {
+		return ERR;
+	}
+
+	tex = &textures[unit];
+
+	if ( tex->data ) {
+		SOIL_free_image_data( tex->data );
+	}
+
+	tex->data = SOIL_load_image( path, &tex->width, &tex->height, 0, SOIL_LOAD_RGB );
+	if ( !tex->data ) {
+		fprintf( stderr, "cpu: texture \"%s\" not loaded\n", path );
+		return ERR;
+	}
+
+	return OK;
+}
+
+int 
+cpu_render( unsigned char *rgb, const unsigned int width, const unsigned int height,
+			const cpu_camera_t *camera, const float time, const unsigned int threads )
+{
+	job_t		job;
+	pool_t		*pool;
+	double		start;
+	unsigned int tiles;
+
+	pool = pool_create( threads );
+	if ( !pool ) {
+		return ERR;
+	}
+
+	job.rgb = rgb;
+	job.width = width;
+	job.height = height;
+	job.camera = camera;
+	job.tiles_x = ( width + TILE_SIZE - 1 ) / TILE_SIZE;
+	tiles = job.tiles_x * ( ( height + TILE_SIZE - 1 ) / TILE_SIZE );
+
+	job.state.time = time;
+	job.state.halftime = time / 2.0f;
+	job.state.quartertime = time / 4.0f;
+	job.state.time8 = time / 8.0f;
+	job.state.sinhalftime = sinf( job.state.halftime );
+	job.state.coshalftime = cosf( job.state.halftime );
+	job.state.sinpacky = sinf( time * 8.0f ) * 0.5f + 0.5f;
+	vec3_set( job.state.sun, sinf( job.state.time8 ), 0.45f, cosf( job.state.time8 ) );
+	vec3_normalize( job.state.sun );
+
+	start = cpu_clock();
+	pool_for( pool, tiles, render_tile, &job );
+
+	fprintf( stdout, "cpu: %ux%u, %u tiles, %u threads, %.1f ms\n",
+			 width, height, tiles, pool_workers( pool ), ( cpu_clock() - start ) * 1000.0 );
+
+	pool_destroy( pool );
+
+	return OK;
+}
+
+void 
+cpu_release( void )
+{
+	int i;
+
+	for ( i = 0; i < CPU_TEXTURES; i++ ) {
+		if ( textures[i].data ) {
+			SOIL_free_image_data( textures[i].data );
+			textures[i].data = NULL;
+		}
+	}
+}
\ No newline at end of file
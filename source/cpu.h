@@ -0,0 +1,23 @@
+#ifndef __cpu_h_
+#define __cpu_h_
+
+#include "core.h"
+#include "math.h"
+
+#define CPU_TEXTURES	3
+
+typedef struct
+{
+	vec3_t	pos;
+	vec3_t	dir;
+	vec3_t	right;
+	vec3_t	up;
+} cpu_camera_t;
+
+/* reference renderer mirroring frag.glsl, rgb is width * height * 3 bytes, top row first */
+int		cpu_texture( const unsigned int unit, const char *path );
+int		cpu_render( unsigned char *rgb, const unsigned int width, const unsigned int height,
+					const cpu_camera_t *camera, const float time, const unsigned int threads );
+void	cpu_release( void );
+
+#endif/*__cpu_h_*/
\ No newline at end of file
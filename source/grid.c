@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+
+#include "grid.h"
+
+typedef struct
+{
+	vec3_t	lo;
+	vec3_t	hi;
+} box_t;
+
+typedef struct
+{
+	box_t	bound;
+	box_t	core;
+	bool	solid;
+} prim_box_t;
+
+/*****************************************************************************/
+/*locals*/
+/* closest distance between the points of two boxes, 0 when they overlap */
+static float 
+box_near( const box_t *a, const box_t *b )
+{
+	float	d, sum = 0.0f;
+	int		i;
+
+	for ( i = 0; i < 3; i++ ) {
+		d = a->lo[i] - b->hi[i];
+		d = b->lo[i] - a->hi[i] > d ? b->lo[i] - a->hi[i] : d;
+		sum += d > 0.0f ? d * d : 0.0f;
+	}
+
+	return sqrtf( sum );
+}
+
+/* furthest distance between the points of two boxes */
+static float 
+box_far( const box_t *a, const box_t *b )
+{
+	float	d, sum = 0.0f;
+	int		i;
+
+	for ( i = 0; i < 3; i++ ) {
+		d = fabsf( a->hi[i] - b->lo[i] );
+		d = fabsf( b->hi[i] - a->lo[i] ) > d ? fabsf( b->hi[i] - a->lo[i] ) : d;
+		sum += d * d;
+	}
+
+	return sqrtf( sum );
+}
+
+/* furthest distance from a point of a to the closest point of b */
+static float 
+box_reach( const box_t *a, const box_t *b )
+{
+	float	lo, hi, sum = 0.0f;
+	int		i;
+
+	for ( i = 0; i < 3; i++ ) {
+		lo = b->lo[i] - a->lo[i] > a->lo[i] - b->hi[i] ? b->lo[i] - a->lo[i] : a->lo[i] - b->hi[i];
+		hi = b->lo[i] - a->hi[i] > a->hi[i] - b->hi[i] ? b->lo[i] - a->hi[i] : a->hi[i] - b->hi[i];
+		lo = lo > hi ? lo : hi;
+		sum += lo > 0.0f ? lo * lo : 0.0f;
+	}
+
+	return sqrtf( sum );
+}
+
+/* no point of the cell is further from the surface of the primitive */
+static float 
+prim_far( const box_t *cell, const prim_box_t *prim )
+{
+	return prim->solid ? box_reach( cell, &prim->core ) : box_far( cell, &prim->bound );
+}
+
+static int 
+prims_append( grid_t *grid, const int prim, unsigned int *size )
+{
+	int *grown;
+
+	if ( grid->prim_count == *size ) {
+		*size = *size ? *size * 2 : 256;
+		grown = (int *)realloc( grid->prims, *size * sizeof(int) );
+		if ( !grown ) {
+			return ERR;
+		}
+		grid->prims = grown;
+	}
+
+	grid->prims[grid->prim_count++] = prim;
+
+	return OK;
+}
+
+/* the lists of every cell of one run over the boxes of its static primitives */
+static int 
+grid_run( grid_t *grid, const unsigned int run, const prim_box_t *boxes, const int *prims, const unsigned int count, unsigned int *size )
+{
+	grid_run_t		*r = &grid->runs[run];
+	float			*cell;
+	box_t			c, all;
+	float			d, far, nearest;
+	unsigned int	x, y, z, i;
+	int				a, err = OK;
+
+	for ( a = 0; a < 3; a++ ) {
+		all.lo[a] = FLT_MAX;
+		all.hi[a] = -FLT_MAX;
+
+		for ( i = 0; i < count; i++ ) {
+			all.lo[a] = boxes[i].bound.lo[a] < all.lo[a] ? boxes[i].bound.lo[a] : all.lo[a];
+			all.hi[a] = boxes[i].bound.hi[a] > all.hi[a] ? boxes[i].bound.hi[a] : all.hi[a];
+		}
+
+		/*a little larger, points on the outer faces still land in a cell*/
+		r->lo[a] = all.lo[a];
+		r->size[a] = ( all.hi[a] - all.lo[a] ) / GRID_CELLS * 1.001f + 1e-4f;
+	}
+
+	for ( z = 0; z < GRID_CELLS; z++ ) {
+		for ( y = 0; y < GRID_CELLS; y++ ) {
+			for ( x = 0; x < GRID_CELLS; x++ ) {
+				cell = &grid->cells[( ( ( run * GRID_CELLS + z ) * GRID_CELLS + y ) * GRID_CELLS + x ) * 4];
+
+				c.lo[0] = r->lo[0] + x * r->size[0];
+				c.lo[1] = r->lo[1] + y * r->size[1];
+				c.lo[2] = r->lo[2] + z * r->size[2];
+				for ( a = 0; a < 3; a++ ) {
+					c.hi[a] = c.lo[a] + r->size[a];
+				}
+
+				/*no primitive is further from a point of the cell than the nearest upper bound*/
+				far = FLT_MAX;
+				nearest = FLT_MAX;
+				for ( i = 0; i < count; i++ ) {
+					d = prim_far( &c, &boxes[i] );
+					far = d < far ? d : far;
+					d = box_near( &c, &boxes[i].bound );
+					nearest = d < nearest ? d : nearest;
+				}
+
+				cell[0] = (float)grid->prim_count;
+				cell[2] = nearest;
+				cell[3] = 0.0f;
+
+				for ( i = 0; i < count; i++ ) {
+					if ( box_near( &c, &boxes[i].bound ) <= far ) {
+						err |= prims_append( grid, prims[i], size );
+					}
+				}
+
+				cell[1] = grid->prim_count - cell[0];
+			}
+		}
+	}
+
+	return err;
+}
+
+/*****************************************************************************/
+/*exports*/
+int 
+grid_build( grid_t *grid, const scene_t *scene, scene_value_fn value )
+{
+	prim_box_t		*boxes;
+	int				*prims;
+	unsigned int	i, end, count, size = 0;
+	int				err = OK;
+
+	grid->runs = NULL;
+	grid->run_count = 0;
+	grid->cells = NULL;
+	grid->prims = NULL;
+	grid->prim_count = 0;
+
+	if ( scene->runs == 0 ) {
+		return OK;
+	}
+
+	grid->runs = (grid_run_t *)calloc( scene->runs, sizeof(grid_run_t) );
+	grid->cells = (float *)calloc( scene->runs * GRID_CELLS * GRID_CELLS * GRID_CELLS * 4, sizeof(float) );
+	boxes = (prim_box_t *)malloc( scene->count * sizeof(prim_box_t) );
+	prims = (int *)malloc( scene->count * sizeof(int) );
+	if ( !grid->runs || !grid->cells || !boxes || !prims ) {
+		free( boxes );
+		free( prims );
+		grid_release( grid );
+		return ERR;
+	}
+
+	grid->run_count = scene->runs;
+
+	for ( i = 0; i < scene->count; i = end ) {
+		for ( end = i, count = 0; end < scene->count && scene->prims[end].run == scene->prims[i].run; end++ ) {
+			const scene_prim_t *prim = &scene->prims[end];
+
+			if ( prim->run >= 0 && !scene_dynamic( prim ) && scene_bounds( prim, value, boxes[count].bound.lo, boxes[count].bound.hi ) ) {
+				boxes[count].solid = scene_core( prim, boxes[count].core.lo, boxes[count].core.hi );
+				prims[count++] = end;
+			}
+		}
+
+		if ( scene->prims[i].run >= 0 && count > 0 ) {
+			err |= grid_run( grid, scene->prims[i].run, boxes, prims, count, &size );
+		}
+	}
+
+	free( boxes );
+	free( prims );
+
+	if ( err != OK ) {
+		grid_release( grid );
+		return ERR;
+	}
+
+	return OK;
+}
+
+void 
+grid_release( grid_t *grid )
+{
+	free( grid->runs );
+	free( grid->cells );
+	free( grid->prims );
+	grid->runs = NULL;
+	grid->run_count = 0;
+	grid->cells = NULL;
+	grid->prims = NULL;
+	grid->prim_count = 0;
+}
\ No newline at end of file
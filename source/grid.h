@@ -0,0 +1,40 @@
+#ifndef __grid_h_
+#define __grid_h_
+
+#include "scene.h"
+
+/*cells per side of the grid of a run, has to match GRID_CELLS in frag.glsl*/
+#define GRID_CELLS	16
+
+/*
+	one entry of _grid_runs in frag.glsl, std430 layout of grid_run_t: the grid of a run
+	spans the boxes of its static primitives, w unused
+*/
+typedef struct
+{
+	float	lo[4];
+	float	size[4];
+} grid_run_t;
+
+/*
+	cells of every run stacked along z, run r from GRID_CELLS * r: the first and count
+	of the cell's list in prims, and the distance below which a primitive of the run can
+	be, the texels of the _grid texture
+
+	the list of a cell holds the primitives whose box is no further than the furthest
+	point of the nearest box, every other one is further from any point of the cell
+*/
+typedef struct
+{
+	grid_run_t		*runs;
+	unsigned int	run_count;
+	float			*cells;
+	int				*prims;
+	unsigned int	prim_count;
+} grid_t;
+
+/* static primitives of the runs only, moving ones stay in line */
+int		grid_build( grid_t *grid, const scene_t *scene, scene_value_fn value );
+void	grid_release( grid_t *grid );
+
+#endif/*__grid_h_*/
\ No newline at end of file
@@ -1,9 +1,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <memory.h>
+#include <string.h>
 
 #include "core.h"
 #include "programs.h"
+#include "cpu.h"
+#include "stats.h"
+#include "scene.h"
+#include "bvh.h"
+#include "grid.h"
+#include "bake.h"
+#include "texcache.h"
+#include "pool.h"
+#include "watch.h"
 #include "impl_local.h"
 
 /*default camera*/
@@ -27,83 +37,1146 @@ static key_t	keydata[256];
 static frame_t	frame			= { 0 };
 static frame_t	prevframe		= { 0 };
 
-static int		debugmode		= 0;
+/*F5 steps through the debug views, every one a variant of every pass*/
+static unsigned int	debugmode		= 0;
+static const char	*debug_variants[DEBUG_VIEWS] = {
+	NULL,
+	"#define _DEBUG\n#define _DEBUG_ITERATIONS\n",
+	"#define _DEBUG\n#define _DEBUG_NORMALS\n",
+	"#define _DEBUG\n#define _DEBUG_DEPTH\n",
+};
+
+/*shader features without a key, compiled into every pass*/
+static const bool	sky				= TRUE;
+static const bool	fog				= FALSE;
+static const bool	fixed_camera	= FALSE;
+
+/*over relaxed primary rays, omega 1 is plain sphere tracing*/
+static bool		relax			= TRUE;
+static const float	relax_omega		= 1.4f;
+
+/*gpu timing*/
+static const char	*stats_path	= "rdf_stats.csv";
+
+/*scene file compiled into every pass, see scene.h*/
+static const char	*scene_path	= "../scenes/default.scene";
+static scene_t		scene		= { 0 };
+static bvh_t		bvh			= { 0 };
+static GLuint		ssbo_bvh	= 0;
+static grid_t		grid		= { 0 };
+static GLuint		ssbo_grid	= 0;
+static GLuint		tex_grid	= 0;
+/*bvh runs, cell lists or every primitive in line, see README*/
+static bool			scene_bvh	= FALSE;
+static bool			scene_grid	= FALSE;
+/*what the running passes walk, the toggles take effect once their reload swaps in*/
+static bool			running_bvh	= FALSE;
+static bool			running_grid = FALSE;
+
+/*static start of the scene as a distance volume, see bake.h*/
+static bake_t		bake		= { 0 };
+static GLuint		tex_bake	= 0;
+static GLuint		tex_bake_index = 0;
+static GLuint		tex_bake_mip = 0;
+static bool			scene_bake	= FALSE;
+/*the running scene has a baked volume, the passes sample it*/
+static bool			scene_baked	= FALSE;
+static unsigned int	bake_voxels	= 128;
+static unsigned int	bake_threads = 0;
+
+/*a scene and what is built from it, see scene_build()*/
+typedef struct
+{
+	scene_t	scene;
+	bvh_t	bvh;
+	grid_t	grid;
+	bake_t	bake;
+	bool	bakes;
+	bool	gridded;
+	bool	baked;
+	int		err;
+} scene_build_t;
+
+/*
+	F1 and written scene files build the next scene on scene_pool, the passes are rebuilt
+	once it is done and both swap in together, see reload_update()
+*/
+static watch_t			*scene_watch	= NULL;
+static pool_t			*scene_pool		= NULL;
+static scene_build_t	scene_next;
+static bool				scene_building	= FALSE;
+static bool				scene_ready		= FALSE;
+/*a toggle or F1 while the scene builds, the build is dropped and started again*/
+static bool				scene_again		= FALSE;
+static double			scene_start_time;
+/*the values the next scene is placed with, read by the job instead of the running ones*/
+static float			scene_next_time;
+static vec3_t			scene_next_vars[4];
+
+/*objects scene files place with uniforms, bvh bounds are refit from the same values*/
+static vec3_t	packy_pos		= { 0.0f, 0.0f, 0.0f };
+static vec3_t	packy_angles	= { 0.0f, 0.0f, 0.0f };
+static vec3_t	gogu_pos		= { 0.0f, 0.0f, 0.0f };
+static vec3_t	gogu_angles		= { 0.0f, 0.0f, 0.0f };
+static int		stage_cone		= -1;
+static int		stage_gbuffer	= -1;
+static int		stage_shadow	= -1;
+static int		stage_light		= -1;
+static int		stage_resolve	= -1;
 
 /*opengl objects*/
-static program	progs = { 0 };
+static pass_t	cone_pass = { 0 };
+static pass_t	gbuffer_pass = { 0 };
+static pass_t	compute_pass = { 0 };
+static pass_t	shadow_pass = { 0 };
+static pass_t	light_pass = { 0 };
+
+static pass_t	*const passes[] = { &cone_pass, &gbuffer_pass, &compute_pass, &shadow_pass, &light_pass };
+#define PASSES	( sizeof(passes) / sizeof(passes[0]) )
+
+/*rebuilds every pass in the background when a shader file is written, see reload_update()*/
+static watch_t	*shader_watch	= NULL;
+static bool		reloading		= FALSE;
+static double	reload_start_time;
+/*debug view the reload builds, and whether it follows a source change, which makes every built program stale*/
+static unsigned int	reload_view;
+static bool		reload_sources;
+/*the walks the reload builds, running_bvh and running_grid once it swaps in*/
+static bool		reload_bvh;
+static bool		reload_grid;
 /*vertex array objects*/
 static GLuint	vao;
 /*vertex array buffers*/
 static GLuint	vertices, indices;
-/*uniform locations*/
-static GLint	tex1_l, tex2_l, tex3_l;
-static GLint	vp_l;
-static GLint	resolution_l, time_l, debug_l;
-static GLint	packy_pos_l, packy_angles_l, gogu_pos_l, gogu_angles_l;
-static GLint	bonbons_l, bonbon_count_l;
+
+/*deferred targets, the gbuffer pass writes all of them, the light pass only color*/
+static GLuint	fbo_gbuffer[2], fbo_light;
+static GLuint	tex_color, tex_gbuffer0[2], tex_gbuffer1;
+static GLuint	rb_depth;
+static unsigned int	target_width, target_height;
+
+/*one texel per CONE_TILE^2 pixels, distance every ray of the tile can skip, VIEW_DIST for sky*/
+static bool		cone_prepass	= TRUE;
+static GLuint	fbo_cone, tex_cone;
+static unsigned int	cone_width, cone_height;
+
+/*primary rays from a compute shader instead of the gbuffer draw, it marches the tile cone itself*/
+static bool		compute_primary	= FALSE;
+
+/*sun visibility and occlusion, one texel per shadow_scale^2 pixels, upsampled by the light pass*/
+static bool		shadow_lowres	= TRUE;
+static const unsigned int	shadow_scale	= 2;
+static GLuint	fbo_shadow, tex_shadow;
+static unsigned int	shadow_width, shadow_height;
+
+/*gbuffer0 alternates each frame, the other one holds the previous frame for reprojection*/
+static bool		reproject		= TRUE;
+static unsigned int	current		= 0;
+static unsigned int	frame_index	= 0;
+static bool		history_valid	= FALSE;
+static view_t	history_view;
+static unsigned int	history_width, history_height;
+
+/*dynamic resolution, passes render into the lower left scale * size of the targets*/
+static bool		dynres			= TRUE;
+static float	dynres_scale	= 1.0f;
+static unsigned int	dynres_frame	= 0;
+static const float	dynres_target_ms	= 16.6f;
+static const float	dynres_min		= 0.25f;
+static unsigned int	render_width, render_height;
+
+/*layers of _textures in order, the texture layer of a material row*/
+static const char	*texture_paths[] = {
+	"../textures/Brick_Design_UV_H_CM_1.png",
+	"../textures/Ground10_1.png",
+	"../textures/Moss_01_UV_H_CM_1.png",
+};
+#define TEXTURES	( sizeof(texture_paths) / sizeof(texture_paths[0]) )
+/*the size of every layer, images of another size are resized to it when they load*/
+#define TEXTURE_SIZE	1024
+static GLuint		tex_layers	= 0;
+
+/*textures load on tex_pool, one thread each, and textures_update() uploads them once all are done*/
+static pool_t		*tex_pool	= NULL;
+static texcache_t	tex_loads[TEXTURES];
+static bool			tex_loading	= FALSE;
+static bool			tex_sync	= FALSE;
+/*BC1 blocks, or plain rgb texels when the driver has no S3TC*/
+static unsigned int	tex_format	= TEXCACHE_FORMAT;
+static double		tex_start;
 
 /*uniform blocks*/
 static ubo_t    ubo_cam;
+static ubo_t    ubo_materials;
+static char		material_defines[MATERIALS_DEFINES];
+
+/*
+	materials by name: MAT_<name> in frag.glsl, objects.glsl and scene files is the row,
+	the ids come with the pass defines so a new row needs no shader edit; textured rows
+	tint their layer
+*/
+static const struct
+{
+	const char	*name;
+	material_t	row;
+} materials[] = {
+	{ "RED",		{ { 0.9f, 0.2f, 0.2f },					0.0f,	0.0f,	-1.0f,	0.0f,	0.0f } },
+	{ "BLUE",		{ { 0.05f, 0.05f, 0.95f },				10.5f,	0.0f,	-1.0f,	0.0f,	0.0f } },
+	{ "GREEN",		{ { 0.196078f, 0.8f, 0.196078f },		0.0f,	0.0f,	-1.0f,	0.0f,	0.0f } },
+	{ "OBSIDIAN",	{ { 0.05f, 0.05f, 0.05f },				10.5f,	0.0f,	-1.0f,	0.0f,	0.0f } },
+	{ "PEARL",		{ { 0.95f, 0.95f, 0.95f },				1.5f,	0.0f,	-1.0f,	0.0f,	0.0f } },
+	{ "EMERALD",	{ { 0.07568f, 0.61424f, 0.07568f },		0.6f,	0.2f,	-1.0f,	0.0f,	0.0f } },
+	{ "ALUMINIUM",	{ { 0.329412f, 0.329412f, 0.329412f },	1.5f,	1.0f,	-1.0f,	0.0f,	0.0f } },
+	{ "FLESH",		{ { 0.9f, 0.1f, 0.1f },					1.0f,	0.5f,	-1.0f,	0.0f,	0.0f } },
+	{ "GOLD",		{ { 0.85f, 0.45f, 0.0f },				5.0f,	0.3f,	-1.0f,	0.0f,	0.0f } },
+	{ "TEX2_2D",	{ { 1.0f, 1.0f, 1.0f },					0.0f,	0.0f,	1.0f,	0.10f,	1.0f } },
+	{ "TEX1_3D",	{ { 1.0f, 1.0f, 1.0f },					0.0f,	0.0f,	0.0f,	0.45f,	0.0f } },
+	{ "TEX2_3D",	{ { 1.0f, 1.0f, 1.0f },					0.0f,	0.0f,	1.0f,	0.2f,	0.0f } },
+	{ "OCEAN",		{ { 0.0f, 0.05f, 0.05f },				1.0f,	0.2f,	-1.0f,	0.0f,	0.0f } },
+	{ "MOSS",		{ { 0.15f, 0.35f, 0.15f },				0.025f,	0.0f,	-1.0f,	0.0f,	0.0f } },
+	{ "MOSS_TEX",	{ { 1.0f, 1.0f, 1.0f },					0.025f,	0.0f,	2.0f,	0.2f,	0.0f } },
+	{ "FLOOR_TEX",	{ { 1.0f, 1.0f, 1.0f },					0.0f,	0.0f,	1.0f,	0.2f,	1.0f } },
+};
 
 /*****************************************************************************/
 /*locals*/
 static void 
-load_texture( const char *path, const GLuint tex_unit_enum, const GLuint tex_unit_id, const GLint tex_l )
+texture_job( void *userdata, const unsigned int layer, const unsigned int worker )
 {
-	int width, height;
-	static unsigned char *img = NULL;
-	GLuint tex;
+	texcache_t *loads = (texcache_t *)userdata;
 
-	img = SOIL_load_image( path, &width, &height, 0, SOIL_LOAD_RGB );
-	if ( img )
-	{
-		glActiveTexture( tex_unit_enum );
-		glGenTextures( 1, &tex );
-		glBindTexture( GL_TEXTURE_2D, tex );
-		glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, img );
-		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
-		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT );
-		glTexParameterf( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT );
+	(void)worker;
+
+	texcache_load( texture_paths[layer], TEXTURE_SIZE, TEXTURE_SIZE, tex_format, &loads[layer] );
+}
+
+/* one grey texel per layer, bound until the loaded textures are resident */
+static void 
+texture_placeholder( void )
+{
+	unsigned char grey[3 * TEXTURES];
+
+	memset( grey, 128, sizeof(grey) );
+
+	glActiveTexture( GL_TEXTURE0 + TEX_UNIT_TEXTURES );
+	glGenTextures( 1, &tex_layers );
+	glBindTexture( GL_TEXTURE_2D_ARRAY, tex_layers );
+	glTexStorage3D( GL_TEXTURE_2D_ARRAY, 1, GL_RGB8, 1, 1, TEXTURES );
+
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+	glTexSubImage3D( GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, 1, 1, TEXTURES, GL_RGB, GL_UNSIGNED_BYTE, grey );
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	glActiveTexture( GL_TEXTURE0 );
+}
+
+/*
+	the loaded layers copied into one pixel buffer and uploaded from it as a new BC1 or rgb
+	array with their prebuilt mips, which replaces the placeholder or the previous array;
+	layers that failed to load are filled with grey instead of being left undefined
+*/
+static void 
+texture_upload( void )
+{
+	/*both endpoints 565 grey, every index 0*/
+	static const unsigned char grey[8] = { 0x10, 0x84, 0x10, 0x84, 0, 0, 0, 0 };
+	unsigned char	*ptr;
+	unsigned int	i, level, w, h, levels, chain, loaded = 0, offset;
+	GLuint			array, pbo;
+
+	w = h = TEXTURE_SIZE;
+	chain = texcache_level_bytes( tex_format, w, h );
+	for ( levels = 1; w > 1 || h > 1; levels++ ) {
+		w = w > 1 ? w / 2 : 1;
+		h = h > 1 ? h / 2 : 1;
+		chain += texcache_level_bytes( tex_format, w, h );
+	}
+
+	for ( i = 0; i < TEXTURES; i++ ) {
+		if ( tex_loads[i].blocks && ( tex_loads[i].format != tex_format || tex_loads[i].bytes != chain ) ) {
+			texcache_release( &tex_loads[i] );
+		}
+		loaded += tex_loads[i].blocks != NULL;
+	}
+
+	if ( !loaded ) {
+		return;
+	}
+
+	glGenBuffers( 1, &pbo );
+	glBindBuffer( GL_PIXEL_UNPACK_BUFFER, pbo );
+	glBufferData( GL_PIXEL_UNPACK_BUFFER, chain * TEXTURES, NULL, GL_STREAM_DRAW );
+
+	ptr = (unsigned char *)glMapBufferRange( GL_PIXEL_UNPACK_BUFFER, 0, chain * TEXTURES, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT );
+	if ( ptr ) {
+		for ( i = 0; i < TEXTURES; i++ ) {
+			if ( tex_loads[i].blocks ) {
+				memcpy( ptr + i * chain, tex_loads[i].blocks, chain );
+				continue;
+			}
+
+			if ( tex_format == TEXCACHE_FORMAT_RGB ) {
+				memset( ptr + i * chain, 128, chain );
+				continue;
+			}
+
+			for ( offset = 0; offset < chain; offset += sizeof(grey) ) {
+				memcpy( ptr + i * chain + offset, grey, sizeof(grey) );
+			}
+		}
+		glUnmapBuffer( GL_PIXEL_UNPACK_BUFFER );
+
+		glActiveTexture( GL_TEXTURE0 + TEX_UNIT_TEXTURES );
+		glGenTextures( 1, &array );
+		glBindTexture( GL_TEXTURE_2D_ARRAY, array );
+		glTexStorage3D( GL_TEXTURE_2D_ARRAY, levels, tex_format, TEXTURE_SIZE, TEXTURE_SIZE, TEXTURES );
+
+		/*rgb rows of the small levels are not padded to 4 bytes*/
+		glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+
+		offset = 0;
+		for ( i = 0; i < TEXTURES; i++ ) {
+			w = TEXTURE_SIZE;
+			h = TEXTURE_SIZE;
+			for ( level = 0; level < levels; level++ ) {
+				if ( tex_format == TEXCACHE_FORMAT_RGB ) {
+					glTexSubImage3D( GL_TEXTURE_2D_ARRAY, level, 0, 0, i, w, h, 1, GL_RGB, GL_UNSIGNED_BYTE, (const GLvoid *)(size_t)offset );
+				}
+				else {
+					glCompressedTexSubImage3D( GL_TEXTURE_2D_ARRAY, level, 0, 0, i, w, h, 1, tex_format, texcache_level_bytes( tex_format, w, h ), (const GLvoid *)(size_t)offset );
+				}
+				offset += texcache_level_bytes( tex_format, w, h );
+				w = w > 1 ? w / 2 : 1;
+				h = h > 1 ? h / 2 : 1;
+			}
+		}
+
+		glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+
+		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
+		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT );
+		glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT );
+		glActiveTexture( GL_TEXTURE0 );
+
+		glDeleteTextures( 1, &tex_layers );
+		tex_layers = array;
 
-		glUniform1i( tex_l, tex_unit_id );
+		fprintf( stdout, "textures resident after %.1f ms, %u of %u loaded\n", ( glfwGetTime() - tex_start ) * 1000.0, loaded, (unsigned int)TEXTURES );
+	}
+
+	/*deleted once the uploads sourcing it are done*/
+	glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+	glDeleteBuffers( 1, &pbo );
+}
+
+/* once per frame, never waits: uploads the textures when their jobs are done */
+static void 
+textures_update( void )
+{
+	unsigned int i;
 
-		SOIL_free_image_data( img );
+	if ( !tex_loading || pool_busy( tex_pool ) ) {
+		return;
 	}
+
+	texture_upload();
+
+	for ( i = 0; i < TEXTURES; i++ ) {
+		texcache_release( &tex_loads[i] );
+	}
+	tex_loading = FALSE;
 }
 
+/* starts loading every texture as a layer of one BC1 or rgb array, the current one stays bound meanwhile */
 static void 
-load_textures()
+load_textures( void )
+{
+	if ( tex_loading ) {
+		fprintf( stdout, "textures are still loading\n" );
+		return;
+	}
+
+	/*decoded on every load then, the cache only holds BC1*/
+	if ( !GLEW_EXT_texture_compression_s3tc && tex_format != TEXCACHE_FORMAT_RGB ) {
+		fprintf( stderr, "No S3TC texture compression, textures load uncompressed\n" );
+		tex_format = TEXCACHE_FORMAT_RGB;
+	}
+
+	/*bound first, so _textures is complete even when the loads cannot start*/
+	if ( !tex_layers ) {
+		texture_placeholder();
+	}
+
+	if ( !tex_pool ) {
+		/*worker 0 is the render thread, which takes no part*/
+		tex_pool = pool_create( TEXTURES + 1 );
+		if ( !tex_pool ) {
+			return;
+		}
+	}
+
+	tex_loading = TRUE;
+	tex_start = glfwGetTime();
+
+	pool_start( tex_pool, TEXTURES, texture_job, tex_loads );
+
+	while ( tex_sync && tex_loading ) {
+		pool_wait( tex_pool );
+		textures_update();
+	}
+}
+
+/* the material table as a uniform block bound once for every pass, and the MAT_* ids */
+static int 
+load_materials( void )
 {
-	load_texture( "../textures/Brick_Design_UV_H_CM_1.png", GL_TEXTURE0, 0, tex1_l );
-	load_texture( "../textures/Ground10_1.png", GL_TEXTURE1, 1, tex2_l );
-	load_texture( "../textures/Moss_01_UV_H_CM_1.png", GL_TEXTURE2, 2, tex3_l );
+	material_t		rows[sizeof(materials) / sizeof(materials[0])];
+	unsigned int	i, count = sizeof(materials) / sizeof(materials[0]);
+	size_t			used = 0;
+	int				n;
+
+	n = _snprintf_s( material_defines, sizeof(material_defines), _TRUNCATE, "#define MATERIALS %u\n", count );
+	for ( i = 0; i < count && n >= 0; i++ ) {
+		rows[i] = materials[i].row;
+		used += n;
+		n = _snprintf_s( material_defines + used, sizeof(material_defines) - used, _TRUNCATE, "#define MAT_%s %u.0\n", materials[i].name, i );
+	}
+
+	if ( n < 0 ) {
+		fprintf( stderr, "material ids do not fit in MATERIALS_DEFINES (%u bytes)\n", MATERIALS_DEFINES );
+		material_defines[0] = '\0';
+		return ERR;
+	}
+
+	ubo_materials.loc = UBO_BINDING_MATERIALS;
+	ubo_materials.size = sizeof(rows);
+	glGenBuffers( 1, &ubo_materials.handle );
+	glBindBuffer( GL_UNIFORM_BUFFER, ubo_materials.handle );
+	glBufferData( GL_UNIFORM_BUFFER, ubo_materials.size, rows, GL_STATIC_DRAW );
+	glBindBufferBase( GL_UNIFORM_BUFFER, ubo_materials.loc, ubo_materials.handle );
+
+	return OK;
 }
 
+/* the bvh walk is compiled in or out, a uniform branch around it still costs the in-line path */
 static void 
-load_shaders()
+pass_defines( pass_t *pass )
 {
-	program_create( &progs );
-	program_link( &progs );
+	/*passes built for the next scene take its layout*/
+	const bool baked = scene_ready ? scene_next.baked : scene_baked;
+	const bool bricks = baked && ( scene_ready ? scene_next.bake.sparse : bake.sparse );
 
-	glUseProgram( progs.prog );
+	_snprintf_s( pass->defines, sizeof(pass->defines), _TRUNCATE, "#define _PASS_%s\n%s%s%s%s%s%s%s%s", pass->name, sky ? "#define _SKY\n" : "", fog ? "#define _FOG\n" : "", fixed_camera ? "#define _ENABLE_FIXED_CAMERA\n" : "",
+		scene_bvh ? "#define _BVH_WALK\n" : "", scene_grid ? "#define _GRID_WALK\n" : "", baked ? "#define _BAKE_VOLUME\n" : "", bricks ? "#define _BAKE_BRICKS\n" : "", material_defines );
+	program_defines( &pass->prog, pass->defines );
+}
+
+static void 
+pass_bind( pass_t *pass )
+{
+	GLuint prog;
+
+	prog = pass->prog.prog;
+	glUseProgram( prog );
 
 	/*update uniforms locations*/
-	vp_l = glGetAttribLocation( progs.prog, "_vp" );
-	tex1_l = glGetUniformLocation( progs.prog, "_tex1" );
-	tex2_l = glGetUniformLocation( progs.prog, "_tex2" );
-	tex3_l = glGetUniformLocation( progs.prog, "_tex3" );
-	debug_l = glGetUniformLocation( progs.prog, "_debug" );
-	resolution_l = glGetUniformLocation( progs.prog, "_resolution" );
-	time_l = glGetUniformLocation( progs.prog, "_time" );
-	packy_pos_l = glGetUniformLocation( progs.prog, "_packy_pos" );
-	packy_angles_l = glGetUniformLocation( progs.prog, "_packy_angles" );
-	gogu_pos_l = glGetUniformLocation( progs.prog, "_gogu_pos" );
-	gogu_angles_l = glGetUniformLocation( progs.prog, "_gogu_angles" );
-	bonbons_l = glGetUniformLocation( progs.prog, "_bonbons" );
-	bonbon_count_l = glGetUniformLocation( progs.prog, "_bonbon_count" );
+	pass->vp = glGetAttribLocation( prog, "_vp" );
+	pass->resolution = glGetUniformLocation( prog, "_resolution" );
+	pass->time = glGetUniformLocation( prog, "_time" );
+	pass->omega = glGetUniformLocation( prog, "_omega" );
+	pass->reproject = glGetUniformLocation( prog, "_reproject" );
+	pass->frame = glGetUniformLocation( prog, "_frame" );
+	pass->prev_resolution = glGetUniformLocation( prog, "_prev_resolution" );
+	pass->cone_prepass = glGetUniformLocation( prog, "_cone_prepass" );
+	pass->shadow_scale = glGetUniformLocation( prog, "_shadow_scale" );
+	pass->shadow_lowres = glGetUniformLocation( prog, "_shadow_lowres" );
+	pass->packy_pos = glGetUniformLocation( prog, "_packy_pos" );
+	pass->packy_angles = glGetUniformLocation( prog, "_packy_angles" );
+	pass->gogu_pos = glGetUniformLocation( prog, "_gogu_pos" );
+	pass->gogu_angles = glGetUniformLocation( prog, "_gogu_angles" );
+	pass->bake_lo = glGetUniformLocation( prog, "_bake_lo" );
+	pass->bake_extent = glGetUniformLocation( prog, "_bake_extent" );
+	pass->bake_error = glGetUniformLocation( prog, "_bake_error" );
+	pass->bake_bricks = glGetUniformLocation( prog, "_bake_bricks" );
+
+	/*samplers stay on fixed units*/
+	glUniform1i( glGetUniformLocation( prog, "_textures" ), TEX_UNIT_TEXTURES );
+	glUniform1i( glGetUniformLocation( prog, "_gbuffer0" ), TEX_UNIT_GBUFFER0 );
+	glUniform1i( glGetUniformLocation( prog, "_gbuffer1" ), TEX_UNIT_GBUFFER1 );
+	glUniform1i( glGetUniformLocation( prog, "_history" ), TEX_UNIT_HISTORY );
+	glUniform1i( glGetUniformLocation( prog, "_cone" ), TEX_UNIT_CONE );
+	glUniform1i( glGetUniformLocation( prog, "_shadow" ), TEX_UNIT_SHADOW );
+	glUniform1i( glGetUniformLocation( prog, "_grid" ), TEX_UNIT_GRID );
+	glUniform1i( glGetUniformLocation( prog, "_bake" ), TEX_UNIT_BAKE );
+	glUniform1i( glGetUniformLocation( prog, "_bake_index" ), TEX_UNIT_BAKE_INDEX );
+	glUniform1i( glGetUniformLocation( prog, "_bake_mip" ), TEX_UNIT_BAKE_MIP );
+	glUniform1i( glGetUniformLocation( prog, "_color_image" ), IMAGE_UNIT_COLOR );
+	glUniform1i( glGetUniformLocation( prog, "_gbuffer0_image" ), IMAGE_UNIT_GBUFFER0 );
+	glUniform1i( glGetUniformLocation( prog, "_gbuffer1_image" ), IMAGE_UNIT_GBUFFER1 );
+
+	pass->camera = glGetUniformBlockIndex( prog, "camera_block" );
+	if ( pass->camera != GL_INVALID_INDEX ) {
+		glUniformBlockBinding( prog, pass->camera, UBO_BINDING_CAMERA );
+	}
+
+	pass->materials = glGetUniformBlockIndex( prog, "material_block" );
+	if ( pass->materials != GL_INVALID_INDEX ) {
+		glUniformBlockBinding( prog, pass->materials, UBO_BINDING_MATERIALS );
+	}
+
+	pass->bvh = glGetProgramResourceIndex( prog, GL_SHADER_STORAGE_BLOCK, "bvh_block" );
+	if ( pass->bvh != GL_INVALID_INDEX ) {
+		glShaderStorageBlockBinding( prog, pass->bvh, SSBO_BINDING_BVH );
+	}
+
+	pass->grid = glGetProgramResourceIndex( prog, GL_SHADER_STORAGE_BLOCK, "grid_block" );
+	if ( pass->grid != GL_INVALID_INDEX ) {
+		glShaderStorageBlockBinding( prog, pass->grid, SSBO_BINDING_GRID );
+	}
+}
+
+/* from takes no part any more, to owns its handles */
+static void 
+program_take( program *to, program *from )
+{
+	*to = *from;
+
+	from->prog = from->vert = from->frag = from->comp = 0;
+	from->linked = FALSE;
+}
+
+static void 
+variants_release( pass_t *pass )
+{
+	unsigned int i;
+
+	for ( i = 0; i < DEBUG_VIEWS; i++ ) {
+		program_destroy( &pass->variants[i] );
+	}
+}
+
+/* starts building the variant of a debug view into next, prog keeps running meanwhile */
+static int 
+pass_build( pass_t *pass, const unsigned int view )
+{
+	pass_defines( pass );
+
+	/*a variant built before is taken as it is*/
+	if ( pass->variants[view].linked ) {
+		program_take( &pass->next, &pass->variants[view] );
+		return OK;
+	}
+
+	program_variant( &pass->next, &pass->prog, debug_variants[view] );
+
+	if ( program_create( &pass->next ) != 0 ) {
+		program_destroy( &pass->next );
+		return ERR;
+	}
+
+	program_link_start( &pass->next );
+
+	return OK;
+}
+
+/*
+	the linked next program replaces the running one, which is kept as the variant of
+	the current debug view, or deleted along with every kept variant when they are stale
+*/
+static void 
+pass_swap( pass_t *pass, const bool keep )
+{
+	if ( keep ) {
+		program_destroy( &pass->variants[debugmode] );
+		program_take( &pass->variants[debugmode], &pass->prog );
+	}
+	else {
+		program_destroy( &pass->prog );
+		variants_release( pass );
+	}
+
+	program_take( &pass->prog, &pass->next );
+
+	pass_bind( pass );
+}
+
+/* builds the program of a pass and waits for it, a failed one leaves the running program */
+static void 
+load_pass( pass_t *pass )
+{
+	variants_release( pass );
+
+	if ( pass_build( pass, debugmode ) == OK && program_link_end( &pass->next ) == 0 ) {
+		pass_swap( pass, FALSE );
+	}
+	else {
+		program_destroy( &pass->next );
+	}
+}
+
+static void 
+reload_cancel( void )
+{
+	unsigned int i;
+
+	for ( i = 0; i < PASSES; i++ ) {
+		program_destroy( &passes[i]->next );
+	}
+
+	reloading = FALSE;
+}
+
+/*
+	starts building the variant of a debug view for every pass, the running programs stay
+	until all of them link; sources drops the kept variants, their files changed
+*/
+static void 
+reload_start( const unsigned int view, bool sources )
+{
+	unsigned int i;
+
+	/*the reload this one cancels may have been for a source change*/
+	sources = sources || ( reloading && reload_sources );
+
+	reload_cancel();
+
+	for ( i = 0; i < PASSES; i++ ) {
+		if ( sources ) {
+			variants_release( passes[i] );
+		}
+
+		if ( pass_build( passes[i], view ) != OK ) {
+			reload_cancel();
+			fprintf( stderr, "shader reload failed, the running programs stay\n" );
+			return;
+		}
+	}
+
+	reloading = TRUE;
+	reload_view = view;
+	reload_sources = sources;
+	reload_bvh = scene_bvh;
+	reload_grid = scene_grid;
+	reload_start_time = glfwGetTime();
+}
+
+/* values of the glsl names scene files may place primitives with, vars in the order of names */
+static bool 
+value_lookup( const float *const *vars, const float time, const char *name, float *value )
+{
+	static const char *names[] = { "_packy_pos", "_packy_angles", "_gogu_pos", "_gogu_angles" };
+	size_t	len, i;
+
+	if ( strcmp( name, "_time" ) == 0 ) {
+		*value = time;
+		return TRUE;
+	}
+
+	for ( i = 0; i < sizeof(names) / sizeof(names[0]); i++ ) {
+		len = strlen( names[i] );
+
+		if ( strncmp( name, names[i], len ) == 0 && name[len] == '.' && name[len + 1] >= 'x' && name[len + 1] <= 'z' && name[len + 2] == '\0' ) {
+			*value = vars[i][name[len + 1] - 'x'];
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static bool 
+scene_value( const char *name, float *value )
+{
+	const float *const vars[] = { packy_pos, packy_angles, gogu_pos, gogu_angles };
+
+	return value_lookup( vars, frame.time, name, value );
+}
+
+/* the copy scene_rebuild() took, the running values change while the job reads them */
+static bool 
+scene_next_value( const char *name, float *value )
+{
+	const float *const vars[] = { scene_next_vars[0], scene_next_vars[1], scene_next_vars[2], scene_next_vars[3] };
+
+	return value_lookup( vars, scene_next_time, name, value );
+}
+
+/* run headers then cell lists in the ssbo, first, count and empty distance of the cells in a 3d texture */
+static void 
+load_grid( void )
+{
+	const GLsizeiptr	runs = grid.run_count * sizeof(grid_run_t);
+	const GLsizeiptr	prims = grid.prim_count * sizeof(int);
+
+	if ( !ssbo_grid ) {
+		glGenBuffers( 1, &ssbo_grid );
+	}
+
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, ssbo_grid );
+	glBufferData( GL_SHADER_STORAGE_BUFFER, runs + prims, NULL, GL_STATIC_DRAW );
+	glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, runs, grid.runs );
+	glBufferSubData( GL_SHADER_STORAGE_BUFFER, runs, prims, grid.prims );
+
+	if ( tex_grid ) {
+		glDeleteTextures( 1, &tex_grid );
+	}
+
+	glGenTextures( 1, &tex_grid );
+	glActiveTexture( GL_TEXTURE0 + TEX_UNIT_GRID );
+	glBindTexture( GL_TEXTURE_3D, tex_grid );
+	glTexStorage3D( GL_TEXTURE_3D, 1, GL_RGBA32F, GRID_CELLS, GRID_CELLS, GRID_CELLS * grid.run_count );
+	glTexSubImage3D( GL_TEXTURE_3D, 0, 0, 0, 0, GRID_CELLS, GRID_CELLS, GRID_CELLS * grid.run_count, GL_RGBA, GL_FLOAT, grid.cells );
+	glTexParameteri( GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	glActiveTexture( GL_TEXTURE0 );
+
+	fprintf( stdout, "scene grid: %u runs, %u list entries\n", grid.run_count, grid.prim_count );
+}
+
+/* the voxels or brick atlas as R16F, filtered for trilinear samples, the brick index and the min pyramid */
+static void 
+load_bake( void )
+{
+	unsigned int	size[3], level;
+
+	if ( tex_bake ) {
+		glDeleteTextures( 1, &tex_bake );
+		tex_bake = 0;
+	}
+
+	if ( tex_bake_index ) {
+		glDeleteTextures( 1, &tex_bake_index );
+		tex_bake_index = 0;
+	}
+
+	if ( tex_bake_mip ) {
+		glDeleteTextures( 1, &tex_bake_mip );
+		tex_bake_mip = 0;
+	}
+
+	/*rows of halves are not padded to 4 bytes*/
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 2 );
+
+	glGenTextures( 1, &tex_bake );
+	glActiveTexture( GL_TEXTURE0 + TEX_UNIT_BAKE );
+	glBindTexture( GL_TEXTURE_3D, tex_bake );
+	glTexStorage3D( GL_TEXTURE_3D, 1, GL_R16F, bake.size[0], bake.size[1], bake.size[2] );
+	glTexSubImage3D( GL_TEXTURE_3D, 0, 0, 0, 0, bake.size[0], bake.size[1], bake.size[2], GL_RED, GL_HALF_FLOAT, bake.voxels );
+	glTexParameteri( GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE );
+
+	if ( bake.sparse ) {
+		glGenTextures( 1, &tex_bake_index );
+		glActiveTexture( GL_TEXTURE0 + TEX_UNIT_BAKE_INDEX );
+		glBindTexture( GL_TEXTURE_3D, tex_bake_index );
+		glTexStorage3D( GL_TEXTURE_3D, 1, GL_RGBA16F, bake.bricks[0], bake.bricks[1], bake.bricks[2] );
+		glTexSubImage3D( GL_TEXTURE_3D, 0, 0, 0, 0, bake.bricks[0], bake.bricks[1], bake.bricks[2], GL_RGBA, GL_HALF_FLOAT, bake.index );
+		glTexParameteri( GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+		glTexParameteri( GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	}
+
+	/*read with texelFetch only, one level per cell size*/
+	bake_mip( &bake, 0, size );
+	glGenTextures( 1, &tex_bake_mip );
+	glActiveTexture( GL_TEXTURE0 + TEX_UNIT_BAKE_MIP );
+	glBindTexture( GL_TEXTURE_3D, tex_bake_mip );
+	glTexStorage3D( GL_TEXTURE_3D, bake.levels, GL_R16F, size[0], size[1], size[2] );
+	for ( level = 0; level < bake.levels; level++ ) {
+		const unsigned short *mip = bake_mip( &bake, level, size );
+		glTexSubImage3D( GL_TEXTURE_3D, level, 0, 0, 0, size[0], size[1], size[2], GL_RED, GL_HALF_FLOAT, mip );
+	}
+	glTexParameteri( GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST );
+
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+	glActiveTexture( GL_TEXTURE0 );
+
+	fprintf( stdout, "scene bake: %u primitives, %ux%ux%u %s\n", scene.baked, bake.size[0], bake.size[1], bake.size[2], bake.sparse ? "atlas" : "voxels" );
+	bake_report( &bake, &scene );
+}
+
+/* the scene bvh, cell grid and baked volume, no gl calls so it runs on any thread */
+static void 
+scene_build( scene_build_t *build, scene_value_fn value )
+{
+	build->err = ERR;
+
+	if ( scene_load( scene_path, &build->scene ) != OK || bvh_build( &build->bvh, &build->scene, value ) != OK ) {
+		return;
+	}
 
-	ubo_cam.loc = glGetUniformBlockIndex( progs.prog, "camera_block" );
+	build->baked = build->bakes && bake_build( &build->bake, &build->scene, bake_voxels, bake_threads ) == OK && build->bake.voxels;
+	build->gridded = build->bvh.count > 0 && grid_build( &build->grid, &build->scene, value ) == OK;
+	build->err = OK;
+}
+
+static void 
+scene_build_release( scene_build_t *build )
+{
+	scene_release( &build->scene );
+	bvh_release( &build->bvh );
+	grid_release( &build->grid );
+	bake_release( &build->bake );
+
+	memset( build, 0, sizeof(scene_build_t) );
+}
+
+/* a build replaces the running scene, its bvh, cell grid and baked volume are uploaded */
+static void 
+scene_take( scene_build_t *build )
+{
+	scene_release( &scene );
+	bvh_release( &bvh );
+	grid_release( &grid );
+	bake_release( &bake );
+
+	scene = build->scene;
+	bvh = build->bvh;
+	grid = build->grid;
+	bake = build->bake;
+	scene_baked = build->baked;
+
+	if ( build->baked ) {
+		load_bake();
+	}
+
+	if ( bvh.count > 0 ) {
+		if ( !ssbo_bvh ) {
+			glGenBuffers( 1, &ssbo_bvh );
+		}
+
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, ssbo_bvh );
+		glBufferData( GL_SHADER_STORAGE_BUFFER, bvh.count * sizeof(bvh_node_t), bvh.nodes, bvh.dynamic ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW );
+	}
+
+	if ( build->gridded ) {
+		load_grid();
+	}
+
+	/*the running scene owns the arrays now*/
+	memset( build, 0, sizeof(scene_build_t) );
+}
+
+/* built at once, for the passes load_shaders() builds right after */
+static void 
+load_scene( void )
+{
+	scene_build_t build = { 0 };
+
+	build.bakes = scene_bake;
+	scene_build( &build, scene_value );
+	scene_take( &build );
+}
+
+static void 
+scene_job( void *userdata, const unsigned int index, const unsigned int worker )
+{
+	(void)index;
+	(void)worker;
+
+	scene_build( (scene_build_t *)userdata, scene_next_value );
+}
+
+/* waits for a build in flight and drops it along with one waiting for its passes */
+static void 
+scene_cancel( void )
+{
+	if ( scene_building ) {
+		pool_wait( scene_pool );
+		scene_building = FALSE;
+	}
+
+	scene_build_release( &scene_next );
+	scene_ready = FALSE;
+	scene_again = FALSE;
+}
+
+/* starts building the next scene, the running one and its passes stay until both are done */
+static void 
+scene_rebuild( void )
+{
+	if ( scene_building ) {
+		scene_again = TRUE;
+		return;
+	}
+
+	/*the passes in flight were started for the scene this one replaces*/
+	if ( scene_ready ) {
+		reload_cancel();
+		scene_cancel();
+	}
+
+	if ( !scene_pool ) {
+		/*worker 0 is the render thread, which takes no part*/
+		scene_pool = pool_create( 2 );
+		if ( !scene_pool ) {
+			return;
+		}
+	}
+
+	scene_next_time = frame.time;
+	vec3_mov( scene_next_vars[0], packy_pos );
+	vec3_mov( scene_next_vars[1], packy_angles );
+	vec3_mov( scene_next_vars[2], gogu_pos );
+	vec3_mov( scene_next_vars[3], gogu_angles );
+
+	/*read by the job, F12 may flip it meanwhile*/
+	scene_next.bakes = scene_bake;
+
+	scene_building = TRUE;
+	scene_start_time = glfwGetTime();
+
+	pool_start( scene_pool, 1, scene_job, &scene_next );
+}
+
+/*
+	once per frame, never waits: a written shader restarts the reload, a written scene file
+	rebuilds the scene first; linked programs are swapped in together, with the scene they
+	were built for
+*/
+static void 
+reload_update( void )
+{
+	unsigned int	i;
+	int				err = 0;
+
+	if ( shader_watch && watch_changed( shader_watch ) ) {
+		reload_start( reloading ? reload_view : debugmode, TRUE );
+	}
+
+	/*a change while the scene builds is taken once it is done*/
+	if ( scene_watch && !scene_building && watch_changed( scene_watch ) ) {
+		scene_rebuild();
+	}
+
+	if ( scene_building && !pool_busy( scene_pool ) ) {
+		scene_building = FALSE;
+
+		if ( scene_again ) {
+			scene_cancel();
+			scene_rebuild();
+		}
+		else if ( scene_next.err != OK ) {
+			scene_cancel();
+			fprintf( stderr, "scene rebuild failed, the running scene stays\n" );
+		}
+		else {
+			fprintf( stdout, "scene built in %.1f ms\n", ( glfwGetTime() - scene_start_time ) * 1000.0 );
+			scene_ready = TRUE;
+			reload_start( reloading ? reload_view : debugmode, TRUE );
+
+			if ( !reloading ) {
+				scene_cancel();
+			}
+		}
+	}
+
+	if ( !reloading ) {
+		return;
+	}
+
+	for ( i = 0; i < PASSES; i++ ) {
+		if ( program_busy( &passes[i]->next ) ) {
+			return;
+		}
+	}
+
+	for ( i = 0; i < PASSES; i++ ) {
+		err |= program_link_end( &passes[i]->next );
+	}
+
+	if ( err != 0 ) {
+		reload_cancel();
+		scene_cancel();
+		fprintf( stderr, "shader reload failed, the running programs stay\n" );
+		return;
+	}
+
+	if ( scene_ready ) {
+		scene_take( &scene_next );
+		scene_ready = FALSE;
+	}
+
+	for ( i = 0; i < PASSES; i++ ) {
+		pass_swap( passes[i], !reload_sources );
+	}
+	reloading = FALSE;
+	running_bvh = reload_bvh;
+	running_grid = reload_grid;
+
+	if ( reload_view != debugmode ) {
+		debugmode = reload_view;
+		fprintf( stdout, "debug view %u in %.1f ms\n", debugmode, ( glfwGetTime() - reload_start_time ) * 1000.0 );
+	}
+	else {
+		fprintf( stdout, "shaders reloaded in %.1f ms\n", ( glfwGetTime() - reload_start_time ) * 1000.0 );
+	}
+}
+
+/* the scene and every pass at once, on startup only; later changes go through reload_update() */
+static void 
+load_shaders()
+{
+	double start = glfwGetTime();
+
+	load_scene();
+
+	load_pass( &cone_pass );
+	load_pass( &gbuffer_pass );
+	load_pass( &compute_pass );
+	load_pass( &shadow_pass );
+	load_pass( &light_pass );
+	running_bvh = scene_bvh;
+	running_grid = scene_grid;
+
+	/*glFinish so the time includes the compiles a driver defers*/
+	glFinish();
+	fprintf( stdout, "shaders loaded in %.1f ms\n", ( glfwGetTime() - start ) * 1000.0 );
+}
+
+static void 
+targets_destroy( void )
+{
+	if ( fbo_gbuffer[0] ) {
+		glDeleteFramebuffers( 2, fbo_gbuffer );
+		fbo_gbuffer[0] = fbo_gbuffer[1] = 0;
+	}
+
+	if ( fbo_light ) {
+		glDeleteFramebuffers( 1, &fbo_light );
+		fbo_light = 0;
+	}
+
+	if ( fbo_cone ) {
+		glDeleteFramebuffers( 1, &fbo_cone );
+		glDeleteTextures( 1, &tex_cone );
+		fbo_cone = tex_cone = 0;
+	}
+
+	if ( fbo_shadow ) {
+		glDeleteFramebuffers( 1, &fbo_shadow );
+		glDeleteTextures( 1, &tex_shadow );
+		fbo_shadow = tex_shadow = 0;
+	}
+
+	if ( tex_color ) {
+		glDeleteTextures( 1, &tex_color );
+		glDeleteTextures( 2, tex_gbuffer0 );
+		glDeleteTextures( 1, &tex_gbuffer1 );
+		tex_color = tex_gbuffer0[0] = tex_gbuffer0[1] = tex_gbuffer1 = 0;
+	}
+
+	if ( rb_depth ) {
+		glDeleteRenderbuffers( 1, &rb_depth );
+		rb_depth = 0;
+	}
+
+	target_width = target_height = 0;
+	history_valid = FALSE;
+}
+
+static GLuint 
+target_texture( const GLenum format, const unsigned int width, const unsigned int height )
+{
+	GLuint tex;
+
+	glGenTextures( 1, &tex );
+	glBindTexture( GL_TEXTURE_2D, tex );
+	glTexStorage2D( GL_TEXTURE_2D, 1, format, width, height );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+
+	return tex;
+}
+
+/* (re)creates the deferred targets when the window size changed */
+static int 
+targets_setup( const unsigned int width, const unsigned int height )
+{
+	static const GLenum buffers[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+	GLenum status = GL_FRAMEBUFFER_COMPLETE;
+	unsigned int i;
+
+	if ( width == target_width && height == target_height ) {
+		return OK;
+	}
+
+	targets_destroy();
+
+	/*created on a gbuffer unit to leave the material textures bound, update() rebinds them*/
+	glActiveTexture( GL_TEXTURE0 + TEX_UNIT_GBUFFER0 );
+	tex_color = target_texture( GL_RGBA8, width, height );
+	tex_gbuffer0[0] = target_texture( GL_RGBA32F, width, height );
+	tex_gbuffer0[1] = target_texture( GL_RGBA32F, width, height );
+	tex_gbuffer1 = target_texture( GL_RGBA16F, width, height );
+	tex_cone = target_texture( GL_R32F, ( width + CONE_TILE - 1 ) / CONE_TILE, ( height + CONE_TILE - 1 ) / CONE_TILE );
+	tex_shadow = target_texture( GL_RG8, ( width + shadow_scale - 1 ) / shadow_scale, ( height + shadow_scale - 1 ) / shadow_scale );
+	glActiveTexture( GL_TEXTURE0 );
+
+	glGenRenderbuffers( 1, &rb_depth );
+	glBindRenderbuffer( GL_RENDERBUFFER, rb_depth );
+	glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height );
+
+	glGenFramebuffers( 2, fbo_gbuffer );
+	for ( i = 0; i < 2; i++ ) {
+		glBindFramebuffer( GL_FRAMEBUFFER, fbo_gbuffer[i] );
+		glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex_color, 0 );
+		glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, tex_gbuffer0[i], 0 );
+		glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, tex_gbuffer1, 0 );
+		glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rb_depth );
+		glDrawBuffers( 3, buffers );
+
+		if ( status == GL_FRAMEBUFFER_COMPLETE ) {
+			status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+		}
+	}
+
+	/*gbuffer textures are sampled here, so they can not be attached*/
+	glGenFramebuffers( 1, &fbo_light );
+	glBindFramebuffer( GL_FRAMEBUFFER, fbo_light );
+	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex_color, 0 );
+	glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rb_depth );
+
+	if ( status == GL_FRAMEBUFFER_COMPLETE ) {
+		status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+	}
+
+	glGenFramebuffers( 1, &fbo_cone );
+	glBindFramebuffer( GL_FRAMEBUFFER, fbo_cone );
+	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex_cone, 0 );
+
+	if ( status == GL_FRAMEBUFFER_COMPLETE ) {
+		status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+	}
+
+	glGenFramebuffers( 1, &fbo_shadow );
+	glBindFramebuffer( GL_FRAMEBUFFER, fbo_shadow );
+	glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex_shadow, 0 );
+
+	if ( status == GL_FRAMEBUFFER_COMPLETE ) {
+		status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+	}
+
+	glBindFramebuffer( GL_FRAMEBUFFER, wnd_framebuffer() );
+
+	if ( status != GL_FRAMEBUFFER_COMPLETE ) {
+		fprintf( stderr, "deferred targets incomplete (0x%x)\n", status );
+		targets_destroy();
+		return ERR;
+	}
+
+	target_width = width;
+	target_height = height;
+
+	return OK;
 }
 
 static void 
@@ -145,20 +1218,99 @@ in_update()
 	}
 
 	if ( keydata[RDFKEY_F1].pressed ) {
-		load_shaders();
-		load_textures();
+		/*the scene is rebuilt in the background, then the programs*/
+		scene_rebuild();
 
 		/*only once*/
 		keydata[RDFKEY_F1].pressed = FALSE;
 	}
 
 	if ( keydata[RDFKEY_F5].pressed ) {
-		debugmode += 1;
-		if ( debugmode > 3 ) debugmode = 0;
+		reload_start( ( ( reloading ? reload_view : debugmode ) + 1 ) % DEBUG_VIEWS, FALSE );
 		/*only once*/
 		keydata[RDFKEY_F5].pressed = FALSE;
 	}
 
+	if ( keydata[RDFKEY_F3].pressed ) {
+		dynres = !dynres;
+		fprintf( stdout, "dynamic resolution %s\n", dynres ? "on" : "off" );
+		/*only once*/
+		keydata[RDFKEY_F3].pressed = FALSE;
+	}
+
+	if ( keydata[RDFKEY_F4].pressed ) {
+		reproject = !reproject;
+		fprintf( stdout, "reprojection %s\n", reproject ? "on" : "off" );
+		/*only once*/
+		keydata[RDFKEY_F4].pressed = FALSE;
+	}
+
+	if ( keydata[RDFKEY_F6].pressed ) {
+		cone_prepass = !cone_prepass;
+		fprintf( stdout, "cone prepass %s\n", cone_prepass ? "on" : "off" );
+		/*only once*/
+		keydata[RDFKEY_F6].pressed = FALSE;
+	}
+
+	if ( keydata[RDFKEY_F7].pressed ) {
+		shadow_lowres = !shadow_lowres;
+		fprintf( stdout, "low resolution shadows %s\n", shadow_lowres ? "on" : "off" );
+		/*only once*/
+		keydata[RDFKEY_F7].pressed = FALSE;
+	}
+
+	if ( keydata[RDFKEY_F8].pressed ) {
+		compute_primary = !compute_primary;
+		fprintf( stdout, "compute primary rays %s\n", compute_primary ? "on" : "off" );
+		/*only once*/
+		keydata[RDFKEY_F8].pressed = FALSE;
+	}
+
+	if ( keydata[RDFKEY_F9].pressed ) {
+		relax = !relax;
+		fprintf( stdout, "over relaxed tracing %s\n", relax ? "on" : "off" );
+		/*only once*/
+		keydata[RDFKEY_F9].pressed = FALSE;
+	}
+
+	if ( keydata[RDFKEY_F10].pressed ) {
+		scene_bvh = !scene_bvh;
+		fprintf( stdout, "scene bvh %s\n", scene_bvh ? "on" : "off" );
+		/*only the passes change, the scene data has the bvh and grid either way*/
+		reload_start( reloading ? reload_view : debugmode, TRUE );
+		/*only once*/
+		keydata[RDFKEY_F10].pressed = FALSE;
+	}
+
+	if ( keydata[RDFKEY_F11].pressed ) {
+		scene_grid = !scene_grid;
+		fprintf( stdout, "scene grid %s\n", scene_grid ? "on" : "off" );
+		/*only the passes change, the scene data has the bvh and grid either way*/
+		reload_start( reloading ? reload_view : debugmode, TRUE );
+		/*only once*/
+		keydata[RDFKEY_F11].pressed = FALSE;
+	}
+
+	if ( keydata[RDFKEY_F12].pressed ) {
+		scene_bake = !scene_bake;
+		fprintf( stdout, "baked volume %s\n", scene_bake ? "on" : "off" );
+		/*baked or not in the background, the running passes stay until the new ones link*/
+		scene_rebuild();
+		/*only once*/
+		keydata[RDFKEY_F12].pressed = FALSE;
+	}
+
+	if ( keydata[RDFKEY_F2].pressed ) {
+		if ( stats_csv_active() ) {
+			stats_csv_close();
+		}
+		else {
+			stats_csv_open( stats_path );
+		}
+		/*only once*/
+		keydata[RDFKEY_F2].pressed = FALSE;
+	}
+
 	vec3_mov( dir, frame.view.dir );
 	vec3_mov( right, frame.view.right );
 	vec3_mov( up, def_up );
@@ -310,10 +1462,11 @@ view_update()
 	memcpy( &prevframe, &frame, sizeof(frame_t) );
 }
 
-static void
-ubo_setup( ubo_t *ubo )
+static void 
+ubo_setup( ubo_t *ubo, const GLuint prog, const GLuint block, const GLuint binding )
 {
-	glGetActiveUniformBlockiv( progs.prog, ubo->loc, GL_UNIFORM_BLOCK_DATA_SIZE, &( ubo->size ) );
+	ubo->loc = binding;
+	glGetActiveUniformBlockiv( prog, block, GL_UNIFORM_BLOCK_DATA_SIZE, &( ubo->size ) );
 
 	glGenBuffers( 1, &( ubo->handle ) );
 	glBindBuffer( GL_UNIFORM_BUFFER, ubo->handle );
@@ -330,20 +1483,58 @@ init( void )
 		+1.0f, +1.0f, 0.0f, +1.0f };
 	GLuint indices_data[] = { 0, 1, 2, 1, 3, 2 };
 
-	program_set( &progs, "../shaders/frag.glsl", GL_FRAGMENT_SHADER );
-	program_set( &progs, "../shaders/vert.glsl", GL_VERTEX_SHADER );
+	program_set( &cone_pass.prog, "../shaders/frag.glsl", GL_FRAGMENT_SHADER );
+	program_set( &cone_pass.prog, "../shaders/vert.glsl", GL_VERTEX_SHADER );
+	cone_pass.name = "CONE";
+
+	program_set( &gbuffer_pass.prog, "../shaders/frag.glsl", GL_FRAGMENT_SHADER );
+	program_set( &gbuffer_pass.prog, "../shaders/vert.glsl", GL_VERTEX_SHADER );
+	gbuffer_pass.name = "GBUFFER";
+
+	program_set( &compute_pass.prog, "../shaders/frag.glsl", GL_COMPUTE_SHADER );
+	compute_pass.name = "COMPUTE";
+
+	program_set( &shadow_pass.prog, "../shaders/frag.glsl", GL_FRAGMENT_SHADER );
+	program_set( &shadow_pass.prog, "../shaders/vert.glsl", GL_VERTEX_SHADER );
+	shadow_pass.name = "SHADOW";
+
+	program_set( &light_pass.prog, "../shaders/frag.glsl", GL_FRAGMENT_SHADER );
+	program_set( &light_pass.prog, "../shaders/vert.glsl", GL_VERTEX_SHADER );
+	light_pass.name = "LIGHT";
+
+	program_scene( &cone_pass.prog, scene_path );
+	program_scene( &gbuffer_pass.prog, scene_path );
+	program_scene( &compute_pass.prog, scene_path );
+	program_scene( &shadow_pass.prog, scene_path );
+	program_scene( &light_pass.prog, scene_path );
 
 	glGenVertexArrays( 1, &vao );
 	glBindVertexArray( vao );
 
+	/*without the MAT_* ids the passes fail to compile and print why, like any broken shader*/
+	if ( load_materials() != OK ) {
+		fprintf( stderr, "passes built without material ids\n" );
+	}
+
+	program_parallel();
 	load_shaders();
 	load_textures();
 
+	shader_watch = watch_create( "../shaders", ".glsl" );
+	scene_watch = watch_create( "../scenes", ".scene" );
+
 	/*initialize view controls and game state*/
 	view_init();
 
 	/*ubos*/
-	ubo_setup( &ubo_cam );
+	ubo_setup( &ubo_cam, gbuffer_pass.prog.prog, gbuffer_pass.camera, UBO_BINDING_CAMERA );
+
+
+	stage_cone = stats_stage( "cone" );
+	stage_gbuffer = stats_stage( "gbuffer" );
+	stage_shadow = stats_stage( "shadow" );
+	stage_light = stats_stage( "light" );
+	stage_resolve = stats_stage( "resolve" );
 
 	/*vertices*/
 	glGenBuffers( 1, &vertices );
@@ -358,16 +1549,95 @@ init( void )
 	glClearColor( 0.0f, 0.0f, 0.0f, 0.0f );
 }
 
+/* steers the render scale towards dynres_target_ms from the measured gpu frame time */
+static void 
+dynres_update( void )
+{
+	float gpu, scale;
+
+	if ( !dynres ) {
+		dynres_scale = 1.0f;
+	}
+	/*only react to new measurements, they lag a few frames behind*/
+	else if ( stats_frame_id() != dynres_frame ) {
+		dynres_frame = stats_frame_id();
+		gpu = (float)stats_frame_gpu_ms();
+
+		if ( gpu > 0.0f ) {
+			/*cost follows the pixel count, so the side scales with the square root*/
+			scale = dynres_scale * sqrtf( dynres_target_ms / gpu );
+
+			/*damped, with a dead zone so the size does not flicker around the target*/
+			if ( fabsf( scale - dynres_scale ) > 0.02f ) {
+				dynres_scale += ( scale - dynres_scale ) * 0.5f;
+			}
+
+			dynres_scale = ( dynres_scale < dynres_min ) ? dynres_min : dynres_scale;
+			dynres_scale = ( dynres_scale > 1.0f ) ? 1.0f : dynres_scale;
+		}
+	}
+
+	render_width = (unsigned int)( frame.width * dynres_scale );
+	render_height = (unsigned int)( frame.height * dynres_scale );
+
+	render_width = ( render_width < 1 ) ? 1 : render_width;
+	render_height = ( render_height < 1 ) ? 1 : render_height;
+
+	cone_width = ( render_width + CONE_TILE - 1 ) / CONE_TILE;
+	cone_height = ( render_height + CONE_TILE - 1 ) / CONE_TILE;
+
+	shadow_width = ( render_width + shadow_scale - 1 ) / shadow_scale;
+	shadow_height = ( render_height + shadow_scale - 1 ) / shadow_scale;
+}
+
+static void 
+pass_use( const pass_t *pass )
+{
+	glUseProgram( pass->prog.prog );
+
+	glUniform1f( pass->time, frame.time );
+	glUniform1f( pass->omega, relax ? relax_omega : 1.0f );
+	glUniform3f( pass->resolution, (GLfloat)render_width, (GLfloat)render_height, 0.0 );
+	glUniform3fv( pass->packy_pos, 1, packy_pos );
+	glUniform3fv( pass->packy_angles, 1, packy_angles );
+	glUniform3fv( pass->gogu_pos, 1, gogu_pos );
+	glUniform3fv( pass->gogu_angles, 1, gogu_angles );
+	glUniform3fv( pass->bake_lo, 1, bake.lo );
+	glUniform3fv( pass->bake_extent, 1, bake.extent );
+	glUniform1f( pass->bake_error, bake.error );
+	glUniform3f( pass->bake_bricks, (float)bake.bricks[0], (float)bake.bricks[1], (float)bake.bricks[2] );
+}
+
+static void 
+pass_draw( const pass_t *pass )
+{
+	pass_use( pass );
+
+	glEnableVertexAttribArray( pass->vp );
+	glVertexAttribPointer( pass->vp, 4, GL_FLOAT, GL_FALSE, 0, NULL );
+
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, indices );
+	glDrawElements( GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0 );
+
+	glDisableVertexAttribArray( pass->vp );
+}
+
 static void 
 update( void )
 {
+	const pass_t *primary;
+
+	textures_update();
+	reload_update();
 	view_update();
 
-	glViewport( 0, 0, frame.width, frame.height );
+	if ( targets_setup( frame.width, frame.height ) != OK ) {
+		return;
+	}
 
-	glUniform1f( time_l, frame.time );
-	glUniform1i( debug_l, debugmode );
-	glUniform3f( resolution_l, (GLfloat)frame.width, (GLfloat)frame.height, 0.0 );
+	dynres_update();
+
+	glViewport( 0, 0, render_width, render_height );
 
 	glBindBufferBase( GL_UNIFORM_BUFFER, ubo_cam.loc, ubo_cam.handle );
 	vec4_t *ptr = (vec4_t*)glMapBufferRange( GL_UNIFORM_BUFFER, 0, ubo_cam.size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT );
@@ -375,25 +1645,177 @@ update( void )
 	vec4_mov( ptr[1], frame.view.dir );
 	vec4_mov( ptr[2], frame.view.right );
 	vec4_mov( ptr[3], frame.view.up );
+	vec4_mov( ptr[4], history_view.pos );
+	vec4_mov( ptr[5], history_view.dir );
+	vec4_mov( ptr[6], history_view.right );
+	vec4_mov( ptr[7], history_view.up );
 	glUnmapBuffer( GL_UNIFORM_BUFFER );
 
-	glClear( GL_COLOR_BUFFER_BIT );
+	/*moving primitives keep their place in the tree, only the boxes up to the root grow or shrink*/
+	if ( running_bvh && bvh.count > 0 ) {
+		glBindBufferBase( GL_SHADER_STORAGE_BUFFER, SSBO_BINDING_BVH, ssbo_bvh );
 
-	glEnableVertexAttribArray( vp_l );
-	glVertexAttribPointer( vp_l, 4, GL_FLOAT, GL_FALSE, 0, NULL );
+		if ( bvh_refit( &bvh, &scene, scene_value ) ) {
+			glBufferSubData( GL_SHADER_STORAGE_BUFFER, 0, bvh.count * sizeof(bvh_node_t), bvh.nodes );
+		}
+	}
 
-	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, indices );
-	glDrawElements( GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0 );
+	/*the grid holds static primitives only, nothing to refit*/
+	if ( running_grid && grid.run_count > 0 ) {
+		glBindBufferBase( GL_SHADER_STORAGE_BUFFER, SSBO_BINDING_GRID, ssbo_grid );
+	}
+
+	/*conservative start distance per tile, _resolution stays the full render size*/
+	if ( cone_prepass && !compute_primary ) {
+		stats_begin( stage_cone );
+
+		glBindFramebuffer( GL_FRAMEBUFFER, fbo_cone );
+		glViewport( 0, 0, cone_width, cone_height );
+
+		pass_draw( &cone_pass );
+
+		glViewport( 0, 0, render_width, render_height );
+
+		stats_end( stage_cone );
+	}
+
+	/*primary hits, depth 0 where a surface still needs shading*/
+	stats_begin( stage_gbuffer );
+
+	glActiveTexture( GL_TEXTURE0 + TEX_UNIT_HISTORY );
+	glBindTexture( GL_TEXTURE_2D, tex_gbuffer0[current ^ 1] );
+	glActiveTexture( GL_TEXTURE0 + TEX_UNIT_CONE );
+	glBindTexture( GL_TEXTURE_2D, tex_cone );
+	glActiveTexture( GL_TEXTURE0 );
+
+	primary = compute_primary ? &compute_pass : &gbuffer_pass;
+
+	pass_use( primary );
+	glUniform1i( primary->reproject, reproject && history_valid );
+	glUniform1i( primary->cone_prepass, cone_prepass );
+	glUniform1i( primary->frame, (GLint)( frame_index++ % 1024 ) );
+	glUniform3f( primary->prev_resolution, (GLfloat)history_width, (GLfloat)history_height, 0.0 );
+
+	if ( compute_primary ) {
+		glBindImageTexture( IMAGE_UNIT_COLOR, tex_color, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8 );
+		glBindImageTexture( IMAGE_UNIT_GBUFFER0, tex_gbuffer0[current], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F );
+		glBindImageTexture( IMAGE_UNIT_GBUFFER1, tex_gbuffer1, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F );
+
+		/*one work group per cone tile*/
+		glDispatchCompute( cone_width, cone_height, 1 );
+
+		/*read back as textures and blended into by the light pass*/
+		glMemoryBarrier( GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT );
+	}
+	else {
+		glBindFramebuffer( GL_FRAMEBUFFER, fbo_gbuffer[current] );
+		glEnable( GL_DEPTH_TEST );
+		glDepthFunc( GL_ALWAYS );
+		glDepthMask( GL_TRUE );
+
+		pass_draw( primary );
+
+		glDisable( GL_DEPTH_TEST );
+	}
+
+	/*this frame becomes the history of the next one*/
+	memcpy( &history_view, &frame.view, sizeof(view_t) );
+	history_width = render_width;
+	history_height = render_height;
+	history_valid = TRUE;
+
+	stats_end( stage_gbuffer );
+
+	glActiveTexture( GL_TEXTURE0 + TEX_UNIT_GBUFFER0 );
+	glBindTexture( GL_TEXTURE_2D, tex_gbuffer0[current] );
+	glActiveTexture( GL_TEXTURE0 + TEX_UNIT_GBUFFER1 );
+	glBindTexture( GL_TEXTURE_2D, tex_gbuffer1 );
+	glActiveTexture( GL_TEXTURE0 + TEX_UNIT_SHADOW );
+	glBindTexture( GL_TEXTURE_2D, tex_shadow );
+	glActiveTexture( GL_TEXTURE0 );
+
+	/*shadow rays from the gbuffer at reduced resolution, no depth test at this size*/
+	if ( shadow_lowres ) {
+		stats_begin( stage_shadow );
+
+		glBindFramebuffer( GL_FRAMEBUFFER, fbo_shadow );
+		glViewport( 0, 0, shadow_width, shadow_height );
+
+		glUseProgram( shadow_pass.prog.prog );
+		glUniform1i( shadow_pass.shadow_scale, shadow_scale );
+
+		pass_draw( &shadow_pass );
+
+		glViewport( 0, 0, render_width, render_height );
+
+		stats_end( stage_shadow );
+	}
+
+	/*the quad sits at depth 0.5, early depth test drops sky and debug pixels, the compute path discards them*/
+	stats_begin( stage_light );
+
+	glBindFramebuffer( GL_FRAMEBUFFER, fbo_light );
+	if ( !compute_primary ) {
+		glEnable( GL_DEPTH_TEST );
+		glDepthFunc( GL_GREATER );
+		glDepthMask( GL_FALSE );
+	}
+
+	glUseProgram( light_pass.prog.prog );
+	glUniform1i( light_pass.shadow_scale, shadow_scale );
+	glUniform1i( light_pass.shadow_lowres, shadow_lowres );
+
+	pass_draw( &light_pass );
 
-	glDisableVertexAttribArray( vp_l );
+	glDepthMask( GL_TRUE );
+	glDisable( GL_DEPTH_TEST );
+
+	stats_end( stage_light );
+
+	stats_begin( stage_resolve );
+
+	glBindFramebuffer( GL_READ_FRAMEBUFFER, fbo_light );
+	glBindFramebuffer( GL_DRAW_FRAMEBUFFER, wnd_framebuffer() );
+	glBlitFramebuffer( 0, 0, render_width, render_height, 0, 0, frame.width, frame.height, GL_COLOR_BUFFER_BIT,
+					   ( render_width == frame.width && render_height == frame.height ) ? GL_NEAREST : GL_LINEAR );
+	glBindFramebuffer( GL_FRAMEBUFFER, wnd_framebuffer() );
+	glViewport( 0, 0, frame.width, frame.height );
+
+	current ^= 1;
+
+	stats_end( stage_resolve );
 }
 
 static void 
 finish( void )
 {
+	unsigned int i;
+
 	glUseProgram( 0 );
 
-	program_destroy( &progs );
+	watch_destroy( shader_watch );
+	shader_watch = NULL;
+	watch_destroy( scene_watch );
+	scene_watch = NULL;
+	reload_cancel();
+
+	if ( scene_pool ) {
+		scene_cancel();
+		pool_destroy( scene_pool );
+		scene_pool = NULL;
+	}
+
+	for ( i = 0; i < PASSES; i++ ) {
+		variants_release( passes[i] );
+	}
+
+	program_destroy( &cone_pass.prog );
+	program_destroy( &gbuffer_pass.prog );
+	program_destroy( &compute_pass.prog );
+	program_destroy( &shadow_pass.prog );
+	program_destroy( &light_pass.prog );
+
+	targets_destroy();
 
 	glBindBuffer( GL_ARRAY_BUFFER, 0 );
 	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
@@ -416,6 +1838,56 @@ finish( void )
 	{
 		glDeleteBuffers( 1, &ubo_cam.handle );
 	}
+
+	if ( tex_pool ) {
+		pool_wait( tex_pool );
+		pool_destroy( tex_pool );
+		tex_pool = NULL;
+		for ( i = 0; i < TEXTURES; i++ ) {
+			texcache_release( &tex_loads[i] );
+		}
+	}
+
+	if ( tex_layers ) {
+		glDeleteTextures( 1, &tex_layers );
+		tex_layers = 0;
+	}
+
+	if ( ubo_materials.handle ) {
+		glDeleteBuffers( 1, &ubo_materials.handle );
+		ubo_materials.handle = 0;
+	}
+
+	if ( ssbo_bvh ) {
+		glDeleteBuffers( 1, &ssbo_bvh );
+		ssbo_bvh = 0;
+	}
+
+	if ( ssbo_grid ) {
+		glDeleteBuffers( 1, &ssbo_grid );
+		glDeleteTextures( 1, &tex_grid );
+		ssbo_grid = tex_grid = 0;
+	}
+
+	if ( tex_bake ) {
+		glDeleteTextures( 1, &tex_bake );
+		tex_bake = 0;
+	}
+
+	if ( tex_bake_index ) {
+		glDeleteTextures( 1, &tex_bake_index );
+		tex_bake_index = 0;
+	}
+
+	if ( tex_bake_mip ) {
+		glDeleteTextures( 1, &tex_bake_mip );
+		tex_bake_mip = 0;
+	}
+
+	bvh_release( &bvh );
+	grid_release( &grid );
+	bake_release( &bake );
+	scene_release( &scene );
 }
 
 static void 
@@ -452,7 +1924,7 @@ static void
 setup_keys()
 {
 	keydata[RDFKEY_ESC] = (key_t){ FALSE, "ESC", "exit" };
-	keydata[RDFKEY_F1] = (key_t){ FALSE, "F1", "reload shaders" };
+	keydata[RDFKEY_F1] = (key_t){ FALSE, "F1", "reload scene and shaders" };
 	keydata[RDFKEY_A] = (key_t){ FALSE, "A", "strafe left" };
 	keydata[RDFKEY_W] = (key_t){ FALSE, "W", "move forward" };
 	keydata[RDFKEY_S] = (key_t){ FALSE, "S", "move backwards" },
@@ -464,6 +1936,16 @@ setup_keys()
 	keydata[RDFKEY_C] = (key_t){ FALSE, "C", "move down" };
 	keydata[RDFKEY_SPACE] = (key_t){ FALSE, "SPACE", "move up" };
 	keydata[RDFKEY_F5] = (key_t){ FALSE, "F5", "debug mode" };
+	keydata[RDFKEY_F2] = (key_t){ FALSE, "F2", "toggle gpu timings csv" };
+	keydata[RDFKEY_F3] = (key_t){ FALSE, "F3", "toggle dynamic resolution" };
+	keydata[RDFKEY_F4] = (key_t){ FALSE, "F4", "toggle depth reprojection" };
+	keydata[RDFKEY_F6] = (key_t){ FALSE, "F6", "toggle cone prepass" };
+	keydata[RDFKEY_F7] = (key_t){ FALSE, "F7", "toggle low resolution shadows" };
+	keydata[RDFKEY_F8] = (key_t){ FALSE, "F8", "toggle compute primary rays" };
+	keydata[RDFKEY_F9] = (key_t){ FALSE, "F9", "toggle over relaxed tracing" };
+	keydata[RDFKEY_F10] = (key_t){ FALSE, "F10", "toggle scene bvh" };
+	keydata[RDFKEY_F11] = (key_t){ FALSE, "F11", "toggle scene grid" };
+	keydata[RDFKEY_F12] = (key_t){ FALSE, "F12", "toggle baked volume" };
 	keydata[RDFKEY_UNUSED] = (key_t){ FALSE, NULL, NULL };
 	keydata[RDFKEY_LEFT] = (key_t){ FALSE, "LEFT", "move Packy left" };
 	keydata[RDFKEY_UP] = (key_t){ FALSE, "UP", "move Packy up" };
@@ -484,6 +1966,65 @@ impl_printkeys( void )
 	}
 }
 
+int 
+impl_render_cpu( const char *path, const unsigned int width, const unsigned int height, const float time, const unsigned int threads )
+{
+	cpu_camera_t	camera;
+	unsigned char	*rgb;
+	int				status;
+
+	rgb = (unsigned char *)malloc( width * height * 3 );
+	if ( !rgb ) {
+		return ERR;
+	}
+
+	/*same default camera and textures as the gpu path*/
+	view_init();
+	in_update();
+	view_setup();
+
+	vec3_mov( camera.pos, frame.view.pos );
+	vec3_mov( camera.dir, frame.view.dir );
+	vec3_mov( camera.right, frame.view.right );
+	vec3_mov( camera.up, frame.view.up );
+
+	cpu_texture( 0, "../textures/Brick_Design_UV_H_CM_1.png" );
+	cpu_texture( 1, "../textures/Ground10_1.png" );
+	cpu_texture( 2, "../textures/Moss_01_UV_H_CM_1.png" );
+
+	status = cpu_render( rgb, width, height, &camera, time, threads );
+
+	if ( status == OK && !SOIL_save_image( path, SOIL_SAVE_TYPE_BMP, width, height, 3, rgb ) ) {
+		fprintf( stderr, "cpu: could not write \"%s\"\n", path );
+		status = ERR;
+	}
+
+	cpu_release();
+	free( rgb );
+
+	return status;
+}
+
+void 
+impl_scene( const char *path )
+{
+	scene_path = path;
+}
+
+void 
+impl_bake( const unsigned int voxels, const unsigned int threads )
+{
+	scene_bake = TRUE;
+	bake_voxels = voxels;
+	bake_threads = threads;
+}
+
+void 
+impl_sync( void )
+{
+	tex_sync = TRUE;
+}
+
 void 
 impl_setup( void )
 {
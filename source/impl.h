@@ -2,6 +2,13 @@
 #define __impl_h_
 
 void	impl_setup( void );
+/* scene file for the gpu passes, before impl_setup */
+void	impl_scene( const char *path );
+/* static scene start baked into a volume of voxels along its longest side, before impl_setup */
+void	impl_bake( const unsigned int voxels, const unsigned int threads );
+/* loads finish before they return instead of in the background, for repeatable captures, before impl_setup */
+void	impl_sync( void );
 void	impl_printkeys( void );
+int		impl_render_cpu( const char *path, const unsigned int width, const unsigned int height, const float time, const unsigned int threads );
 
 #endif/*__impl_h_*/
\ No newline at end of file
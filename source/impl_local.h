@@ -2,6 +2,39 @@
 #define __impl_local_h__
 
 #include "math.h"
+#include "programs.h"
+
+/*texture units shared by every pass*/
+#define TEX_UNIT_TEXTURES	0
+#define TEX_UNIT_GBUFFER0	3
+#define TEX_UNIT_GBUFFER1	4
+#define TEX_UNIT_HISTORY	5
+#define TEX_UNIT_CONE		6
+#define TEX_UNIT_SHADOW		7
+#define TEX_UNIT_GRID		8
+#define TEX_UNIT_BAKE		9
+#define TEX_UNIT_BAKE_INDEX	10
+#define TEX_UNIT_BAKE_MIP	11
+
+/*pixels per side of a cone prepass tile, has to match CONE_TILE in frag.glsl*/
+#define CONE_TILE			8
+
+/*image units of the compute gbuffer pass*/
+#define IMAGE_UNIT_COLOR	0
+#define IMAGE_UNIT_GBUFFER0	1
+#define IMAGE_UNIT_GBUFFER1	2
+
+#define UBO_BINDING_CAMERA	0
+#define UBO_BINDING_MATERIALS	1
+
+/*production and the debug views F5 steps through, see debug_variants in impl.c*/
+#define DEBUG_VIEWS			4
+
+/*room for the MAT_* ids of the material table in the pass defines*/
+#define MATERIALS_DEFINES	1024
+
+#define SSBO_BINDING_BVH	0
+#define SSBO_BINDING_GRID	1
 
 typedef struct
 {
@@ -46,4 +79,53 @@ typedef struct
 	GLint	size;
 } ubo_t;
 
+/*one row of material_block in frag.glsl, std140 layout of material_t*/
+typedef struct
+{
+	float	albedo[3];
+	float	gloss;
+	float	fr0;
+	/*layer of _textures, -1 untextured*/
+	float	layer;
+	float	scale;
+	/*1 projects on xz only instead of the planes the normal faces*/
+	float	planar;
+} material_t;
+
+/*one fullscreen or compute program of the deferred pipeline*/
+typedef struct
+{
+	program	prog;
+	/*built in the background to replace prog, see reload_update()*/
+	program	next;
+	/*variants of other debug views built before, kept while prog runs*/
+	program	variants[DEBUG_VIEWS];
+	/*_PASS_<name> and the optional features compiled in, see pass_defines()*/
+	const char	*name;
+	char	defines[192 + MATERIALS_DEFINES];
+
+	GLint	vp;
+	GLint	resolution;
+	GLint	time;
+	GLint	omega;
+	GLint	reproject;
+	GLint	frame;
+	GLint	prev_resolution;
+	GLint	cone_prepass;
+	GLint	shadow_scale;
+	GLint	shadow_lowres;
+	GLint	packy_pos;
+	GLint	packy_angles;
+	GLint	gogu_pos;
+	GLint	gogu_angles;
+	GLint	bake_lo;
+	GLint	bake_extent;
+	GLint	bake_error;
+	GLint	bake_bricks;
+	GLuint	camera;
+	GLuint	materials;
+	GLuint	bvh;
+	GLuint	grid;
+} pass_t;
+
 #endif/*__impl_local_h__*/
\ No newline at end of file
@@ -0,0 +1,372 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core.h"
+#include "pool.h"
+
+#ifdef _WIN32
+	#include <windows.h>
+
+	typedef HANDLE				thread_t;
+	typedef CRITICAL_SECTION	lock_t;
+	typedef CONDITION_VARIABLE	cond_t;
+
+	#define lock_init( l )		InitializeCriticalSection( l )
+	#define lock_free( l )		DeleteCriticalSection( l )
+	#define lock_enter( l )		EnterCriticalSection( l )
+	#define lock_leave( l )		LeaveCriticalSection( l )
+	#define cond_init( c )		InitializeConditionVariable( c )
+	#define cond_free( c )
+	#define cond_wait( c, l )	SleepConditionVariableCS( c, l, INFINITE )
+	#define cond_wake( c )		WakeAllConditionVariable( c )
+	#define atomic_dec( v )		InterlockedDecrement( v )
+
+	typedef volatile LONG		counter_t;
+#else
+	#include <pthread.h>
+	#include <unistd.h>
+
+	typedef pthread_t			thread_t;
+	typedef pthread_mutex_t		lock_t;
+	typedef pthread_cond_t		cond_t;
+
+	#define lock_init( l )		pthread_mutex_init( l, NULL )
+	#define lock_free( l )		pthread_mutex_destroy( l )
+	#define lock_enter( l )		pthread_mutex_lock( l )
+	#define lock_leave( l )		pthread_mutex_unlock( l )
+	#define cond_init( c )		pthread_cond_init( c, NULL )
+	#define cond_free( c )		pthread_cond_destroy( c )
+	#define cond_wait( c, l )	pthread_cond_wait( c, l )
+	#define cond_wake( c )		pthread_cond_broadcast( c )
+	#define atomic_dec( v )		__sync_sub_and_fetch( v, 1 )
+
+	typedef volatile long		counter_t;
+#endif/*_WIN32*/
+
+#define MAX_WORKERS		64
+#define CACHELINE		64
+
+/* range of job indices owned by a worker */
+typedef struct
+{
+	lock_t			lock;
+	unsigned int	head;
+	unsigned int	tail;
+	char			pad[CACHELINE];
+} deque_t;
+
+typedef struct
+{
+	pool_t			*pool;
+	unsigned int	id;
+} worker_t;
+
+struct pool_s
+{
+	unsigned int	count;
+	thread_t		threads[MAX_WORKERS];
+	worker_t		workers[MAX_WORKERS];
+	deque_t			deques[MAX_WORKERS];
+
+	lock_t			lock;
+	cond_t			wake;
+	cond_t			done;
+	unsigned int	generation;
+	bool			quit;
+
+	PoolJobF		job;
+	void			*userdata;
+	counter_t		remaining;
+};
+
+/*****************************************************************************/
+/*locals*/
+static bool 
+deque_pop( deque_t *dq, unsigned int *job )
+{
+	bool found = FALSE;
+
+	lock_enter( &dq->lock );
+	if ( dq->head < dq->tail ) {
+		*job = dq->head++;
+		found = TRUE;
+	}
+	lock_leave( &dq->lock );
+
+	return found;
+}
+
+/* thieves take single jobs from the tail, the owner keeps walking its range from the head */
+static bool 
+deque_steal( deque_t *victim, unsigned int *job )
+{
+	bool found = FALSE;
+
+	lock_enter( &victim->lock );
+	if ( victim->head < victim->tail ) {
+		*job = --victim->tail;
+		found = TRUE;
+	}
+	lock_leave( &victim->lock );
+
+	return found;
+}
+
+static void 
+pool_work( pool_t *pool, const unsigned int id )
+{
+	unsigned int	job, i, victim;
+	bool			found;
+
+	for ( ;; ) {
+		found = deque_pop( &pool->deques[id], &job );
+
+		for ( i = 1; !found && i < pool->count; i++ ) {
+			victim = ( id + i ) % pool->count;
+			found = deque_steal( &pool->deques[victim], &job );
+		}
+
+		if ( !found ) {
+			return;
+		}
+
+		pool->job( pool->userdata, job, id );
+
+		if ( atomic_dec( &pool->remaining ) == 0 ) {
+			lock_enter( &pool->lock );
+			cond_wake( &pool->done );
+			lock_leave( &pool->lock );
+		}
+	}
+}
+
+#ifdef _WIN32
+static DWORD WINAPI 
+worker_main( LPVOID arg )
+#else
+static void* 
+worker_main( void *arg )
+#endif
+{
+	worker_t		*worker = (worker_t *)arg;
+	pool_t			*pool = worker->pool;
+	unsigned int	seen = 0;
+
+	for ( ;; ) {
+		lock_enter( &pool->lock );
+		while ( pool->generation == seen && !pool->quit ) {
+			cond_wait( &pool->wake, &pool->lock );
+		}
+		seen = pool->generation;
+		if ( pool->quit ) {
+			lock_leave( &pool->lock );
+			break;
+		}
+		lock_leave( &pool->lock );
+
+		pool_work( pool, worker->id );
+	}
+
+	return 0;
+}
+
+/*****************************************************************************/
+/*exports*/
+unsigned int 
+pool_cores( void )
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+
+	GetSystemInfo( &info );
+
+	return (unsigned int)info.dwNumberOfProcessors;
+#else
+	long cores = sysconf( _SC_NPROCESSORS_ONLN );
+
+	return ( cores > 0 ) ? (unsigned int)cores : 1;
+#endif
+}
+
+pool_t* 
+pool_create( unsigned int workers )
+{
+	pool_t			*pool;
+	unsigned int	i;
+	bool			started;
+
+	if ( workers == 0 ) {
+		workers = pool_cores();
+	}
+
+	if ( workers > MAX_WORKERS ) {
+		workers = MAX_WORKERS;
+	}
+
+	pool = (pool_t *)calloc( 1, sizeof(pool_t) );
+	if ( !pool ) {
+		return NULL;
+	}
+
+	pool->count = workers;
+
+	lock_init( &pool->lock );
+	cond_init( &pool->wake );
+	cond_init( &pool->done );
+
+	for ( i = 0; i < workers; i++ ) {
+		lock_init( &pool->deques[i].lock );
+		pool->workers[i].pool = pool;
+		pool->workers[i].id = i;
+	}
+
+	/*worker 0 is the thread calling pool_for*/
+	for ( i = 1; i < workers; i++ ) {
+#ifdef _WIN32
+		pool->threads[i] = CreateThread( NULL, 0, worker_main, &pool->workers[i], 0, NULL );
+		started = pool->threads[i] != NULL;
+#else
+		started = pthread_create( &pool->threads[i], NULL, worker_main, &pool->workers[i] ) == 0;
+#endif
+		if ( !started ) {
+			break;
+		}
+	}
+
+	/*the pool runs with the workers it got, down to just the calling thread*/
+	if ( i < workers ) {
+		fprintf( stderr, "pool: started %u of %u workers\n", i, workers );
+
+		pool->count = i;
+		for ( ; i < workers; i++ ) {
+			lock_free( &pool->deques[i].lock );
+		}
+	}
+
+	return pool;
+}
+
+void 
+pool_destroy( pool_t *pool )
+{
+	unsigned int i;
+
+	if ( !pool ) {
+		return;
+	}
+
+	lock_enter( &pool->lock );
+	pool->quit = TRUE;
+	cond_wake( &pool->wake );
+	lock_leave( &pool->lock );
+
+	for ( i = 1; i < pool->count; i++ ) {
+#ifdef _WIN32
+		WaitForSingleObject( pool->threads[i], INFINITE );
+		CloseHandle( pool->threads[i] );
+#else
+		pthread_join( pool->threads[i], NULL );
+#endif
+	}
+
+	for ( i = 0; i < pool->count; i++ ) {
+		lock_free( &pool->deques[i].lock );
+	}
+
+	cond_free( &pool->done );
+	cond_free( &pool->wake );
+	lock_free( &pool->lock );
+
+	free( pool );
+}
+
+unsigned int 
+pool_workers( const pool_t *pool )
+{
+	return pool->count;
+}
+
+/* the jobs split over the workers from first on, then those workers woken */
+static void 
+pool_dispatch( pool_t *pool, const unsigned int first, const unsigned int count, PoolJobF job, void *userdata )
+{
+	const unsigned int	workers = pool->count - first;
+	unsigned int		i, start = 0, share;
+
+	pool->job = job;
+	pool->userdata = userdata;
+	pool->remaining = count;
+
+	/*contiguous initial split, stealing evens out the rest*/
+	for ( i = 0; i < pool->count; i++ ) {
+		share = 0;
+		if ( i >= first ) {
+			share = count / workers + ( ( i - first < count % workers ) ? 1 : 0 );
+		}
+
+		lock_enter( &pool->deques[i].lock );
+		pool->deques[i].head = start;
+		pool->deques[i].tail = start + share;
+		lock_leave( &pool->deques[i].lock );
+
+		start += share;
+	}
+
+	lock_enter( &pool->lock );
+	pool->generation++;
+	cond_wake( &pool->wake );
+	lock_leave( &pool->lock );
+}
+
+void 
+pool_for( pool_t *pool, const unsigned int count, PoolJobF job, void *userdata )
+{
+	if ( count == 0 ) {
+		return;
+	}
+
+	pool_dispatch( pool, 0, count, job, userdata );
+
+	pool_work( pool, 0 );
+
+	pool_wait( pool );
+}
+
+void 
+pool_start( pool_t *pool, const unsigned int count, PoolJobF job, void *userdata )
+{
+	if ( count == 0 ) {
+		return;
+	}
+
+	/*no thread to hand the jobs to*/
+	if ( pool->count == 1 ) {
+		pool_for( pool, count, job, userdata );
+		return;
+	}
+
+	pool_dispatch( pool, 1, count, job, userdata );
+}
+
+bool 
+pool_busy( pool_t *pool )
+{
+	bool busy;
+
+	lock_enter( &pool->lock );
+	busy = pool->remaining > 0;
+	lock_leave( &pool->lock );
+
+	return busy;
+}
+
+void 
+pool_wait( pool_t *pool )
+{
+	lock_enter( &pool->lock );
+	while ( pool->remaining > 0 ) {
+		cond_wait( &pool->done, &pool->lock );
+	}
+	lock_leave( &pool->lock );
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#ifndef __pool_h_
+#define __pool_h_
+
+/* job callback: userdata, job index, worker index */
+typedef void(*PoolJobF)(void *, const unsigned int, const unsigned int);
+
+typedef struct pool_s pool_t;
+
+/* workers == 0 spawns one worker per core, the calling thread is worker 0 */
+pool_t*			pool_create( unsigned int workers );
+void			pool_destroy( pool_t *pool );
+
+unsigned int	pool_workers( const pool_t *pool );
+unsigned int	pool_cores( void );
+
+/* runs job( userdata, 0..count-1 ) across all workers, returns when every job is done */
+void			pool_for( pool_t *pool, const unsigned int count, PoolJobF job, void *userdata );
+
+/*
+	hands job( userdata, 0..count-1 ) to the spawned workers and returns at once, the calling
+	thread takes no part; runs them like pool_for when there is no other worker
+*/
+void			pool_start( pool_t *pool, const unsigned int count, PoolJobF job, void *userdata );
+/* TRUE while jobs of the last pool_start are left */
+bool			pool_busy( pool_t *pool );
+/* returns when every job of the last pool_start is done */
+void			pool_wait( pool_t *pool );
+
+#endif/*__pool_h_*/
\ No newline at end of file
@@ -1,21 +1,76 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "programs.h"
+#include "scene.h"
+
+#ifdef _WIN32
+	#include <direct.h>
+
+	#define make_dir( p )	_mkdir( p )
+#else
+	#include <sys/stat.h>
+
+	#define make_dir( p )	mkdir( p, 0755 )
+#endif/*_WIN32*/
 
 #define BLOCKSIZE	64
+#define INCLUDE_DEPTH	8
+#define INCLUDE_PATH	260
+
+/*linked programs from glGetProgramBinary, relative to the working directory like the shader paths*/
+#define BINARY_DIR			"../shaders/cache/"
+#define BINARY_FNV_OFFSET	14695981039346656037ULL
+#define BINARY_FNV_PRIME	1099511628211ULL
+
+/*GL_KHR_parallel_shader_compile, newer than the bundled glew*/
+#ifndef GL_COMPLETION_STATUS_KHR
+	#define GL_COMPLETION_STATUS_KHR	0x91B1
+#endif
+
+typedef void (APIENTRY *PFNMAXSHADERCOMPILERTHREADSKHR)( GLuint count );
+
+typedef struct
+{
+	char			magic[4];
+	GLenum			format;
+	unsigned int	length;
+} binary_header_t;
+
+/*compiles and links run on driver threads, see program_parallel()*/
+static bool parallel = FALSE;
 
 static void 
 textdata_destroy( textdata *text )
 {
 	if ( text != NULL ) {
-		if ( text->size > 0 && text->data != NULL ) {
+		if ( text->data != NULL ) {
 			free( text->data );
+			text->data = NULL;
 			text->size = 0;
 		}
 	}
 }
 
+static int 
+textdata_append( textdata *text, const char *data, const size_t size )
+{
+	char *grown;
+
+	grown = (char *)realloc( text->data, text->size + size + 1 );
+	if ( !grown ) {
+		return -1;
+	}
+
+	memcpy( grown + text->size, data, size );
+	text->data = grown;
+	text->size += size;
+	text->data[text->size] = '\0';
+
+	return 0;
+}
+
 static int 
 file_load( const char *path, textdata *text )
 {
@@ -69,6 +124,131 @@ file_load( const char *path, textdata *text )
 	}
 }
 
+/* path of an #include "file" line, relative to the directory of the including file */
+static bool 
+include_path( const char *line, const char *end, const char *from, char *path )
+{
+	const char	*name, *name_end, *dir_end;
+	size_t		dir_len, name_len;
+
+	while ( line < end && ( *line == ' ' || *line == '\t' ) ) {
+		line++;
+	}
+
+	if ( end - line < 8 || strncmp( line, "#include", 8 ) != 0 ) {
+		return FALSE;
+	}
+
+	name = memchr( line + 8, '"', end - line - 8 );
+	name_end = name ? memchr( name + 1, '"', end - name - 1 ) : NULL;
+	if ( !name_end ) {
+		return FALSE;
+	}
+
+	name++;
+	name_len = name_end - name;
+
+	dir_end = strrchr( from, '/' );
+	if ( strrchr( from, '\\' ) > dir_end ) {
+		dir_end = strrchr( from, '\\' );
+	}
+	dir_len = dir_end ? dir_end - from + 1 : 0;
+
+	if ( dir_len + name_len + 1 > INCLUDE_PATH ) {
+		return FALSE;
+	}
+
+	memcpy( path, from, dir_len );
+	memcpy( path + dir_len, name, name_len );
+	path[dir_len + name_len] = '\0';
+
+	return TRUE;
+}
+
+/* #include <scene> line, replaced by the glsl generated from the scene file */
+static bool 
+include_scene( const char *line, const char *end )
+{
+	while ( line < end && ( *line == ' ' || *line == '\t' ) ) {
+		line++;
+	}
+
+	return end - line >= 16 && strncmp( line, "#include <scene>", 16 ) == 0;
+}
+
+/*
+	loads a shader source and pastes #include "file" lines in place, recursively,
+	#line directives keep the compiler log in lines of the file being compiled
+*/
+static int 
+source_load( const char *path, textdata *text, const int depth, const char *scene )
+{
+	textdata	file, inc;
+	const char	*line, *end, *next;
+	char		inc_path[INCLUDE_PATH];
+	char		directive[32];
+	int			lineno = 1;
+	int			err = 0;
+
+	if ( depth > INCLUDE_DEPTH ) {
+		fprintf( stderr, "\"%s\" included too deep\n", path );
+		return -1;
+	}
+
+	if ( file_load( path, &file ) != 0 ) {
+		return -1;
+	}
+
+	text->data = NULL;
+	text->size = 0;
+	err = textdata_append( text, "", 0 );
+
+	for ( line = file.data; err == 0 && *line; line = next, lineno++ ) {
+		end = strchr( line, '\n' );
+		next = end ? end + 1 : line + strlen( line );
+		end = end ? end : next;
+
+		if ( include_scene( line, end ) ) {
+			if ( scene == NULL ) {
+				fprintf( stderr, "\"%s\" includes <scene> but the program has no scene\n", path );
+				err = -1;
+				continue;
+			}
+
+			_snprintf_s( directive, sizeof(directive), _TRUNCATE, "\n#line %d\n", lineno + 1 );
+
+			err = textdata_append( text, "#line 1\n", 8 );
+			err |= textdata_append( text, scene, strlen( scene ) );
+			err |= textdata_append( text, directive, strlen( directive ) );
+			continue;
+		}
+
+		if ( !include_path( line, end, path, inc_path ) ) {
+			err = textdata_append( text, line, next - line );
+			continue;
+		}
+
+		err = source_load( inc_path, &inc, depth + 1, scene );
+		if ( err == 0 ) {
+			_snprintf_s( directive, sizeof(directive), _TRUNCATE, "\n#line %d\n", lineno + 1 );
+
+			err = textdata_append( text, "#line 1\n", 8 );
+			err |= textdata_append( text, inc.data, inc.size );
+			err |= textdata_append( text, directive, strlen( directive ) );
+
+			textdata_destroy( &inc );
+		}
+	}
+
+	textdata_destroy( &file );
+
+	if ( err != 0 ) {
+		textdata_destroy( text );
+	}
+
+	return err;
+}
+
 static int 
 shader_status( GLuint handle, GLenum type )
 {
@@ -134,15 +314,44 @@ program_status( GLuint handle )
 }
 
 static int 
-program_compile( program *prg, textdata *src, int type )
+program_compile( program *prg, textdata *src, int type, const char *scene_defines )
 {
 	GLuint		prg_handle;
 	int			err = 0;
+	const GLchar	*strings[6];
+	GLint		lengths[6] = { -1, -1, -1, -1, -1, -1 };
+	GLsizei		count = 1;
+	char		*body;
+
+	strings[0] = src->data;
+
+	/*defines go right after #version, #line keeps the compiler log in file lines*/
+	body = strchr( src->data, '\n' );
+	if ( ( prg->defines != NULL || prg->variant != NULL || scene_defines != NULL ) && body != NULL ) {
+		body++;
+
+		lengths[0] = (GLint)( body - src->data );
+		if ( prg->defines != NULL ) {
+			strings[count++] = prg->defines;
+		}
+		if ( prg->variant != NULL ) {
+			strings[count++] = prg->variant;
+		}
+		if ( scene_defines != NULL ) {
+			strings[count++] = scene_defines;
+		}
+		strings[count++] = "\n#line 2\n";
+		strings[count++] = body;
+	}
 
 	prg_handle = glCreateShader( type );
-	glShaderSource( prg_handle, 1, &(src->data), NULL );
+	glShaderSource( prg_handle, count, strings, lengths );
 	glCompileShader( prg_handle );
-	err = shader_status( prg_handle, GL_COMPILE_STATUS );
+
+	/*asking would wait for the compile, program_link_end() does*/
+	if ( !parallel ) {
+		err = shader_status( prg_handle, GL_COMPILE_STATUS );
+	}
 
 	switch ( type ) {
 	case GL_VERTEX_SHADER:
@@ -151,6 +360,9 @@ program_compile( program *prg, textdata *src, int type )
 	case GL_FRAGMENT_SHADER:
 		prg->frag = (err == 0) ? prg_handle : 0;
 		break;
+	case GL_COMPUTE_SHADER:
+		prg->comp = (err == 0) ? prg_handle : 0;
+		break;
 	default:
 		break;
 	}
@@ -160,54 +372,290 @@ program_compile( program *prg, textdata *src, int type )
 	return err;
 }
 
+/* scene() and scene_dist() source for #include <scene>, and the defines enabling the objects it uses */
+static int 
+scene_create( const char *path, char **defines, char **source )
+{
+	scene_t	scene;
+	int		err;
+
+	*defines = NULL;
+	*source = NULL;
+
+	if ( path == NULL ) {
+		return 0;
+	}
+
+	if ( scene_load( path, &scene ) != OK ) {
+		fprintf( stderr, "\"%s\" could not be loaded!\n", path );
+		return -1;
+	}
+
+	err = scene_glsl( &scene, path, defines, source );
+	scene_release( &scene );
+
+	return ( err == OK ) ? 0 : -1;
+}
+
+static unsigned long long 
+binary_hash( unsigned long long hash, const char *text )
+{
+	if ( text != NULL ) {
+		for ( ; *text; text++ ) {
+			hash = ( hash ^ (unsigned char)*text ) * BINARY_FNV_PRIME;
+		}
+	}
+
+	/*a separator, so moving text from one string to the next changes the hash*/
+	return ( hash ^ 0xff ) * BINARY_FNV_PRIME;
+}
+
+/* the driver strings and every string given to glShaderSource, see program_compile() */
+static unsigned long long 
+program_hash( const program *prg, const textdata *srcs, const char *scene_defines )
+{
+	unsigned long long	hash = BINARY_FNV_OFFSET;
+	int					i;
+
+	hash = binary_hash( hash, (const char *)glGetString( GL_VENDOR ) );
+	hash = binary_hash( hash, (const char *)glGetString( GL_RENDERER ) );
+	hash = binary_hash( hash, (const char *)glGetString( GL_VERSION ) );
+	hash = binary_hash( hash, prg->defines );
+	hash = binary_hash( hash, prg->variant );
+	hash = binary_hash( hash, scene_defines );
+
+	for ( i = 0; i < 3; i++ ) {
+		hash = binary_hash( hash, srcs[i].data );
+	}
+
+	return hash;
+}
+
+/* the linked program from BINARY_DIR, 0 when there is none or the driver turns it down */
+static GLuint 
+binary_load( const char *path )
+{
+	FILE			*file;
+	binary_header_t	header;
+	void			*data;
+	GLuint			prog = 0;
+	GLint			status = 0;
+
+	fopen_s( &file, path, "rb" );
+	if ( !file ) {
+		return 0;
+	}
+
+	if ( fread( &header, sizeof(header), 1, file ) == 1 && memcmp( header.magic, "RDFP", 4 ) == 0 ) {
+		data = malloc( header.length );
+		if ( data && fread( data, 1, header.length, file ) == header.length ) {
+			prog = glCreateProgram();
+			glProgramBinary( prog, header.format, data, header.length );
+			glGetProgramiv( prog, GL_LINK_STATUS, &status );
+
+			if ( !status ) {
+				glDeleteProgram( prog );
+				prog = 0;
+			}
+		}
+		free( data );
+	}
+
+	fclose( file );
+
+	return prog;
+}
+
+static void 
+binary_save( const char *path, const GLuint prog )
+{
+	FILE			*file;
+	binary_header_t	header;
+	GLint			length = 0;
+	void			*data;
+
+	glGetProgramiv( prog, GL_PROGRAM_BINARY_LENGTH, &length );
+	if ( length <= 0 ) {
+		return;
+	}
+
+	data = malloc( length );
+	if ( !data ) {
+		return;
+	}
+
+	memcpy( header.magic, "RDFP", 4 );
+	glGetProgramBinary( prog, length, NULL, &header.format, data );
+	header.length = (unsigned int)length;
+
+	make_dir( BINARY_DIR );
+
+	fopen_s( &file, path, "wb" );
+	if ( file ) {
+		fwrite( &header, sizeof(header), 1, file );
+		fwrite( data, 1, length, file );
+		fclose( file );
+	}
+	else {
+		fprintf( stderr, "Cannot write the program binary \"%s\"\n", path );
+	}
+
+	free( data );
+}
+
 int 
 program_create( program *prg )
 {
-	textdata	src;
-	int			err = 0;
+	/*fragment, vertex and compute source, empty for the stages the program has not*/
+	textdata	srcs[3] = { { 0, NULL }, { 0, NULL }, { 0, NULL } };
+	char		*paths[3];
+	const int	types[3] = { GL_FRAGMENT_SHADER, GL_VERTEX_SHADER, GL_COMPUTE_SHADER };
+	char		*scene_defines, *scene_source;
+	GLint		formats = 0;
+	int			i, err = 0;
+
+	paths[0] = prg->frag_path;
+	paths[1] = prg->vert_path;
+	paths[2] = prg->comp_path;
+
+	prg->linked = FALSE;
+	prg->binary_path[0] = '\0';
+
+	if ( scene_create( prg->scene_path, &scene_defines, &scene_source ) != 0 ) {
+		return -1;
+	}
 
-	if ( prg->frag_path != NULL ) {
-		err = file_load( prg->frag_path, &src );
-		if ( err != 0 ) {
-			fprintf( stderr, "frag.glsl could not be loaded!\n" );
-			return err;
+	for ( i = 0; err == 0 && i < 3; i++ ) {
+		if ( paths[i] != NULL ) {
+			err = source_load( paths[i], &srcs[i], 0, scene_source );
+			if ( err != 0 ) {
+				fprintf( stderr, "\"%s\" could not be loaded!\n", paths[i] );
+			}
 		}
-
-		err = program_compile( prg, &src, GL_FRAGMENT_SHADER );
 	}
 
+	/*a driver without binary formats compiles every time*/
+	glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS, &formats );
+	if ( err == 0 && formats > 0 ) {
+		_snprintf_s( prg->binary_path, sizeof(prg->binary_path), _TRUNCATE, BINARY_DIR "%016llx.bin", program_hash( prg, srcs, scene_defines ) );
 
-	if ( prg->vert_path != NULL ) {
-		err = file_load( prg->vert_path, &src );
-		if ( err != 0 ) {
-			fprintf( stderr, "vert.glsl could not be loaded!\n" );
-			return err;
+		prg->prog = binary_load( prg->binary_path );
+		if ( prg->prog ) {
+			prg->linked = TRUE;
 		}
+	}
 
-		err = program_compile( prg, &src, GL_VERTEX_SHADER );
+	for ( i = 0; i < 3; i++ ) {
+		if ( err == 0 && !prg->linked && srcs[i].data != NULL ) {
+			err = program_compile( prg, &srcs[i], types[i], scene_defines );
+		}
+		textdata_destroy( &srcs[i] );
 	}
 
-	if ( err == 0 ) {
+	if ( err == 0 && !prg->linked ) {
 		prg->prog = glCreateProgram();
+		glProgramParameteri( prg->prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
 
-		glAttachShader( prg->prog, prg->vert );
-		glAttachShader( prg->prog, prg->frag );
+		if ( prg->comp ) {
+			glAttachShader( prg->prog, prg->comp );
+		}
+		else {
+			glAttachShader( prg->prog, prg->vert );
+			glAttachShader( prg->prog, prg->frag );
+		}
 	}
 
+	free( scene_defines );
+	free( scene_source );
+
 	return err;
 }
 
 int 
 program_link( program *prg )
 {
-	int	err = 0;
+	program_link_start( prg );
+
+	return program_link_end( prg );
+}
+
+void 
+program_link_start( program *prg )
+{
+	/*linked when it was loaded*/
+	if ( !prg->linked && prg->prog ) {
+		glLinkProgram( prg->prog );
+	}
+}
+
+bool 
+program_busy( const program *prg )
+{
+	GLint done = GL_TRUE;
+
+	if ( parallel && !prg->linked && prg->prog ) {
+		glGetProgramiv( prg->prog, GL_COMPLETION_STATUS_KHR, &done );
+	}
+
+	return !done;
+}
+
+int 
+program_link_end( program *prg )
+{
+	GLuint	stages[3];
+	int		i, err = 0;
+
+	if ( prg->linked ) {
+		return 0;
+	}
+
+	if ( !prg->prog ) {
+		return -1;
+	}
+
+	/*compile logs first, a failed stage only shows up as a failed link otherwise*/
+	if ( parallel ) {
+		stages[0] = prg->frag;
+		stages[1] = prg->vert;
+		stages[2] = prg->comp;
+		for ( i = 0; i < 3; i++ ) {
+			if ( stages[i] && shader_status( stages[i], GL_COMPILE_STATUS ) != 0 ) {
+				err = -1;
+			}
+		}
+	}
+
+	if ( err == 0 ) {
+		err = program_status( prg->prog );
+	}
+
+	if ( err == 0 && prg->binary_path[0] ) {
+		binary_save( prg->binary_path, prg->prog );
+	}
 
-	glLinkProgram( prg->prog );
-	err = program_status( prg->prog );
+	prg->linked = ( err == 0 );
 
 	return err;
 }
 
+void 
+program_parallel( void )
+{
+	PFNMAXSHADERCOMPILERTHREADSKHR max_threads;
+
+	if ( !glfwExtensionSupported( "GL_KHR_parallel_shader_compile" ) ) {
+		return;
+	}
+
+	max_threads = (PFNMAXSHADERCOMPILERTHREADSKHR)glfwGetProcAddress( "glMaxShaderCompilerThreadsKHR" );
+	if ( max_threads ) {
+		/*as many as the driver likes*/
+		max_threads( 0xFFFFFFFF );
+		parallel = TRUE;
+	}
+}
+
 void 
 program_destroy( program *prg )
 {
@@ -225,6 +673,11 @@ program_destroy( program *prg )
 		glDeleteShader( prg->vert );
 		prg->vert = 0;
 	}
+
+	if ( prg->comp ) {
+		glDeleteShader( prg->comp );
+		prg->comp = 0;
+	}
 }
 
 void 
@@ -238,7 +691,32 @@ program_set( program *prg, char *path, int type )
 	case GL_FRAGMENT_SHADER:
 		prg->frag_path = path;
 		break;
+	case GL_COMPUTE_SHADER:
+		prg->comp_path = path;
+		break;
 	default:
 		break;
 	}
+}
+
+void 
+program_defines( program *prg, const char *defines )
+{
+	prg->defines = defines;
+}
+
+void 
+program_variant( program *prg, const program *base, const char *variant )
+{
+	*prg = *base;
+
+	prg->prog = prg->vert = prg->frag = prg->comp = 0;
+	prg->variant = variant;
+	prg->linked = FALSE;
+}
+
+void 
+program_scene( program *prg, const char *path )
+{
+	prg->scene_path = path;
 }
\ No newline at end of file
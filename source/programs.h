@@ -8,8 +8,24 @@ typedef struct
 	GLuint	prog;
 	GLuint	vert;
 	GLuint	frag;
+	GLuint	comp;
 	char	*vert_path;
 	char	*frag_path;
+	/*a compute program has only this stage*/
+	char	*comp_path;
+	/*injected after the #version line of every stage*/
+	const char	*defines;
+	/*injected after defines, what one variant of the same program adds, see program_variant()*/
+	const char	*variant;
+	/*scene file compiled into the #include <scene> of every stage, see scene.h*/
+	const char	*scene_path;
+	/*
+		where the linked program is kept, named by a hash of the driver and every source
+		string; linked once prog came from there or program_link_end() took it, nothing is
+		left to link then
+	*/
+	char	binary_path[64];
+	bool	linked;
 } program;
 
 typedef struct
@@ -19,8 +35,20 @@ typedef struct
 } textdata;
 
 int	 program_create( program *prg );
+/* program_link_start() and program_link_end() in one, waits for the driver */
 int	 program_link( program *prg );
+/* starts linking and returns, program_busy() tells when program_link_end() would not wait */
+void program_link_start( program *prg );
+bool program_busy( const program *prg );
+/* compile and link status with their logs, stores the binary of a good program */
+int	 program_link_end( program *prg );
+/* lets the driver compile and link on its own threads when it offers GL_KHR_parallel_shader_compile */
+void program_parallel( void );
 void program_set( program *prg, char *path, int type );
+void program_defines( program *prg, const char *defines );
+/* prg set up like base with variant after its defines, nothing built; prg compiles on its own */
+void program_variant( program *prg, const program *base, const char *variant );
+void program_scene( program *prg, const char *path );
 void program_destroy( program *prg );
 
 #endif/*__programs_h_*/
\ No newline at end of file
@@ -1,10 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "core.h"
 #include "impl.h"
 
+static void 
+usage( const char *name )
+{
+	fprintf( stderr, "usage: %s [--bench <frames>] [--capture <out.bmp>] [--cpu <out.bmp>] [--threads <n>] [--size <width>x<height>] [--step <seconds>] [--time <seconds>] [--scene <file.scene>] [--bake <voxels>]\n", name );
+}
+
 int 
 main( int argc, char* argv[] )
 {
 	int status = 0;
+	int i;
+
+	/*headless benchmark*/
+	unsigned int frames = 0;
+	unsigned int width = 800;
+	unsigned int height = 600;
+	float step = 1.0f / 60.0f;
+
+	const char *capture = NULL;
+	const char *scene = NULL;
+	unsigned int bake = 0;
+
+	/*cpu reference renderer*/
+	const char *cpu_out = NULL;
+	unsigned int threads = 0;
+	float time = 0.0f;
+
+	for ( i = 1; i < argc; i++ ) {
+		if ( strcmp( argv[i], "--bench" ) == 0 && i + 1 < argc ) {
+			frames = (unsigned int)atoi( argv[++i] );
+		}
+		else if ( strcmp( argv[i], "--size" ) == 0 && i + 1 < argc ) {
+			if ( sscanf_s( argv[++i], "%ux%u", &width, &height ) != 2 ) {
+				usage( argv[0] );
+				return ERR;
+			}
+		}
+		else if ( strcmp( argv[i], "--step" ) == 0 && i + 1 < argc ) {
+			step = (float)atof( argv[++i] );
+		}
+		else if ( strcmp( argv[i], "--capture" ) == 0 && i + 1 < argc ) {
+			capture = argv[++i];
+		}
+		else if ( strcmp( argv[i], "--cpu" ) == 0 && i + 1 < argc ) {
+			cpu_out = argv[++i];
+		}
+		else if ( strcmp( argv[i], "--threads" ) == 0 && i + 1 < argc ) {
+			threads = (unsigned int)atoi( argv[++i] );
+		}
+		else if ( strcmp( argv[i], "--time" ) == 0 && i + 1 < argc ) {
+			time = (float)atof( argv[++i] );
+		}
+		else if ( strcmp( argv[i], "--scene" ) == 0 && i + 1 < argc ) {
+			scene = argv[++i];
+		}
+		else if ( strcmp( argv[i], "--bake" ) == 0 && i + 1 < argc ) {
+			bake = (unsigned int)atoi( argv[++i] );
+		}
+		else {
+			usage( argv[0] );
+			return ERR;
+		}
+	}
+
+	/*the cpu reference only knows its built-in copy of default.scene, see cpu.c*/
+	if ( cpu_out != NULL && ( scene != NULL || bake > 0 ) ) {
+		fprintf( stderr, "--cpu renders the built-in default scene, it takes no --scene or --bake\n" );
+		usage( argv[0] );
+		return ERR;
+	}
+
+	if ( scene != NULL ) {
+		impl_scene( scene );
+	}
+
+	if ( bake > 0 ) {
+		impl_bake( bake, threads );
+	}
+
+	/*no gl context needed*/
+	if ( cpu_out != NULL ) {
+		return impl_render_cpu( cpu_out, width, height, time, threads );
+	}
+
+	if ( frames > 0 ) {
+		if ( setup_headless( width, height ) != OK ) {
+			return ERR;
+		}
+
+		impl_sync();
+		impl_setup();
+
+		return run_bench( frames, step, capture );
+	}
 
 	setup_opengl();
 
@@ -14,4 +108,4 @@ main( int argc, char* argv[] )
 	status = run();
 
 	return status;
-}
\ No newline at end of file
+}
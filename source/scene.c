@@ -0,0 +1,1280 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+
+#include "scene.h"
+
+#define LINE_SIZE	512
+#define LINE_TOKENS	64
+
+typedef struct
+{
+	const char	*name;
+	int			args;
+	/*$p is the point, $0..$6 the arguments*/
+	const char	*glsl;
+	/*library code frag.glsl only compiles for scenes using it*/
+	const char	*define;
+	/*returns a DE with its own materials*/
+	bool		object;
+	/*half size around the center $0 $1 $2 per axis, as the sum of two arguments and pad, -1 for none*/
+	int			extent[3][2];
+	float		pad;
+	/*the shape from the bvh tables, a holds $0 $1 $2 $6 and b $3 $4 $5 and the material*/
+	const char	*data;
+	/*the box of half size $3 $4 $5 around the center is inside the shape*/
+	bool		solid;
+} shape_t;
+
+#define UNBOUNDED	{ { -1, -1 }, { -1, -1 }, { -1, -1 } }, 0.0f, NULL, FALSE
+
+static const shape_t shapes[] = {
+	{ "plane",		4, "de_plane( $p, vec3( $0, $1, $2 ), $3 )",						NULL,				FALSE,	UNBOUNDED },
+	{ "sphere",		4, "de_sphere( $p, vec3( $0, $1, $2 ), $3 )",						NULL,				FALSE,	{ { 3, -1 }, { 3, -1 }, { 3, -1 } }, 0.0f, "de_sphere( p, a.xyz, b.x )", FALSE },
+	{ "box",		6, "de_box( $p, vec3( $0, $1, $2 ), vec3( $3, $4, $5 ) )",			NULL,				FALSE,	{ { 3, -1 }, { 4, -1 }, { 5, -1 } }, 0.0f, "de_box( p, a.xyz, b.xyz )", TRUE },
+	{ "rbox",		7, "de_rbox( $p, vec3( $0, $1, $2 ), vec3( $3, $4, $5 ), $6 )",		NULL,				FALSE,	{ { 3, 6 }, { 4, 6 }, { 5, 6 } }, 0.0f, "de_rbox( p, a.xyz, b.xyz, a.w )", TRUE },
+	{ "rbox2",		6, "de_rbox2( $p, vec3( $0, $1, $2 ), vec3( $3, $4, $5 ) )",		NULL,				FALSE,	{ { 3, -1 }, { 4, -1 }, { 5, -1 } }, 0.15f, "de_rbox2( p, a.xyz, b.xyz )", TRUE },
+	{ "torus",		5, "de_torus( $p, vec3( $0, $1, $2 ), vec2( $3, $4 ) )",			NULL,				FALSE,	{ { 3, 4 }, { 4, -1 }, { 3, 4 } }, 0.0f, "de_torus( p, a.xyz, b.xy )", FALSE },
+	{ "cylinder",	5, "de_cylinder( $p - vec3( $0, $1, $2 ), vec2( $3, $4 ) )",		NULL,				FALSE,	{ { 3, -1 }, { 4, -1 }, { 3, -1 } }, 0.0f, "de_cylinder( p - a.xyz, b.xy )", FALSE },
+	{ "moss",		6, "moss_tile( $p, vec3( $0, $1, $2 ), vec3( $3, $4, $5 ) )",		"SCENE_MOSS",		FALSE,	{ { 3, -1 }, { 4, -1 }, { 5, -1 } }, 0.0f, "moss_tile( p, a.xyz, b.xyz )", FALSE },
+	{ "wavyfloor",	1, "de_wavyfloor( $p, $0 )",										"SCENE_WAVYFLOOR",	FALSE,	UNBOUNDED },
+	{ "cluster",	0, "cluster( $p )",													"SCENE_CLUSTER",	FALSE,	UNBOUNDED },
+	{ "menger",		0, "fract3d_menger( $p )",											"SCENE_MENGER",		FALSE,	UNBOUNDED },
+	{ "weird",		0, "fract3d_weird( $p )",											"SCENE_WEIRD",		FALSE,	UNBOUNDED },
+	{ "mandelbulb",	0, "fract3d_mandelbulb( $p )",										"SCENE_MANDELBULB",	FALSE,	UNBOUNDED },
+	{ "qjulia",		0, "fract3d_qjulia( $p )",											"SCENE_QJULIA",		FALSE,	UNBOUNDED },
+	{ "packy",		0, "DE_FN( packy )( $p )",											"SCENE_PACKY",		TRUE,	UNBOUNDED },
+	{ "facult",		0, "DE_FN( facult )( $p )",											"SCENE_FACULT",		TRUE,	UNBOUNDED },
+	{ "gogu",		0, "DE_FN( gogu )( $p )",											"SCENE_GOGU",		TRUE,	UNBOUNDED }
+};
+
+#define SHAPES	( sizeof( shapes ) / sizeof( shapes[0] ) )
+
+static const char *ops[] = { "de_union", "de_carve", "de_intersect", "de_smooth" };
+
+/*walks the nodes of one run, see bvh.h for the layout*/
+static const char *glsl_traverse =
+	"DE \n"
+	"DE_FN( scene_bvh )( const in vec3 p, int node, const in int end, DE de )\n"
+	"{\n"
+	"    while( node < end ) {\n"
+	"        vec3 d = max( max( _bvh[node].lo - p, p - _bvh[node].hi ), 0.0 );\n"
+	"\n"
+	"        /*inside the box the primitive may still be closer than a negative de*/\n"
+	"        if( length( d ) <= max( DE_DIST( de ), 0.0 ) ) {\n"
+	"            if( _bvh[node].prim >= 0 ) {\n"
+	"                de = de_union( DE_FN( scene_prim )( _bvh[node].prim, p ), de );\n"
+	"            }\n"
+	"            node++;\n"
+	"        }\n"
+	"        else {\n"
+	"            node = max( _bvh[node].skip, node + 1 );\n"
+	"        }\n"
+	"    }\n"
+	"\n"
+	"    return de;\n"
+	"}\n";
+
+/*the primitives that may be nearest in the cell of p, see grid.h*/
+static const char *glsl_cell =
+	"DE \n"
+	"DE_FN( scene_grid )( const in vec3 p, const in int run, DE de )\n"
+	"{\n"
+	"    vec4 cell = texelFetch( _grid, grid_cell( p, run ) + ivec3( 0, 0, run * GRID_CELLS ), 0 );\n"
+	"    int end = int( cell.x + cell.y );\n"
+	"\n"
+	"    /*no primitive of the run is closer than cell.z*/\n"
+	"    if( cell.z <= max( DE_DIST( de ), 0.0 ) ) {\n"
+	"        for( int i = int( cell.x ); i < end; i++ ) {\n"
+	"            de = de_union( DE_FN( scene_cell_prim )( _grid_prims[i], p ), de );\n"
+	"        }\n"
+	"    }\n"
+	"\n"
+	"    return de;\n"
+	"}\n";
+
+typedef struct
+{
+	char	*data;
+	size_t	size;
+} text_t;
+
+/*****************************************************************************/
+/*locals*/
+/* splits a line on blanks, everything after # is a comment */
+static unsigned int 
+tokenize( char *line, char **tokens )
+{
+	unsigned int count = 0;
+	char *comment;
+
+	comment = strchr( line, '#' );
+	if ( comment ) {
+		*comment = '\0';
+	}
+
+	while ( count < LINE_TOKENS ) {
+		while ( *line && isspace( (unsigned char)*line ) ) {
+			line++;
+		}
+
+		if ( !*line ) {
+			break;
+		}
+
+		tokens[count++] = line;
+
+		while ( *line && !isspace( (unsigned char)*line ) ) {
+			line++;
+		}
+
+		if ( *line ) {
+			*line++ = '\0';
+		}
+	}
+
+	return count;
+}
+
+/* numbers and glsl names only, nothing that could end the expression it lands in */
+static bool 
+token_valid( const char *token )
+{
+	if ( strlen( token ) >= SCENE_TOKEN ) {
+		return FALSE;
+	}
+
+	for ( ; *token; token++ ) {
+		if ( !isalnum( (unsigned char)*token ) && !strchr( "_.+-", *token ) ) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static const char* 
+token_copy( char *dst, char **tokens, const unsigned int count, unsigned int *i )
+{
+	if ( *i >= count ) {
+		return "missing argument";
+	}
+
+	if ( !token_valid( tokens[*i] ) ) {
+		return "arguments are numbers or glsl names";
+	}
+
+	strcpy_s( dst, SCENE_TOKEN, tokens[( *i )++] );
+
+	return NULL;
+}
+
+static bool 
+token_number( const char *token )
+{
+	char *end;
+
+	strtod( token, &end );
+
+	return end != token && *end == '\0';
+}
+
+/* numbers, or names with an optional sign the application knows the value of */
+static bool 
+token_value( const char *token, scene_value_fn value, float *v )
+{
+	if ( token_number( token ) ) {
+		*v = (float)atof( token );
+		return TRUE;
+	}
+
+	if ( value == NULL ) {
+		return FALSE;
+	}
+
+	if ( token[0] == '-' && value( token + 1, v ) ) {
+		*v = -*v;
+		return TRUE;
+	}
+
+	return value( token[0] == '+' ? token + 1 : token, v );
+}
+
+/* returns an error message, NULL when the line was a valid primitive */
+static const char* 
+prim_parse( scene_prim_t *prim, char **tokens, const unsigned int count )
+{
+	const char *err;
+	unsigned int i = 0, a;
+	int s;
+
+	memset( prim, 0, sizeof(scene_prim_t) );
+	prim->rotate_axis = -1;
+
+	if ( strcmp( tokens[i], "union" ) == 0 ) {
+		prim->op = SCENE_UNION;
+		i++;
+	}
+	else if ( strcmp( tokens[i], "carve" ) == 0 ) {
+		prim->op = SCENE_CARVE;
+		i++;
+	}
+	else if ( strcmp( tokens[i], "intersect" ) == 0 ) {
+		prim->op = SCENE_INTERSECT;
+		i++;
+	}
+	else if ( strcmp( tokens[i], "smooth" ) == 0 ) {
+		prim->op = SCENE_SMOOTH;
+		i++;
+
+		if ( ( err = token_copy( prim->k, tokens, count, &i ) ) != NULL ) {
+			return err;
+		}
+	}
+
+	if ( i >= count ) {
+		return "missing shape";
+	}
+
+	prim->shape = -1;
+	for ( s = 0; s < (int)SHAPES; s++ ) {
+		if ( strcmp( tokens[i], shapes[s].name ) == 0 ) {
+			prim->shape = s;
+		}
+	}
+
+	if ( prim->shape < 0 ) {
+		return "unknown shape";
+	}
+
+	for ( i++, a = 0; a < (unsigned int)shapes[prim->shape].args; a++ ) {
+		if ( ( err = token_copy( prim->args[a], tokens, count, &i ) ) != NULL ) {
+			return err;
+		}
+	}
+
+	while ( i < count ) {
+		if ( strcmp( tokens[i], "mat" ) == 0 ) {
+			i++;
+			err = token_copy( prim->mat, tokens, count, &i );
+		}
+		else if ( strcmp( tokens[i], "at" ) == 0 ) {
+			i++;
+			for ( a = 0, err = NULL; a < 3 && err == NULL; a++ ) {
+				err = token_copy( prim->at[a], tokens, count, &i );
+			}
+		}
+		else if ( strncmp( tokens[i], "rotate_", 7 ) == 0 && tokens[i][7] >= 'x' && tokens[i][7] <= 'z' && tokens[i][8] == '\0' ) {
+			prim->rotate_axis = tokens[i][7] - 'x';
+			i++;
+			err = token_copy( prim->rotate, tokens, count, &i );
+		}
+		else if ( strcmp( tokens[i], "scale" ) == 0 ) {
+			i++;
+			err = token_copy( prim->scale, tokens, count, &i );
+		}
+		else if ( strcmp( tokens[i], "bound" ) == 0 ) {
+			i++;
+			err = token_copy( prim->bound, tokens, count, &i );
+		}
+		else {
+			err = "unknown modifier";
+		}
+
+		if ( err != NULL ) {
+			return err;
+		}
+	}
+
+	if ( shapes[prim->shape].object && prim->mat[0] ) {
+		return "objects have their own materials";
+	}
+
+	if ( !shapes[prim->shape].object && !prim->mat[0] ) {
+		return "missing mat";
+	}
+
+	return NULL;
+}
+
+/* bounds known up to the values of at, see scene_bounds */
+static bool 
+prim_bounded( const scene_prim_t *prim )
+{
+	const shape_t *shape = &shapes[prim->shape];
+	int a;
+
+	if ( prim->scale[0] && !token_number( prim->scale ) ) {
+		return FALSE;
+	}
+
+	if ( prim->bound[0] ) {
+		return token_number( prim->bound );
+	}
+
+	if ( shape->extent[0][0] < 0 ) {
+		return FALSE;
+	}
+
+	for ( a = 0; a < shape->args; a++ ) {
+		if ( !token_number( prim->args[a] ) ) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/* numbers only, evaluated from the bvh tables instead of code of its own */
+static bool 
+prim_data( const scene_prim_t *prim )
+{
+	const shape_t *shape = &shapes[prim->shape];
+	int a;
+
+	if ( shape->data == NULL || prim->rotate_axis >= 0 || prim->scale[0] ) {
+		return FALSE;
+	}
+
+	for ( a = 0; a < 3 && prim->at[0][0]; a++ ) {
+		if ( !token_number( prim->at[a] ) ) {
+			return FALSE;
+		}
+	}
+
+	for ( a = 0; a < shape->args; a++ ) {
+		if ( !token_number( prim->args[a] ) ) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/* groups consecutive unions with bounds into bvh runs, the first primitive is a union into nothing */
+static void 
+scene_runs( scene_t *scene )
+{
+	unsigned int i, j;
+
+	scene->runs = 0;
+
+	for ( i = 0; i < scene->count; i = j ) {
+		for ( j = i; j < scene->count; j++ ) {
+			const scene_prim_t *prim = &scene->prims[j];
+
+			if ( ( j > 0 && prim->op != SCENE_UNION ) || !prim_bounded( prim ) ) {
+				break;
+			}
+		}
+
+		if ( j - i >= SCENE_RUN_MIN ) {
+			for ( ; i < j; i++ ) {
+				scene->prims[i].run = scene->runs;
+			}
+			scene->runs++;
+		}
+		else {
+			scene->prims[i].run = -1;
+			j = i + 1;
+		}
+	}
+}
+
+/* shapes scene_sample evaluates through sdf.h, with numeric arguments and no rotation */
+static bool 
+prim_sampled( const scene_prim_t *prim )
+{
+	static const char	*sampled[] = { "plane", "sphere", "box", "rbox", "rbox2", "torus" };
+	const shape_t		*shape = &shapes[prim->shape];
+	unsigned int		i;
+	int					a;
+
+	if ( prim->rotate_axis >= 0 || scene_dynamic( prim ) ) {
+		return FALSE;
+	}
+
+	if ( ( prim->op == SCENE_SMOOTH && !token_number( prim->k ) ) || ( prim->scale[0] && !token_number( prim->scale ) ) ) {
+		return FALSE;
+	}
+
+	for ( a = 0; a < shape->args; a++ ) {
+		if ( !token_number( prim->args[a] ) ) {
+			return FALSE;
+		}
+	}
+
+	for ( i = 0; i < sizeof(sampled) / sizeof(sampled[0]); i++ ) {
+		if ( strcmp( shape->name, sampled[i] ) == 0 ) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/* the leading primitives the cpu can sample, ending on a run boundary */
+static void 
+scene_static( scene_t *scene )
+{
+	unsigned int i, bounded = 0;
+
+	for ( i = 0; i < scene->count && prim_sampled( &scene->prims[i] ); i++ ) {
+		bounded += prim_bounded( &scene->prims[i] );
+	}
+
+	while ( i > 0 && i < scene->count && scene->prims[i].run >= 0 && scene->prims[i - 1].run == scene->prims[i].run ) {
+		bounded -= prim_bounded( &scene->prims[--i] );
+	}
+
+	scene->baked = bounded >= SCENE_BAKE_MIN ? i : 0;
+}
+
+static int 
+text_append( text_t *text, const char *data )
+{
+	size_t size = strlen( data );
+	char *grown;
+
+	grown = (char *)realloc( text->data, text->size + size + 1 );
+	if ( !grown ) {
+		return ERR;
+	}
+
+	memcpy( grown + text->size, data, size + 1 );
+	text->data = grown;
+	text->size += size;
+
+	return OK;
+}
+
+/*
+	formats at out in a buffer ending at end and returns the new end of the text;
+	what does not fit is cut off, the generated code then fails to compile
+*/
+static char* 
+glsl_print( char *out, const char *end, const char *format, ... )
+{
+	va_list	args;
+	int		n;
+
+	va_start( args, format );
+	n = _vsnprintf_s( out, end - out, _TRUNCATE, format, args );
+	va_end( args );
+
+	return ( n < 0 ) ? out + strlen( out ) : out + n;
+}
+
+/* integers become float literals, names go through as they are */
+static char* 
+glsl_arg( char *out, const char *end, const char *token )
+{
+	char *last;
+
+	strtod( token, &last );
+	if ( *last == '\0' && !strpbrk( token, ".eE" ) ) {
+		return glsl_print( out, end, "%s.0", token );
+	}
+
+	return glsl_print( out, end, "%s", token );
+}
+
+static void 
+glsl_shape( char *out, const char *end, const scene_prim_t *prim, const char *point )
+{
+	const char *t;
+
+	for ( t = shapes[prim->shape].glsl; *t && out < end - 1; ) {
+		if ( t[0] == '$' && t[1] == 'p' ) {
+			out = glsl_print( out, end, "%s", point );
+			t += 2;
+		}
+		else if ( t[0] == '$' && t[1] >= '0' && t[1] < '0' + SCENE_ARGS ) {
+			out = glsl_arg( out, end, prim->args[t[1] - '0'] );
+			t += 2;
+		}
+		else {
+			*out++ = *t++;
+		}
+	}
+
+	*out = '\0';
+}
+
+static char* 
+glsl_at( char *out, const char *end, const scene_prim_t *prim )
+{
+	out = glsl_print( out, end, "vec3( " );
+	out = glsl_arg( out, end, prim->at[0] );
+	out = glsl_print( out, end, ", " );
+	out = glsl_arg( out, end, prim->at[1] );
+	out = glsl_print( out, end, ", " );
+	out = glsl_arg( out, end, prim->at[2] );
+	out = glsl_print( out, end, " )" );
+
+	return out;
+}
+
+/* one primitive into e, indent is the prefix of every line */
+static int 
+glsl_prim( text_t *text, const scene_prim_t *prim, const char *indent )
+{
+	static const char *rotations[3] = { "rotate_x", "rotate_y", "rotate_z" };
+	char	line[LINE_SIZE * 2], point[LINE_SIZE], shape[LINE_SIZE];
+	char	*out;
+	bool	local = prim->at[0][0] || prim->rotate_axis >= 0 || prim->scale[0];
+	int		err = OK;
+
+	/*local point, rotation and scale around at*/
+	if ( local ) {
+		out = point;
+		if ( prim->at[0][0] ) {
+			out = glsl_print( out, point + sizeof(point), "p - " );
+			out = glsl_at( out, point + sizeof(point), prim );
+		}
+		else {
+			out = glsl_print( out, point + sizeof(point), "p" );
+		}
+
+		if ( prim->rotate_axis >= 0 ) {
+			out = glsl_print( shape, shape + sizeof(shape), "%s( %s, ", rotations[prim->rotate_axis], point );
+			out = glsl_arg( out, shape + sizeof(shape), prim->rotate );
+			glsl_print( out, shape + sizeof(shape), " )" );
+			strcpy_s( point, sizeof(point), shape );
+		}
+
+		if ( prim->scale[0] ) {
+			out = point + strlen( point );
+			out = glsl_print( out, point + sizeof(point), " / " );
+			glsl_arg( out, point + sizeof(point), prim->scale );
+		}
+
+		_snprintf_s( line, sizeof(line), _TRUNCATE, "%sq = %s;\n", indent, point );
+		err |= text_append( text, line );
+	}
+
+	glsl_shape( shape, shape + sizeof(shape), prim, local ? "q" : "p" );
+
+	if ( shapes[prim->shape].object ) {
+		_snprintf_s( line, sizeof(line), _TRUNCATE, "%se = %s;\n", indent, shape );
+	}
+	else {
+		_snprintf_s( line, sizeof(line), _TRUNCATE, "%se = DE_MAKE( %s, MAT_%s );\n", indent, shape, prim->mat );
+	}
+	err |= text_append( text, line );
+
+	if ( prim->scale[0] ) {
+		out = glsl_print( line, line + sizeof(line), "%sDE_DIST( e ) *= ", indent );
+		out = glsl_arg( out, line + sizeof(line), prim->scale );
+		glsl_print( out, line + sizeof(line), ";\n" );
+		err |= text_append( text, line );
+	}
+
+	return err;
+}
+
+/* e merged into de */
+static int 
+glsl_merge( text_t *text, const scene_prim_t *prim, const bool first, const char *indent )
+{
+	char	line[LINE_SIZE];
+	char	*out;
+
+	if ( first ) {
+		_snprintf_s( line, sizeof(line), _TRUNCATE, "%sde = e;\n", indent );
+	}
+	else if ( prim->op == SCENE_SMOOTH ) {
+		out = glsl_print( line, line + sizeof(line), "%sde = de_smooth( e, de, ", indent );
+		out = glsl_arg( out, line + sizeof(line), prim->k );
+		glsl_print( out, line + sizeof(line), " );\n" );
+	}
+	else {
+		_snprintf_s( line, sizeof(line), _TRUNCATE, "%sde = %s( e, de );\n", indent, ops[prim->op] );
+	}
+
+	return text_append( text, line );
+}
+
+/* argument a of a table primitive, moved by at */
+static char* 
+glsl_table_arg( char *out, const char *end, const scene_prim_t *prim, const int a )
+{
+	char	number[SCENE_TOKEN + 8];
+
+	if ( a >= shapes[prim->shape].args ) {
+		return glsl_print( out, end, "0.0" );
+	}
+
+	if ( a > 2 || !prim->at[0][0] ) {
+		return glsl_arg( out, end, prim->args[a] );
+	}
+
+	_snprintf_s( number, sizeof(number), _TRUNCATE, "%.9g", atof( prim->args[a] ) + atof( prim->at[a] ) );
+	if ( !strpbrk( number, ".eEn" ) ) {
+		return glsl_print( out, end, "%s.0", number );
+	}
+
+	return glsl_print( out, end, "%s", number );
+}
+
+/* one line of the scene file in place, skipped while its bound is further than de */
+static int 
+glsl_line( text_t *text, const scene_prim_t *prim, const bool first, const char *indent )
+{
+	char	line[LINE_SIZE], inner[16];
+	char	*out;
+	int		err = OK;
+
+	_snprintf_s( line, sizeof(line), _TRUNCATE, "\n%s/*line %u*/\n", indent, prim->line );
+	err |= text_append( text, line );
+
+	_snprintf_s( inner, sizeof(inner), _TRUNCATE, "%.11s", indent );
+	if ( prim->bound[0] ) {
+		out = glsl_print( line, line + sizeof(line), "%sif( de_sphere( p, ", indent );
+
+		if ( prim->at[0][0] ) {
+			out = glsl_at( out, line + sizeof(line), prim );
+		}
+		else {
+			out = glsl_print( out, line + sizeof(line), "vec3( 0.0 )" );
+		}
+
+		out = glsl_print( out, line + sizeof(line), ", " );
+		out = glsl_arg( out, line + sizeof(line), prim->bound );
+		glsl_print( out, line + sizeof(line), " ) < DE_DIST( de ) ) {\n" );
+		err |= text_append( text, line );
+
+		_snprintf_s( inner, sizeof(inner), _TRUNCATE, "%.11s    ", indent );
+	}
+
+	err |= glsl_prim( text, prim, inner );
+	err |= glsl_merge( text, prim, first, inner );
+
+	if ( prim->bound[0] ) {
+		_snprintf_s( line, sizeof(line), _TRUNCATE, "%s}\n", indent );
+		err |= text_append( text, line );
+	}
+
+	return err;
+}
+
+/*
+	no primitive after the baked ones is nearer p than scene_rest() for the far steps of
+	trace(), carving and intersecting only take away; 0 when one has no bound
+*/
+static int 
+glsl_rest( text_t *text, const scene_t *scene )
+{
+	char			line[LINE_SIZE];
+	char			*out;
+	unsigned int	i;
+	int				err = OK;
+
+	err |= text_append( text, "\n#ifdef DE_BAKED\nfloat \nscene_rest( const in vec3 p )\n{\n" );
+
+	for ( i = scene->baked; i < scene->count; i++ ) {
+		const scene_prim_t *prim = &scene->prims[i];
+
+		if ( prim->op != SCENE_CARVE && prim->op != SCENE_INTERSECT && ( prim->op != SCENE_UNION || !prim->bound[0] ) ) {
+			break;
+		}
+	}
+
+	if ( i < scene->count ) {
+		return err | text_append( text, "    return 0.0;\n}\n#endif\n" );
+	}
+
+	err |= text_append( text, "    float d = VIEW_DIST;\n" );
+
+	for ( i = scene->baked; i < scene->count; i++ ) {
+		const scene_prim_t *prim = &scene->prims[i];
+
+		if ( prim->op != SCENE_UNION ) {
+			continue;
+		}
+
+		out = glsl_print( line, line + sizeof(line), "    d = min( d, de_sphere( p, " );
+		if ( prim->at[0][0] ) {
+			out = glsl_at( out, line + sizeof(line), prim );
+		}
+		else {
+			out = glsl_print( out, line + sizeof(line), "vec3( 0.0 )" );
+		}
+
+		out = glsl_print( out, line + sizeof(line), ", " );
+		out = glsl_arg( out, line + sizeof(line), prim->bound );
+		glsl_print( out, line + sizeof(line), " ) );\n" );
+		err |= text_append( text, line );
+	}
+
+	return err | text_append( text, "    return d;\n}\n#endif\n" );
+}
+
+/*
+	a run through its grid while p is inside of it, moving primitives in line after it;
+	opens the #elif of the bvh walk
+*/
+static int 
+glsl_grid( text_t *text, const scene_t *scene, const unsigned int first, const unsigned int end )
+{
+	char			line[LINE_SIZE];
+	unsigned int	i, count = 0;
+	int				run = scene->prims[first].run, err = OK;
+
+	for ( i = first; i < end; i++ ) {
+		count += !scene_dynamic( &scene->prims[i] );
+	}
+
+	if ( count == 0 ) {
+		return text_append( text, "#ifdef _BVH_WALK\n" );
+	}
+
+	err |= text_append( text, "#if defined( _GRID_WALK )\n" );
+
+	if ( first == 0 ) {
+		err |= text_append( text, "    de = DE_MAKE( VIEW_DIST, 0.0 );\n" );
+	}
+
+	_snprintf_s( line, sizeof(line), _TRUNCATE, "    if( grid_inside( p, %d ) ) {\n        de = DE_FN( scene_grid )( p, %d, de );\n    }\n    else {", run, run );
+	err |= text_append( text, line );
+
+	for ( i = first; i < end; i++ ) {
+		if ( !scene_dynamic( &scene->prims[i] ) ) {
+			err |= glsl_line( text, &scene->prims[i], FALSE, "        " );
+		}
+	}
+
+	err |= text_append( text, "    }\n" );
+
+	for ( i = first; i < end; i++ ) {
+		if ( scene_dynamic( &scene->prims[i] ) ) {
+			err |= glsl_line( text, &scene->prims[i], FALSE, "    " );
+		}
+	}
+
+	err |= text_append( text, "#elif defined( _BVH_WALK )\n" );
+
+	return err;
+}
+
+/* the tables of numeric primitives, by scene index */
+static int 
+glsl_tables( text_t *text, const scene_t *scene )
+{
+	static const int	slots[2][4] = { { 0, 1, 2, 6 }, { 3, 4, 5, -1 } };
+	static const char	*names[2] = { "SCENE_A", "SCENE_B" };
+	char				line[LINE_SIZE];
+	char				*out;
+	unsigned int		i;
+	int					t, k, err = OK;
+
+	err |= text_append( text, "#ifndef SCENE_TABLES\n#define SCENE_TABLES\n" );
+
+	_snprintf_s( line, sizeof(line), _TRUNCATE, "const int SCENE_SHAPE[%u] = int[%u](", scene->count, scene->count );
+	err |= text_append( text, line );
+	for ( i = 0; i < scene->count; i++ ) {
+		const scene_prim_t *prim = &scene->prims[i];
+
+		_snprintf_s( line, sizeof(line), _TRUNCATE, "%s %d", i ? "," : "", prim->run >= 0 && prim_data( prim ) ? prim->shape : -1 );
+		err |= text_append( text, line );
+	}
+	err |= text_append( text, " );\n" );
+
+	for ( t = 0; t < 2; t++ ) {
+		_snprintf_s( line, sizeof(line), _TRUNCATE, "const vec4 %s[%u] = vec4[%u](\n", names[t], scene->count, scene->count );
+		err |= text_append( text, line );
+
+		for ( i = 0; i < scene->count; i++ ) {
+			const scene_prim_t *prim = &scene->prims[i];
+
+			out = glsl_print( line, line + sizeof(line), "    vec4( " );
+			if ( prim->run >= 0 && prim_data( prim ) ) {
+				for ( k = 0; k < 4; k++ ) {
+					if ( k == 3 && t == 1 ) {
+						out = glsl_print( out, line + sizeof(line), "MAT_%s", prim->mat );
+					}
+					else {
+						out = glsl_table_arg( out, line + sizeof(line), prim, slots[t][k] );
+					}
+					out = glsl_print( out, line + sizeof(line), k < 3 ? ", " : " " );
+				}
+			}
+			else {
+				out = glsl_print( out, line + sizeof(line), "0.0 " );
+			}
+			glsl_print( out, line + sizeof(line), ")%s\n", i + 1 < scene->count ? "," : " );" );
+			err |= text_append( text, line );
+		}
+	}
+
+	err |= text_append( text, "#endif\n\n" );
+
+	return err;
+}
+
+static bool 
+prim_switched( const scene_prim_t *prim, const bool statics )
+{
+	return prim->run >= 0 && !( statics && scene_dynamic( prim ) );
+}
+
+/*
+	the primitives of every run, by scene index: the numeric ones share one branch
+	per shape, the rest has code of its own; statics leaves the moving ones out
+*/
+static int 
+glsl_prim_switch( text_t *text, const scene_t *scene, const char *name, const bool statics )
+{
+	bool			used[SHAPES] = { FALSE }, data = FALSE;
+	char			line[LINE_SIZE];
+	unsigned int	i;
+	int				err = OK;
+
+	for ( i = 0; i < scene->count; i++ ) {
+		if ( prim_switched( &scene->prims[i], statics ) && prim_data( &scene->prims[i] ) ) {
+			used[scene->prims[i].shape] = TRUE;
+			data = TRUE;
+		}
+	}
+
+	if ( data ) {
+		err |= glsl_tables( text, scene );
+	}
+
+	_snprintf_s( line, sizeof(line), _TRUNCATE, "DE \nDE_FN( %s )( const in int i, const in vec3 p )\n{\n    DE e;\n    vec3 q;\n", name );
+	err |= text_append( text, line );
+
+	if ( data ) {
+		err |= text_append( text, "    vec4 a = SCENE_A[i];\n    vec4 b = SCENE_B[i];\n\n    switch( SCENE_SHAPE[i] ) {\n" );
+
+		for ( i = 0; i < SHAPES; i++ ) {
+			if ( used[i] ) {
+				_snprintf_s( line, sizeof(line), _TRUNCATE, "    case %u: /*%s*/\n        return DE_MAKE( %s, b.w );\n", i, shapes[i].name, shapes[i].data );
+				err |= text_append( text, line );
+			}
+		}
+
+		err |= text_append( text, "    }\n" );
+	}
+
+	err |= text_append( text, "\n    switch( i ) {\n" );
+
+	for ( i = 0; i < scene->count; i++ ) {
+		if ( !prim_switched( &scene->prims[i], statics ) || prim_data( &scene->prims[i] ) ) {
+			continue;
+		}
+
+		_snprintf_s( line, sizeof(line), _TRUNCATE, "    case %u: /*line %u*/\n", i, scene->prims[i].line );
+		err |= text_append( text, line );
+		err |= glsl_prim( text, &scene->prims[i], "        " );
+		err |= text_append( text, "        return e;\n" );
+	}
+
+	err |= text_append( text, "    }\n\n    return DE_MAKE( VIEW_DIST, 0.0 );\n}\n\n" );
+
+	return err;
+}
+
+/*****************************************************************************/
+/*exports*/
+int 
+scene_load( const char *path, scene_t *scene )
+{
+	FILE			*file;
+	char			buffer[LINE_SIZE];
+	char			*tokens[LINE_TOKENS];
+	unsigned int	count, line = 0;
+	scene_prim_t	prim, *grown;
+	const char		*err;
+
+	scene->prims = NULL;
+	scene->count = 0;
+
+	fopen_s( &file, path, "r" );
+	if ( !file ) {
+		fprintf( stderr, "File \"%s\" not found\n", path );
+		return ERR;
+	}
+
+	while ( fgets( buffer, sizeof(buffer), file ) ) {
+		line++;
+
+		count = tokenize( buffer, tokens );
+		if ( count == 0 ) {
+			continue;
+		}
+
+		err = prim_parse( &prim, tokens, count );
+		if ( err == NULL && scene->count == 0 && prim.bound[0] ) {
+			err = "the first primitive can not be bounded";
+		}
+
+		if ( err != NULL ) {
+			fprintf( stderr, "%s:%u: %s\n", path, line, err );
+			fclose( file );
+			scene_release( scene );
+			return ERR;
+		}
+
+		grown = (scene_prim_t *)realloc( scene->prims, ( scene->count + 1 ) * sizeof(scene_prim_t) );
+		if ( !grown ) {
+			fclose( file );
+			scene_release( scene );
+			return ERR;
+		}
+
+		prim.line = line;
+		scene->prims = grown;
+		scene->prims[scene->count++] = prim;
+	}
+
+	fclose( file );
+
+	if ( scene->count == 0 ) {
+		fprintf( stderr, "%s: no primitives\n", path );
+		return ERR;
+	}
+
+	scene_runs( scene );
+	scene_static( scene );
+
+	return OK;
+}
+
+void 
+scene_release( scene_t *scene )
+{
+	free( scene->prims );
+	scene->prims = NULL;
+	scene->count = 0;
+	scene->runs = 0;
+	scene->baked = 0;
+}
+
+bool 
+scene_bounds( const scene_prim_t *prim, scene_value_fn value, vec3_t lo, vec3_t hi )
+{
+	const shape_t	*shape = &shapes[prim->shape];
+	vec3_t			at = { 0.0f, 0.0f, 0.0f }, center, half;
+	float			scale = 1.0f, r, v;
+	int				i, a;
+
+	if ( prim->at[0][0] ) {
+		for ( i = 0; i < 3; i++ ) {
+			if ( !token_value( prim->at[i], value, &at[i] ) ) {
+				return FALSE;
+			}
+		}
+	}
+
+	if ( prim->scale[0] ) {
+		scale = (float)fabs( atof( prim->scale ) );
+	}
+
+	if ( prim->bound[0] ) {
+		r = (float)atof( prim->bound );
+		for ( i = 0; i < 3; i++ ) {
+			lo[i] = at[i] - r;
+			hi[i] = at[i] + r;
+		}
+
+		return TRUE;
+	}
+
+	for ( i = 0; i < 3; i++ ) {
+		center[i] = (float)atof( prim->args[i] );
+		half[i] = shape->pad;
+
+		for ( a = 0; a < 2; a++ ) {
+			if ( shape->extent[i][a] >= 0 ) {
+				half[i] += (float)atof( prim->args[shape->extent[i][a]] );
+			}
+		}
+	}
+
+	/*rotated, the sphere around at holding the local box*/
+	if ( prim->rotate_axis >= 0 ) {
+		v = vec3_length( center );
+		r = vec3_length( half );
+
+		for ( i = 0; i < 3; i++ ) {
+			center[i] = 0.0f;
+			half[i] = v + r;
+		}
+	}
+
+	for ( i = 0; i < 3; i++ ) {
+		lo[i] = at[i] + ( center[i] - half[i] ) * scale;
+		hi[i] = at[i] + ( center[i] + half[i] ) * scale;
+	}
+
+	return TRUE;
+}
+
+bool 
+scene_core( const scene_prim_t *prim, vec3_t lo, vec3_t hi )
+{
+	float	scale = 1.0f, at, c, h;
+	int		i;
+
+	if ( !shapes[prim->shape].solid || prim->rotate_axis >= 0 || scene_dynamic( prim ) ) {
+		return FALSE;
+	}
+
+	for ( i = 0; i < 6; i++ ) {
+		if ( !token_number( prim->args[i] ) ) {
+			return FALSE;
+		}
+	}
+
+	if ( prim->scale[0] ) {
+		scale = (float)fabs( atof( prim->scale ) );
+	}
+
+	for ( i = 0; i < 3; i++ ) {
+		at = prim->at[0][0] ? (float)atof( prim->at[i] ) : 0.0f;
+		c = (float)atof( prim->args[i] );
+		h = (float)fabs( atof( prim->args[i + 3] ) );
+
+		lo[i] = at + ( c - h ) * scale;
+		hi[i] = at + ( c + h ) * scale;
+	}
+
+	return TRUE;
+}
+
+void 
+scene_sample( const scene_prim_t *prim, const sdf_t *sdf, const bool first, float *d,
+			  const float *px, const float *py, const float *pz, float *e, float *q, const unsigned int count )
+{
+	const char		*name = shapes[prim->shape].name;
+	float			*qx = q, *qy = q + count, *qz = q + count * 2;
+	float			args[SCENE_ARGS], scale = 1.0f, bev;
+	vec3_t			at = { 0.0f, 0.0f, 0.0f }, o, dim;
+	unsigned int	i;
+	int				a;
+
+	for ( a = 0; a < SCENE_ARGS; a++ ) {
+		args[a] = (float)atof( prim->args[a] );
+	}
+
+	for ( a = 0; a < 3 && prim->at[0][0]; a++ ) {
+		at[a] = (float)atof( prim->at[a] );
+	}
+
+	if ( prim->scale[0] ) {
+		scale = (float)atof( prim->scale );
+	}
+
+	/*the point in the frame of the primitive, q = ( p - at ) / scale*/
+	for ( i = 0; i < count; i++ ) {
+		qx[i] = ( px[i] - at[_x_] ) / scale;
+		qy[i] = ( py[i] - at[_y_] ) / scale;
+		qz[i] = ( pz[i] - at[_z_] ) / scale;
+	}
+
+	for ( a = 0; a < 3; a++ ) {
+		o[a] = args[a];
+		dim[a] = args[a + 3];
+	}
+
+	if ( strcmp( name, "plane" ) == 0 ) {
+		for ( i = 0; i < count; i++ ) {
+			e[i] = qx[i] * args[0] + qy[i] * args[1] + qz[i] * args[2] + args[3];
+		}
+	}
+	else if ( strcmp( name, "sphere" ) == 0 ) {
+		sdf->sphere( e, qx, qy, qz, count, o, args[3] );
+	}
+	else if ( strcmp( name, "box" ) == 0 ) {
+		sdf->box( e, qx, qy, qz, count, o, dim );
+	}
+	else if ( strcmp( name, "torus" ) == 0 ) {
+		sdf->torus( e, qx, qy, qz, count, o, args[3], args[4] );
+	}
+	else {
+		/*rbox is rbox2 with its own bevel instead of 0.15*/
+		sdf->rbox2( e, qx, qy, qz, count, o, dim );
+
+		bev = strcmp( name, "rbox" ) == 0 ? 0.15f - args[6] : 0.0f;
+		for ( i = 0; i < count; i++ ) {
+			e[i] += bev;
+		}
+	}
+
+	for ( i = 0; i < count && scale != 1.0f; i++ ) {
+		e[i] *= scale;
+	}
+
+	if ( first ) {
+		memcpy( d, e, count * sizeof(float) );
+	}
+	else if ( prim->op == SCENE_UNION ) {
+		sdf->unite( d, NULL, e, 0.0f, count );
+	}
+	else if ( prim->op == SCENE_CARVE ) {
+		sdf->carve( d, NULL, e, 0.0f, count );
+	}
+	else if ( prim->op == SCENE_INTERSECT ) {
+		for ( i = 0; i < count; i++ ) {
+			d[i] = e[i] > d[i] ? e[i] : d[i];
+		}
+	}
+	else {
+		sdf->smin( d, e, d, count, (float)atof( prim->k ) );
+	}
+}
+
+bool 
+scene_dynamic( const scene_prim_t *prim )
+{
+	int i;
+
+	for ( i = 0; i < 3 && prim->at[0][0]; i++ ) {
+		if ( !token_number( prim->at[i] ) ) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/*
+	the scene function named head, its primitives in order; baked ones are skipped where
+	the baked volume is no nearer than its error, see bake.h
+*/
+static int 
+glsl_scene( text_t *src, const scene_t *scene, const char *head, const bool baked, bool *used )
+{
+	char			line[LINE_SIZE * 2];
+	unsigned int	i, end, node = 0;
+	int				err = OK;
+
+	err |= text_append( src, head );
+	err |= text_append( src, "( const in vec3 p )\n{\n    DE de, e;\n    vec3 q;\n" );
+
+	/*away from the static start of the scene the baked volume stands in for it, see bake.h*/
+	if ( baked ) {
+		_snprintf_s( line, sizeof(line), _TRUNCATE, "\n    /*lines %u-%u baked*/\n    de = bake_dist( p );\n    if( de < _bake_error ) {\n", scene->prims[0].line, scene->prims[scene->baked - 1].line );
+		err |= text_append( src, line );
+	}
+
+	for ( i = 0; i < scene->count; i = end ) {
+		const scene_prim_t *prim = &scene->prims[i];
+
+		end = i + 1;
+		used[prim->shape] = TRUE;
+
+		if ( baked && i == scene->baked ) {
+			err |= text_append( src, "    }\n" );
+		}
+
+		/*the nodes of a run follow the previous run, 2n - 1 of them for n primitives*/
+		if ( prim->run >= 0 ) {
+			while ( end < scene->count && scene->prims[end].run == prim->run ) {
+				used[scene->prims[end++].shape] = TRUE;
+			}
+
+			_snprintf_s( line, sizeof(line), _TRUNCATE, "\n    /*lines %u-%u*/\n", prim->line, scene->prims[end - 1].line );
+			err |= text_append( src, line );
+			err |= glsl_grid( src, scene, i, end );
+
+			if ( i == 0 ) {
+				err |= text_append( src, "    de = DE_MAKE( VIEW_DIST, 0.0 );\n" );
+			}
+
+			_snprintf_s( line, sizeof(line), _TRUNCATE, "    de = DE_FN( scene_bvh )( p, %u, %u, de );\n#else", node, node + 2 * ( end - i ) - 1 );
+			err |= text_append( src, line );
+
+			node += 2 * ( end - i ) - 1;
+
+			for ( ; i < end; i++ ) {
+				err |= glsl_line( src, &scene->prims[i], i == 0, "    " );
+			}
+
+			err |= text_append( src, "#endif\n" );
+			continue;
+		}
+
+		err |= glsl_line( src, prim, i == 0, "    " );
+	}
+
+	if ( baked && scene->baked == scene->count ) {
+		err |= text_append( src, "    }\n" );
+	}
+
+	err |= text_append( src, "\n    return de;\n}\n" );
+
+	return err;
+}
+
+int 
+scene_glsl( const scene_t *scene, const char *path, char **defines, char **source )
+{
+	bool			used[SHAPES] = { FALSE };
+	text_t			def = { NULL, 0 }, src = { NULL, 0 };
+	char			line[LINE_SIZE * 2];
+	unsigned int	i;
+	int				err = OK;
+
+	err |= text_append( &def, "" );
+	err |= text_append( &src, "" );
+
+	_snprintf_s( line, sizeof(line), _TRUNCATE, "/*generated from %.400s*/\n", path );
+	err |= text_append( &src, line );
+
+	/*_BVH_WALK and _GRID_WALK come with the pass defines, the in-line code stays the default*/
+	if ( scene->runs > 0 ) {
+		err |= text_append( &src, "#ifdef _BVH_WALK\n" );
+		err |= glsl_prim_switch( &src, scene, "scene_prim", FALSE );
+		err |= text_append( &src, glsl_traverse );
+		err |= text_append( &src, "#endif\n#ifdef _GRID_WALK\n" );
+		err |= glsl_prim_switch( &src, scene, "scene_cell_prim", TRUE );
+		err |= text_append( &src, glsl_cell );
+		err |= text_append( &src, "#endif\n\n" );
+
+		_snprintf_s( line, sizeof(line), _TRUNCATE, "#define SCENE_BVH\n#define SCENE_RUNS %u\n", scene->runs );
+		err |= text_append( &def, line );
+	}
+
+	if ( scene->baked > 0 ) {
+		err |= text_append( &def, "#define SCENE_BAKE\n" );
+	}
+
+	err |= glsl_scene( &src, scene, "DE \nDE_FN( scene )", FALSE, used );
+
+	/*
+		trace() and cone_trace() march a lower bound, up to two voxel diagonals below the
+		scene where the baked volume stands in for its static start; shadows, occlusion
+		and normals keep the exact distance
+	*/
+	if ( scene->baked > 0 ) {
+		err |= text_append( &src, "\n#ifdef DE_BAKED\n" );
+		err |= glsl_scene( &src, scene, "float \nscene_march", TRUE, used );
+		err |= text_append( &src, "#endif\n" );
+	}
+
+	if ( scene->baked > 0 ) {
+		err |= glsl_rest( &src, scene );
+	}
+
+	for ( i = 0; i < SHAPES; i++ ) {
+		if ( used[i] && shapes[i].define ) {
+			_snprintf_s( line, sizeof(line), _TRUNCATE, "#define %s\n", shapes[i].define );
+			err |= text_append( &def, line );
+		}
+	}
+
+	if ( err != OK ) {
+		free( def.data );
+		free( src.data );
+		return ERR;
+	}
+
+	*defines = def.data;
+	*source = src.data;
+
+	return OK;
+}
\ No newline at end of file
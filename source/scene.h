@@ -0,0 +1,101 @@
+#ifndef __scene_h_
+#define __scene_h_
+
+#include "core.h"
+#include "math.h"
+#include "sdf.h"
+
+/*
+	scene description, one primitive per line, # starts a comment:
+
+	[union | carve | intersect | smooth <k>] <shape> <args> [modifiers]
+
+	shapes		plane nx ny nz h, sphere x y z r, box x y z dx dy dz, rbox x y z dx dy dz bevel,
+				rbox2 x y z dx dy dz, torus x y z radius thickness, cylinder x y z r h,
+				moss x y z dx dy dz, wavyfloor h, cluster, menger, weird, mandelbulb, qjulia,
+				and the objects packy, facult, gogu that carry their own materials
+	modifiers	mat <name>			material MAT_<name>, required by every shape but the objects
+				at x y z			moves the shape, rotation and scale are around this point
+				rotate_x|y|z <a>	rotation in radians
+				scale <s>			uniform scale
+				bound <r>			skipped while the sphere of radius r around at is further than the scene so far
+
+	arguments are numbers or glsl names such as _time or -halftime, evaluated in the shader
+
+	consecutive unions whose bounds are known go through a bvh instead of being evaluated
+	one after the other: shapes with fixed extents or a bound, numeric arguments, scale and
+	bound, at may use glsl names as long as the application can give their values
+*/
+#define SCENE_ARGS		7
+#define SCENE_TOKEN		32
+
+#define SCENE_UNION		0
+#define SCENE_CARVE		1
+#define SCENE_INTERSECT	2
+#define SCENE_SMOOTH	3
+
+/*shorter runs of bvh primitives stay in line*/
+#define SCENE_RUN_MIN	2
+
+/*static prefixes with fewer bounded primitives are not worth a volume*/
+#define SCENE_BAKE_MIN	2
+
+typedef struct
+{
+	int				op;
+	int				shape;
+	unsigned int	line;
+
+	char			args[SCENE_ARGS][SCENE_TOKEN];
+	char			mat[SCENE_TOKEN];
+	char			k[SCENE_TOKEN];
+
+	char			at[3][SCENE_TOKEN];
+	char			rotate[SCENE_TOKEN];
+	int				rotate_axis;
+	char			scale[SCENE_TOKEN];
+	char			bound[SCENE_TOKEN];
+
+	/*bvh run holding the primitive, -1 when evaluated in line*/
+	int				run;
+} scene_prim_t;
+
+typedef struct
+{
+	scene_prim_t	*prims;
+	unsigned int	count;
+	unsigned int	runs;
+	/*leading primitives scene_sample can evaluate, 0 when too few to bake*/
+	unsigned int	baked;
+} scene_t;
+
+/* value of a glsl name used by an argument, such as _packy_pos.x, FALSE when unknown */
+typedef bool (*scene_value_fn)( const char *name, float *value );
+
+int		scene_load( const char *path, scene_t *scene );
+void	scene_release( scene_t *scene );
+
+/* world bounds of a bvh primitive, FALSE when at uses a name value does not know */
+bool	scene_bounds( const scene_prim_t *prim, scene_value_fn value, vec3_t lo, vec3_t hi );
+
+/* a box inside a static primitive, the surface is never further than its nearest point; FALSE when unknown */
+bool	scene_core( const scene_prim_t *prim, vec3_t lo, vec3_t hi );
+
+/*
+	merges a baked primitive into d at count points the way the generated code does,
+	e and q are scratch for count and 3 * count floats
+*/
+void	scene_sample( const scene_prim_t *prim, const sdf_t *sdf, const bool first, float *d,
+					  const float *px, const float *py, const float *pz, float *e, float *q, const unsigned int count );
+
+/* TRUE when the bounds use glsl names and have to be refit every frame */
+bool	scene_dynamic( const scene_prim_t *prim );
+
+/*
+	glsl for frag.glsl: defines enable the library objects in use, source is one
+	DE_FN( scene ) built from the macros objects.glsl uses, both allocated;
+	with _BVH_WALK defined, runs walk the _bvh nodes laid out by bvh_build, see bvh.h
+*/
+int		scene_glsl( const scene_t *scene, const char *path, char **defines, char **source );
+
+#endif/*__scene_h_*/
\ No newline at end of file
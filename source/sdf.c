@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sdf.h"
+
+#ifdef SDF_X86
+	#ifdef _MSC_VER
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+#endif/*SDF_X86*/
+
+/*****************************************************************************/
+/*scalar fallback, one point at a time*/
+static void 
+scalar_sphere( float *d, const float *px, const float *py, const float *pz, const unsigned int count, const vec3_t o, const float r )
+{
+	unsigned int i;
+	float x, y, z;
+
+	for ( i = 0; i < count; i++ ) {
+		x = o[_x_] - px[i];
+		y = o[_y_] - py[i];
+		z = o[_z_] - pz[i];
+
+		d[i] = sqrtf( x * x + y * y + z * z ) - r;
+	}
+}
+
+static void 
+scalar_box( float *d, const float *px, const float *py, const float *pz, const unsigned int count, const vec3_t o, const vec3_t dim )
+{
+	unsigned int i;
+	float x, y, z, mx, my, mz, inside;
+
+	for ( i = 0; i < count; i++ ) {
+		x = fabsf( o[_x_] - px[i] ) - dim[_x_];
+		y = fabsf( o[_y_] - py[i] ) - dim[_y_];
+		z = fabsf( o[_z_] - pz[i] ) - dim[_z_];
+
+		inside = ( y > z ) ? y : z;
+		inside = ( x > inside ) ? x : inside;
+		inside = ( inside < 0.0f ) ? inside : 0.0f;
+
+		mx = ( x > 0.0f ) ? x : 0.0f;
+		my = ( y > 0.0f ) ? y : 0.0f;
+		mz = ( z > 0.0f ) ? z : 0.0f;
+
+		d[i] = inside + sqrtf( mx * mx + my * my + mz * mz );
+	}
+}
+
+static void 
+scalar_rbox2( float *d, const float *px, const float *py, const float *pz, const unsigned int count, const vec3_t o, const vec3_t dim )
+{
+	unsigned int i;
+	float x, y, z;
+
+	for ( i = 0; i < count; i++ ) {
+		x = fabsf( o[_x_] - px[i] ) - dim[_x_];
+		y = fabsf( o[_y_] - py[i] ) - dim[_y_];
+		z = fabsf( o[_z_] - pz[i] ) - dim[_z_];
+
+		x = ( x > 0.0f ) ? x : 0.0f;
+		y = ( y > 0.0f ) ? y : 0.0f;
+		z = ( z > 0.0f ) ? z : 0.0f;
+
+		d[i] = sqrtf( x * x + y * y + z * z ) - 0.15f;
+	}
+}
+
+static void 
+scalar_torus( float *d, const float *px, const float *py, const float *pz, const unsigned int count, const vec3_t o, const float radius, const float thickness )
+{
+	unsigned int i;
+	float x, y, z, l;
+
+	for ( i = 0; i < count; i++ ) {
+		x = o[_x_] - px[i];
+		y = o[_y_] - py[i];
+		z = o[_z_] - pz[i];
+
+		l = sqrtf( x * x + z * z ) - radius;
+
+		d[i] = sqrtf( l * l + y * y ) - thickness;
+	}
+}
+
+static void 
+scalar_segment( float *d, const float *px, const float *py, const float *pz, const unsigned int count, const vec3_t a, const vec3_t b, const float r )
+{
+	unsigned int i;
+	float bax = b[_x_] - a[_x_];
+	float bay = b[_y_] - a[_y_];
+	float baz = b[_z_] - a[_z_];
+	float inv = 1.0f / ( bax * bax + bay * bay + baz * baz );
+	float x, y, z, h;
+
+	for ( i = 0; i < count; i++ ) {
+		x = px[i] - a[_x_];
+		y = py[i] - a[_y_];
+		z = pz[i] - a[_z_];
+
+		h = ( x * bax + y * bay + z * baz ) * inv;
+		h = ( h < 0.0f ) ? 0.0f : ( ( h > 1.0f ) ? 1.0f : h );
+
+		x -= bax * h;
+		y -= bay * h;
+		z -= baz * h;
+
+		d[i] = sqrtf( x * x + y * y + z * z ) - r;
+	}
+}
+
+static void 
+scalar_prism( float *d, const float *px, const float *py, const float *pz, const unsigned int count, const float hx, const float hy, const vec3_t a )
+{
+	unsigned int i;
+	float side, cap, top;
+
+	for ( i = 0; i < count; i++ ) {
+		side = fabsf( px[i] ) * a[_x_] + py[i] * a[_y_];
+		top = -py[i] * a[_z_];
+		side = ( ( side > top ) ? side : top ) - hx;
+		cap = fabsf( pz[i] ) - hy;
+
+		d[i] = ( cap > side ) ? cap : side;
+	}
+}
+
+static void 
+scalar_smin( float *d, const float *a, const float *b, const unsigned int count, const float k )
+{
+	unsigned int i;
+	float h;
+
+	for ( i = 0; i < count; i++ ) {
+		h = 0.5f + 0.5f * ( b[i] - a[i] ) / k;
+		h = ( h < 0.0f ) ? 0.0f : ( ( h > 1.0f ) ? 1.0f : h );
+
+		d[i] = b[i] + ( a[i] - b[i] ) * h - k * h * ( 1.0f - h );
+	}
+}
+
+static void 
+scalar_unite( float *d, float *mat, const float *d2, const float mat2, const unsigned int count )
+{
+	unsigned int i;
+
+	for ( i = 0; i < count; i++ ) {
+		if ( d2[i] < d[i] ) {
+			d[i] = d2[i];
+			if ( mat ) {
+				mat[i] = mat2;
+			}
+		}
+	}
+}
+
+static void 
+scalar_carve( float *d, float *mat, const float *d2, const float mat2, const unsigned int count )
+{
+	unsigned int i;
+
+	for ( i = 0; i < count; i++ ) {
+		if ( -d2[i] > d[i] ) {
+			d[i] = -d2[i];
+			if ( mat ) {
+				mat[i] = mat2;
+			}
+		}
+	}
+}
+
+const sdf_t sdf_scalar = {
+	"scalar", 1,
+	scalar_sphere,
+	scalar_box,
+	scalar_rbox2,
+	scalar_torus,
+	scalar_segment,
+	scalar_prism,
+	scalar_smin,
+	scalar_unite,
+	scalar_carve
+};
+
+/*****************************************************************************/
+/*runtime dispatch*/
+#ifdef SDF_X86
+static void 
+cpuid( int regs[4], const int leaf )
+{
+#ifdef _MSC_VER
+	__cpuidex( regs, leaf, 0 );
+#else
+	__cpuid_count( leaf, 0, regs[0], regs[1], regs[2], regs[3] );
+#endif
+}
+
+/* avx state has to be enabled by the os too, not only reported by the cpu */
+static bool 
+os_avx( void )
+{
+	unsigned long long xcr0;
+
+#ifdef _MSC_VER
+	xcr0 = _xgetbv( 0 );
+#else
+	unsigned int lo, hi;
+
+	__asm__ __volatile__( "xgetbv" : "=a"( lo ), "=d"( hi ) : "c"( 0 ) );
+	xcr0 = ( (unsigned long long)hi << 32 ) | lo;
+#endif
+
+	return ( xcr0 & 0x6 ) == 0x6;
+}
+#endif/*SDF_X86*/
+
+const sdf_t* 
+sdf_select( void )
+{
+	static const sdf_t *selected = NULL;
+
+#ifdef SDF_X86
+	int regs[4];
+	int max_leaf;
+	bool sse = FALSE, avx = FALSE, avx2 = FALSE;
+
+	if ( selected != NULL ) {
+		return selected;
+	}
+
+	cpuid( regs, 0 );
+	max_leaf = regs[0];
+
+	if ( max_leaf >= 1 ) {
+		cpuid( regs, 1 );
+		sse = ( regs[3] & ( 1 << 25 ) ) != 0;
+		/*avx and osxsave*/
+		avx = ( regs[2] & ( 1 << 28 ) ) && ( regs[2] & ( 1 << 27 ) ) && os_avx();
+	}
+
+	if ( avx && max_leaf >= 7 ) {
+		cpuid( regs, 7 );
+		avx2 = ( regs[1] & ( 1 << 5 ) ) != 0;
+	}
+
+	selected = avx2 ? &sdf_avx2 : ( sse ? &sdf_sse : &sdf_scalar );
+#else
+	selected = &sdf_scalar;
+#endif
+
+	return selected;
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#ifndef __sdf_h_
+#define __sdf_h_
+
+#include "core.h"
+#include "math.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+	#define SDF_X86
+#endif
+
+/*
+	packet evaluation of the frag.glsl distance primitives
+	points are SoA ( px[i], py[i], pz[i] ), any count, no alignment required
+*/
+
+typedef void(*SDFSphereF)(float *d, const float *px, const float *py, const float *pz, const unsigned int count, const vec3_t o, const float r);
+typedef void(*SDFBoxF)(float *d, const float *px, const float *py, const float *pz, const unsigned int count, const vec3_t o, const vec3_t dim);
+typedef void(*SDFTorusF)(float *d, const float *px, const float *py, const float *pz, const unsigned int count, const vec3_t o, const float radius, const float thickness);
+typedef void(*SDFSegmentF)(float *d, const float *px, const float *py, const float *pz, const unsigned int count, const vec3_t a, const vec3_t b, const float r);
+typedef void(*SDFPrismF)(float *d, const float *px, const float *py, const float *pz, const unsigned int count, const float hx, const float hy, const vec3_t a);
+typedef void(*SDFSminF)(float *d, const float *a, const float *b, const unsigned int count, const float k);
+/* in place de = de_union( de2, de ) / de = de_carve( de2, de ), mat may be NULL */
+typedef void(*SDFCombineF)(float *d, float *mat, const float *d2, const float mat2, const unsigned int count);
+
+typedef struct
+{
+	const char		*name;
+	unsigned int	width;
+
+	SDFSphereF		sphere;
+	SDFBoxF			box;
+	SDFBoxF			rbox2;
+	SDFTorusF		torus;
+	SDFSegmentF		segment;
+	SDFPrismF		prism;
+	SDFSminF		smin;
+	SDFCombineF		unite;
+	SDFCombineF		carve;
+} sdf_t;
+
+extern const sdf_t	sdf_scalar;
+#ifdef SDF_X86
+extern const sdf_t	sdf_sse;
+extern const sdf_t	sdf_avx2;
+#endif/*SDF_X86*/
+
+/* widest implementation supported by the cpu and os, picked once by cpuid */
+const sdf_t*	sdf_select( void );
+
+#endif/*__sdf_h_*/
\ No newline at end of file
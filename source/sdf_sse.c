@@ -0,0 +1,230 @@
+#include "sdf.h"
+
+#ifdef SDF_X86
+
+#include <xmmintrin.h>
+
+/*4 wide, tails go through the scalar path*/
+#define W	4
+
+#define v_abs( a )			_mm_andnot_ps( _mm_set1_ps( -0.0f ), a )
+#define v_len3( x, y, z )	_mm_sqrt_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( x, x ), _mm_mul_ps( y, y ) ), _mm_mul_ps( z, z ) ) )
+#define v_clamp01( a )		_mm_min_ps( _mm_max_ps( a, _mm_setzero_ps() ), _mm_set1_ps( 1.0f ) )
+
+static void 
+sse_sphere( float *d, const float *px, const float *py, const float *pz, const unsigned int count, const vec3_t o, const float r )
+{
+	const __m128 ox = _mm_set1_ps( o[_x_] ), oy = _mm_set1_ps( o[_y_] ), oz = _mm_set1_ps( o[_z_] );
+	const __m128 vr = _mm_set1_ps( r );
+	__m128 x, y, z;
+	unsigned int i;
+
+	for ( i = 0; i + W <= count; i += W ) {
+		x = _mm_sub_ps( ox, _mm_loadu_ps( px + i ) );
+		y = _mm_sub_ps( oy, _mm_loadu_ps( py + i ) );
+		z = _mm_sub_ps( oz, _mm_loadu_ps( pz + i ) );
+
+		_mm_storeu_ps( d + i, _mm_sub_ps( v_len3( x, y, z ), vr ) );
+	}
+
+	sdf_scalar.sphere( d + i, px + i, py + i, pz + i, count - i, o, r );
+}
+
+static void 
+sse_box( float *d, const float *px, const float *py, const float *pz, const unsigned int count, const vec3_t o, const vec3_t dim )
+{
+	const __m128 ox = _mm_set1_ps( o[_x_] ), oy = _mm_set1_ps( o[_y_] ), oz = _mm_set1_ps( o[_z_] );
+	const __m128 dx = _mm_set1_ps( dim[_x_] ), dy = _mm_set1_ps( dim[_y_] ), dz = _mm_set1_ps( dim[_z_] );
+	const __m128 zero = _mm_setzero_ps();
+	__m128 x, y, z, inside;
+	unsigned int i;
+
+	for ( i = 0; i + W <= count; i += W ) {
+		x = _mm_sub_ps( v_abs( _mm_sub_ps( ox, _mm_loadu_ps( px + i ) ) ), dx );
+		y = _mm_sub_ps( v_abs( _mm_sub_ps( oy, _mm_loadu_ps( py + i ) ) ), dy );
+		z = _mm_sub_ps( v_abs( _mm_sub_ps( oz, _mm_loadu_ps( pz + i ) ) ), dz );
+
+		inside = _mm_min_ps( _mm_max_ps( x, _mm_max_ps( y, z ) ), zero );
+
+		x = _mm_max_ps( x, zero );
+		y = _mm_max_ps( y, zero );
+		z = _mm_max_ps( z, zero );
+
+		_mm_storeu_ps( d + i, _mm_add_ps( inside, v_len3( x, y, z ) ) );
+	}
+
+	sdf_scalar.box( d + i, px + i, py + i, pz + i, count - i, o, dim );
+}
+
+static void 
+sse_rbox2( float *d, const float *px, const float *py, const float *pz, const unsigned int count, const vec3_t o, const vec3_t dim )
+{
+	const __m128 ox = _mm_set1_ps( o[_x_] ), oy = _mm_set1_ps( o[_y_] ), oz = _mm_set1_ps( o[_z_] );
+	const __m128 dx = _mm_set1_ps( dim[_x_] ), dy = _mm_set1_ps( dim[_y_] ), dz = _mm_set1_ps( dim[_z_] );
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 bevel = _mm_set1_ps( 0.15f );
+	__m128 x, y, z;
+	unsigned int i;
+
+	for ( i = 0; i + W <= count; i += W ) {
+		x = _mm_max_ps( _mm_sub_ps( v_abs( _mm_sub_ps( ox, _mm_loadu_ps( px + i ) ) ), dx ), zero );
+		y = _mm_max_ps( _mm_sub_ps( v_abs( _mm_sub_ps( oy, _mm_loadu_ps( py + i ) ) ), dy ), zero );
+		z = _mm_max_ps( _mm_sub_ps( v_abs( _mm_sub_ps( oz, _mm_loadu_ps( pz + i ) ) ), dz ), zero );
+
+		_mm_storeu_ps( d + i, _mm_sub_ps( v_len3( x, y, z ), bevel ) );
+	}
+
+	sdf_scalar.rbox2( d + i, px + i, py + i, pz + i, count - i, o, dim );
+}
+
+static void 
+sse_torus( float *d, const float *px, const float *py, const float *pz, const unsigned int count, const vec3_t o, const float radius, const float thickness )
+{
+	const __m128 ox = _mm_set1_ps( o[_x_] ), oy = _mm_set1_ps( o[_y_] ), oz = _mm_set1_ps( o[_z_] );
+	const __m128 vr = _mm_set1_ps( radius ), vt = _mm_set1_ps( thickness );
+	__m128 x, y, z, l;
+	unsigned int i;
+
+	for ( i = 0; i + W <= count; i += W ) {
+		x = _mm_sub_ps( ox, _mm_loadu_ps( px + i ) );
+		y = _mm_sub_ps( oy, _mm_loadu_ps( py + i ) );
+		z = _mm_sub_ps( oz, _mm_loadu_ps( pz + i ) );
+
+		l = _mm_sub_ps( _mm_sqrt_ps( _mm_add_ps( _mm_mul_ps( x, x ), _mm_mul_ps( z, z ) ) ), vr );
+		l = _mm_sqrt_ps( _mm_add_ps( _mm_mul_ps( l, l ), _mm_mul_ps( y, y ) ) );
+
+		_mm_storeu_ps( d + i, _mm_sub_ps( l, vt ) );
+	}
+
+	sdf_scalar.torus( d + i, px + i, py + i, pz + i, count - i, o, radius, thickness );
+}
+
+static void 
+sse_segment( float *d, const float *px, const float *py, const float *pz, const unsigned int count, const vec3_t a, const vec3_t b, const float r )
+{
+	const float bx = b[_x_] - a[_x_], by = b[_y_] - a[_y_], bz = b[_z_] - a[_z_];
+	const __m128 ax = _mm_set1_ps( a[_x_] ), ay = _mm_set1_ps( a[_y_] ), az = _mm_set1_ps( a[_z_] );
+	const __m128 bax = _mm_set1_ps( bx ), bay = _mm_set1_ps( by ), baz = _mm_set1_ps( bz );
+	const __m128 inv = _mm_set1_ps( 1.0f / ( bx * bx + by * by + bz * bz ) );
+	const __m128 vr = _mm_set1_ps( r );
+	__m128 x, y, z, h;
+	unsigned int i;
+
+	for ( i = 0; i + W <= count; i += W ) {
+		x = _mm_sub_ps( _mm_loadu_ps( px + i ), ax );
+		y = _mm_sub_ps( _mm_loadu_ps( py + i ), ay );
+		z = _mm_sub_ps( _mm_loadu_ps( pz + i ), az );
+
+		h = _mm_add_ps( _mm_add_ps( _mm_mul_ps( x, bax ), _mm_mul_ps( y, bay ) ), _mm_mul_ps( z, baz ) );
+		h = v_clamp01( _mm_mul_ps( h, inv ) );
+
+		x = _mm_sub_ps( x, _mm_mul_ps( bax, h ) );
+		y = _mm_sub_ps( y, _mm_mul_ps( bay, h ) );
+		z = _mm_sub_ps( z, _mm_mul_ps( baz, h ) );
+
+		_mm_storeu_ps( d + i, _mm_sub_ps( v_len3( x, y, z ), vr ) );
+	}
+
+	sdf_scalar.segment( d + i, px + i, py + i, pz + i, count - i, a, b, r );
+}
+
+static void 
+sse_prism( float *d, const float *px, const float *py, const float *pz, const unsigned int count, const float hx, const float hy, const vec3_t a )
+{
+	const __m128 vhx = _mm_set1_ps( hx ), vhy = _mm_set1_ps( hy );
+	const __m128 ax = _mm_set1_ps( a[_x_] ), ay = _mm_set1_ps( a[_y_] ), az = _mm_set1_ps( -a[_z_] );
+	__m128 y, side, cap;
+	unsigned int i;
+
+	for ( i = 0; i + W <= count; i += W ) {
+		y = _mm_loadu_ps( py + i );
+
+		side = _mm_add_ps( _mm_mul_ps( v_abs( _mm_loadu_ps( px + i ) ), ax ), _mm_mul_ps( y, ay ) );
+		side = _mm_sub_ps( _mm_max_ps( side, _mm_mul_ps( y, az ) ), vhx );
+		cap = _mm_sub_ps( v_abs( _mm_loadu_ps( pz + i ) ), vhy );
+
+		_mm_storeu_ps( d + i, _mm_max_ps( cap, side ) );
+	}
+
+	sdf_scalar.prism( d + i, px + i, py + i, pz + i, count - i, hx, hy, a );
+}
+
+static void 
+sse_smin( float *d, const float *a, const float *b, const unsigned int count, const float k )
+{
+	const __m128 vk = _mm_set1_ps( k ), half = _mm_set1_ps( 0.5f ), one = _mm_set1_ps( 1.0f );
+	__m128 va, vb, h;
+	unsigned int i;
+
+	for ( i = 0; i + W <= count; i += W ) {
+		va = _mm_loadu_ps( a + i );
+		vb = _mm_loadu_ps( b + i );
+
+		h = v_clamp01( _mm_add_ps( half, _mm_mul_ps( half, _mm_div_ps( _mm_sub_ps( vb, va ), vk ) ) ) );
+
+		_mm_storeu_ps( d + i, _mm_sub_ps( _mm_add_ps( vb, _mm_mul_ps( _mm_sub_ps( va, vb ), h ) ),
+										  _mm_mul_ps( _mm_mul_ps( vk, h ), _mm_sub_ps( one, h ) ) ) );
+	}
+
+	sdf_scalar.smin( d + i, a + i, b + i, count - i, k );
+}
+
+static void 
+sse_unite( float *d, float *mat, const float *d2, const float mat2, const unsigned int count )
+{
+	const __m128 vm = _mm_set1_ps( mat2 );
+	__m128 vd, vd2, mask;
+	unsigned int i;
+
+	for ( i = 0; i + W <= count; i += W ) {
+		vd = _mm_loadu_ps( d + i );
+		vd2 = _mm_loadu_ps( d2 + i );
+		mask = _mm_cmplt_ps( vd2, vd );
+
+		_mm_storeu_ps( d + i, _mm_min_ps( vd2, vd ) );
+
+		if ( mat ) {
+			_mm_storeu_ps( mat + i, _mm_or_ps( _mm_and_ps( mask, vm ), _mm_andnot_ps( mask, _mm_loadu_ps( mat + i ) ) ) );
+		}
+	}
+
+	sdf_scalar.unite( d + i, mat ? mat + i : NULL, d2 + i, mat2, count - i );
+}
+
+static void 
+sse_carve( float *d, float *mat, const float *d2, const float mat2, const unsigned int count )
+{
+	const __m128 vm = _mm_set1_ps( mat2 );
+	const __m128 sign = _mm_set1_ps( -0.0f );
+	__m128 vd, vd2, mask;
+	unsigned int i;
+
+	for ( i = 0; i + W <= count; i += W ) {
+		vd = _mm_loadu_ps( d + i );
+		vd2 = _mm_xor_ps( _mm_loadu_ps( d2 + i ), sign );
+		mask = _mm_cmpgt_ps( vd2, vd );
+
+		_mm_storeu_ps( d + i, _mm_or_ps( _mm_and_ps( mask, vd2 ), _mm_andnot_ps( mask, vd ) ) );
+
+		if ( mat ) {
+			_mm_storeu_ps( mat + i, _mm_or_ps( _mm_and_ps( mask, vm ), _mm_andnot_ps( mask, _mm_loadu_ps( mat + i ) ) ) );
+		}
+	}
+
+	sdf_scalar.carve( d + i, mat ? mat + i : NULL, d2 + i, mat2, count - i );
+}
+
+const sdf_t sdf_sse = {
+	"sse", W,
+	sse_sphere,
+	sse_box,
+	sse_rbox2,
+	sse_torus,
+	sse_segment,
+	sse_prism,
+	sse_smin,
+	sse_unite,
+	sse_carve
+};
+
+#endif/*SDF_X86*/
\ No newline at end of file
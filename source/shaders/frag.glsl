@@ -2,14 +2,33 @@
 
 #pragma (optimize)
 
+/*
+    passes are selected by the host, defined right after #version:
+    _PASS_CONE      one cone per CONE_TILE^2 pixels, writes the distance the whole tile can skip
+    _PASS_GBUFFER   primary hit, writes distance, material and normal, sky and debug views go to color
+    _PASS_COMPUTE   the gbuffer pass as a compute shader, one work group per cone tile, writes through images
+    _PASS_SHADOW    sun visibility and occlusion at 1/_shadow_scale resolution, reads the gbuffer
+    _PASS_LIGHT     shading of the covered pixels, reads the gbuffer and upsamples the shadow pass
+    neither         everything in one pass
+*/
+#ifndef _PASS_COMPUTE
 layout( location = 0 ) out vec4 color;
+#endif
 
-//#define _PACKY
+#ifdef _PASS_GBUFFER
+layout( location = 1 ) out vec4 gbuffer0;       /*dist, mat, iterations*/
+layout( location = 2 ) out vec4 gbuffer1;       /*normal, 1 where the light pass shades*/
+#endif
 
-#define _ENABLE_DEBUG
-#define _SKY
-//#define _FOG
-//#define _ENABLE_FIXED_CAMERA
+#ifdef _PASS_LIGHT
+layout( early_fragment_tests ) in;
+#endif
+
+/*
+    _SKY, _FOG and _ENABLE_FIXED_CAMERA come with the pass defines, see pass_defines() in impl.c;
+    one of the _DEBUG_* views and _DEBUG come with the variant F5 selects, the others have no
+    debug code at all
+*/
 
 #define MAXCELL     121
 
@@ -19,15 +38,58 @@ layout( std140 ) uniform camera_block {
     vec4 dir;
     vec4 right;
     vec4 up;
+    /*camera of the previous gbuffer*/
+    vec4 prev_pos;
+    vec4 prev_dir;
+    vec4 prev_right;
+    vec4 prev_up;
 } _camera;
 
-uniform int         _debug;
+/*rows of the material table in impl.c, MATERIALS and the MAT_* ids come with the pass defines*/
+struct material_t
+{
+    /*rgb, gloss*/
+    vec4    albedo;
+    /*fr0, texture layer or -1, texture scale, 1 to project on xz only*/
+    vec4    surface;
+};
+
+layout( std140 ) uniform material_block {
+    material_t  m[MATERIALS];
+} _materials;
+
 uniform float       _time;
 uniform vec3        _resolution;
+uniform float       _omega;             /*over relaxation of trace(), 1 is plain sphere tracing*/
+
+/*material textures, one layer each with a full mip chain, see load_textures() in impl.c*/
+uniform sampler2DArray _textures;
+
+#if defined( _PASS_GBUFFER ) || defined( _PASS_COMPUTE )
+uniform int         _reproject;
+uniform int         _frame;
+uniform int         _cone_prepass;
+uniform sampler2D   _cone;
+uniform vec3        _prev_resolution;
+uniform sampler2D   _history;
+#endif
 
-uniform sampler2D   _tex1;
-uniform sampler2D   _tex2;
-uniform sampler2D   _tex3;
+#ifdef _PASS_COMPUTE
+layout( rgba8 )   uniform writeonly image2D _color_image;
+layout( rgba32f ) uniform writeonly image2D _gbuffer0_image;
+layout( rgba16f ) uniform writeonly image2D _gbuffer1_image;
+#endif
+
+#if defined( _PASS_LIGHT ) || defined( _PASS_SHADOW )
+uniform sampler2D   _gbuffer0;
+uniform sampler2D   _gbuffer1;
+uniform int         _shadow_scale;
+#endif
+
+#ifdef _PASS_LIGHT
+uniform int         _shadow_lowres;
+uniform sampler2D   _shadow;
+#endif
 
 uniform vec3        _packy_pos;
 uniform vec3        _packy_angles;
@@ -35,6 +97,141 @@ uniform vec3        _gogu_pos;
 uniform vec3        _gogu_angles;
 uniform int         _bonbon_count;
 uniform vec4        _bonbons[MAXCELL];
+
+#if defined( SCENE_BVH ) && defined( _BVH_WALK )
+/*nodes of the scene bvh, see bvh.h*/
+struct bvh_node_t
+{
+    vec3    lo;
+    int     prim;
+    vec3    hi;
+    int     skip;
+};
+
+layout( std430 ) readonly buffer bvh_block {
+    bvh_node_t _bvh[];
+};
+#endif
+
+#if defined( SCENE_BVH ) && defined( _GRID_WALK )
+/*cells per side, has to match GRID_CELLS in grid.h*/
+const int   GRID_CELLS      = 16;
+
+/*grid of each scene run, see grid.h*/
+struct grid_run_t
+{
+    vec4    lo;
+    vec4    size;
+};
+
+layout( std430 ) readonly buffer grid_block {
+    grid_run_t  _grid_runs[SCENE_RUNS];
+    int         _grid_prims[];
+};
+
+/*first and count of the cell list, distance to the nearest box of the run*/
+uniform sampler3D   _grid;
+
+ivec3 
+grid_cell( const in vec3 p, const in int run )
+{
+    return ivec3( floor( ( p - _grid_runs[run].lo.xyz ) / _grid_runs[run].size.xyz ) );
+}
+
+bool 
+grid_inside( const in vec3 p, const in int run )
+{
+    ivec3 c = grid_cell( p, run );
+    return all( greaterThanEqual( c, ivec3( 0 ) ) ) && all( lessThan( c, ivec3( GRID_CELLS ) ) );
+}
+#endif
+
+#if defined( SCENE_BAKE ) && defined( _BAKE_VOLUME )
+/*the static start of the scene sampled on the cpu, see bake.h*/
+uniform sampler3D   _bake;
+uniform vec3        _bake_lo;
+uniform vec3        _bake_extent;
+uniform float       _bake_error;
+
+#ifdef _BAKE_BRICKS
+/*samples per side of a brick, has to match BAKE_BRICK in bake.h*/
+#define BAKE_BRICK          8
+
+/*atlas position of every brick or -1, and its least distance*/
+uniform sampler3D   _bake_index;
+uniform vec3        _bake_bricks;
+#endif
+
+/*never more than the static part of scene_dist(), 0 outside of the volume*/
+float 
+bake_dist( const in vec3 p )
+{
+    vec3 uvw = ( p - _bake_lo ) / _bake_extent;
+
+    if( any( lessThan( uvw, vec3( 0.0 ) ) ) || any( greaterThan( uvw, vec3( 1.0 ) ) ) ) {
+        return 0.0;
+    }
+
+#ifdef _BAKE_BRICKS
+    vec3 b = uvw * _bake_bricks;
+    vec3 brick = min( floor( b ), _bake_bricks - 1.0 );
+    vec4 entry = texelFetch( _bake_index, ivec3( brick ), 0 );
+
+    if( entry.x < 0.0 ) {
+        return entry.w;
+    }
+
+    /*corner samples sit on texel centers, the filter never reaches the neighbouring brick*/
+    uvw = ( entry.xyz * float( BAKE_BRICK ) + 0.5 + ( b - brick ) * float( BAKE_BRICK - 1 ) ) / vec3( textureSize( _bake, 0 ) );
+#endif
+
+    return texture( _bake, uvw ).r - _bake_error;
+}
+
+/*least distance over every voxel or brick and over their parents, see bake.h*/
+uniform sampler3D   _bake_mip;
+
+/*
+    how far the ray can go from p without meeting a baked surface: through the cell of
+    the pyramid around p no larger than the step d, when it holds none, then its least
+    distance on; 0 near surfaces, outside of the volume or when the cell is not empty
+*/
+float 
+bake_skip( const in vec3 p, const in vec3 rd, const in float d )
+{
+    vec3 uvw = ( p - _bake_lo ) / _bake_extent;
+
+    if( any( lessThan( uvw, vec3( 0.0 ) ) ) || any( greaterThan( uvw, vec3( 1.0 ) ) ) ) {
+        return 0.0;
+    }
+
+    ivec3 base = textureSize( _bake_mip, 0 );
+    vec3  size = _bake_extent / vec3( base );
+    float least = min( min( size.x, size.y ), size.z );
+
+    /*a voxel is no longer than the sphere step*/
+    if( d < least ) {
+        return 0.0;
+    }
+
+    int   l = min( int( log2( d / least ) ), textureQueryLevels( _bake_mip ) - 1 );
+
+    /*the last cell of a row reaches to the end of the volume*/
+    ivec3 dim = textureSize( _bake_mip, l );
+    ivec3 c = min( min( ivec3( uvw * vec3( base ) ), base - 1 ) >> l, dim - 1 );
+    float m = texelFetch( _bake_mip, c, l ).r;
+
+    if( m <= 0.0 ) {
+        return 0.0;
+    }
+
+    vec3 lo = _bake_lo + vec3( c << l ) * size;
+    vec3 hi = mix( _bake_lo + vec3( ( c + 1 ) << l ) * size, _bake_lo + _bake_extent, equal( c, dim - 1 ) );
+    vec3 t = abs( mix( lo, hi, greaterThan( rd, vec3( 0.0 ) ) ) - p ) / max( abs( rd ), vec3( 1e-6 ) );
+
+    return min( min( t.x, t.y ), t.z ) + m;
+}
+#endif
 /*---------------------------------------------------------------------------*/
 const float FOV         = 2.5;
 const float GAMMA       = 2.2;
@@ -45,6 +242,19 @@ const float NEPSILON    = 1e-3;
 const float VIEW_DIST   = 128.0;
 const int   MAX_STEPS   = 256;
 
+/*reprojection of the previous gbuffer*/
+const int   REPROJ_ITER     = 3;
+const float REPROJ_BACKOFF  = 0.05;
+const float REPROJ_PIXELS   = 4.0;
+const int   REPROJ_REFRESH  = 8;
+
+/*cone prepass, tile size has to match CONE_TILE in impl_local.h and the compute work group*/
+const int   CONE_TILE       = 8;
+const int   CONE_STEPS      = 128;
+
+/*textures seen at a grazing angle, the pixel footprint grows by 1 / cos up to 1 / TEX_GRAZING*/
+const float TEX_GRAZING     = 1.0 / 16.0;
+
 const float VIS_START   = EPSILON * 5;
 const float VIS_SS      = 32.0;
 const int   VIS_STEPS   = 64;
@@ -53,24 +263,8 @@ const float OCC_STEPD   = 0.08;
 
 const float PI          = 3.14159265359;
 
-/*material idx*/
+/*material idx, the others index _materials*/
 const float MAT_SKY         = - 1.0;
-const float MAT_RED         =   1.0;
-const float MAT_BLUE        =   2.0;
-const float MAT_GREEN       =   3.0;
-const float MAT_OBSIDIAN    =   4.0;
-const float MAT_PEARL       =   4.5;
-const float MAT_EMERALD		=   4.6;
-const float MAT_ALUMINIUM   =   4.7;
-const float MAT_FLESH       =   5.0;
-const float MAT_GOLD        =   5.5;
-const float MAT_TEX2_2D     =   7.0;
-const float MAT_TEX1_3D     =   6.5;
-const float MAT_TEX2_3D     =   8.5;
-const float MAT_OCEAN       =   9.0;
-const float MAT_MOSS        =  10.0;
-const float MAT_MOSS_TEX    =  10.5;
-const float MAT_FLOOR_TEX   =  11.0;
 
 float halftime          = _time / 2.0;
 float quartertime       = _time / 4.0;
@@ -79,6 +273,11 @@ float sinhalftime       = sin( halftime );
 float coshalftime       = cos( halftime );
 float sinpacky          = sin( _time * 8.0 ) * 0.5 + 0.5;
 
+/*cone radius per unit of distance, half a tile diagonal*/
+float CONE_K            = float( CONE_TILE ) * sqrt( 2.0 ) / ( _resolution.y * FOV );
+/*world size of a pixel per unit of distance*/
+float PIXEL_K           = 2.0 / ( _resolution.y * FOV );
+
 vec3  SUN               = normalize( vec3( 0.55, 0.5, -0.1 ) );
 const vec3  SUN_COL     = vec3( 1.00, 1.00, 1.00 );
 
@@ -106,13 +305,12 @@ struct point_t
     vec3    rd;
     float   mat;
     float   dist;
-#ifdef _ENABLE_DEBUG    
+#ifdef _DEBUG    
     float   iter;
+    float   fallback;
 #endif    
 };
 
-de_t                bbb[MAXCELL];
-
 /*---------------------------------------------------------------------------*/
 vec2 
 uv_setup( vec2 frag )
@@ -306,6 +504,40 @@ de_carve( de_t de1, de_t de2 )
     return ( det.dist > de2.dist ) ? det : de2;
 }
 
+/*blended union, the closer one gives the material*/
+de_t 
+de_smooth( de_t de1, de_t de2, float k )
+{
+    de_t de = de_union( de1, de2 );
+    de.dist = smin( de1.dist, de2.dist, k );
+    return de;
+}
+
+/*distance only overloads for scene_dist()*/
+float 
+de_union( float d1, float d2 )
+{
+    return min( d1, d2 );
+}
+
+float 
+de_intersect( float d1, float d2 )
+{
+    return max( d1, d2 );
+}
+
+float 
+de_carve( float d1, float d2 )
+{
+    return max( -d1, d2 );
+}
+
+float 
+de_smooth( float d1, float d2, float k )
+{
+    return smin( d1, d2, k );
+}
+
 /*procedurals----------------------------------------------------------------*/
 float 
 hash( float n )
@@ -354,140 +586,17 @@ fract_noise2d( in vec2 xy )
 
 /*---------------------------------------------------------------------------*/
 vec3 
-texture3D( sampler2D tex, vec3 p, vec3 n, float scale )
+texture3D( const in float layer, vec3 p, vec3 n, float scale )
 {
-    vec3 x = texture2D( tex, p.yz * scale ).xyz;
-    vec3 y = texture2D( tex, p.zx * scale ).xyz;
-    vec3 z = texture2D( tex, p.xy * scale ).xyz;
+    /*the top level, so the distance does not depend on the view*/
+    vec3 x = textureLod( _textures, vec3( p.yz * scale, layer ), 0.0 ).xyz;
+    vec3 y = textureLod( _textures, vec3( p.zx * scale, layer ), 0.0 ).xyz;
+    vec3 z = textureLod( _textures, vec3( p.xy * scale, layer ), 0.0 ).xyz;
 
     return x*abs( n.x ) + y*abs( n.y ) + z*abs( n.z );  
 }
-
-/*---------------------------------------------------------------------------*/
-de_t 
-packy( const in vec3 p )
-{
-    de_t de;
-
-    de.mat = MAT_GREEN;
-    de.dist = length( p ) - 1.0;
-
-    vec3 q = p - vec3( 1.25 + sinpacky, -0.55, 0.0 );
-    q = rotate_z( q, 0.87 );
-
-    de_t mouth = de_t(  de_prism( q, vec2( 0.5, 1.25 ), vec3( 0.50, 0.25, 1.0 ) ), 
-                        MAT_FLESH );
-    de = de_carve( mouth, de);
-
-    de_t eye = de_t(    de_sphere( p, vec3( 0.65, 0.65, 0.35 ), 0.08 ), 
-                        MAT_OBSIDIAN );
-    de = de_union( eye, de);
-
-    eye = de_t(    de_sphere( p, vec3( 0.65, 0.65,-0.35 ), 0.08 ), 
-                   MAT_OBSIDIAN );
-    de = de_union( eye, de);
-
-    /* left arm */
-    float arm_1 = de_segment( p, vec3( 0.0,0.15,0.95 ), vec3( 0.05,0.0,1.25 ), 0.05 );
-    float arm_2 = de_segment( p, vec3( 0.05,0.0,1.25 ), vec3( 0.25,0.3,1.45 ), 0.05 );
-
-    de_t arm = de_t(    smin( arm_1, arm_2, 0.05 ),
-                        MAT_GREEN );
-    de = de_union( arm, de);
-
-    /* right arm */
-    arm_1 = de_segment( p, vec3( 0.0,0.15,-0.95 ), vec3( 0.05,0.0,-1.25 ), 0.05 );
-    arm_2 = de_segment( p, vec3( 0.05,0.0,-1.25 ), vec3( 0.25,-0.3,-1.45 ), 0.05 );
-
-    arm = de_t(    smin( arm_1, arm_2, 0.05 ),
-                   MAT_GREEN );
-    de = de_union( arm, de);
-
-    return de;
-}
-
-de_t 
-facult( const in vec3 p )
-{
-    de_t de;    
-    de.dist = de_box( p, vec3( 0.0, -0.75, 0.0 ), vec3( 0.05, 0.02, 0.40 ) );
-    de.mat = MAT_OBSIDIAN;
-
-    float d1 = de_box( p, vec3( 0.0, -0.71, 0.0 ), vec3( 0.05, 0.02, 0.38 ) );
-
-    if( d1 < de.dist ) {
-        de.dist = d1;
-        de.mat = MAT_ALUMINIUM;
-    }
-
-    d1 = de_box( p, vec3( 0.0, -0.67, 0.0 ), vec3( 0.05, 0.02, 0.36 ) );
-
-    if( d1 < de.dist ) {
-        de.dist = d1;
-        de.mat = MAT_OBSIDIAN;
-    }
-
-    d1 = de_box( p, vec3( 0.0, -0.63, 0.0 ), vec3( 0.05, 0.04, 0.32 ) );
-
-    if( d1 < de.dist ) {
-        de.dist = d1;
-        de.mat = MAT_PEARL;
-    }
-
-    d1 = de_box( p, vec3( 0.0, -0.40, 0.26 ), vec3( 0.05, 0.20, 0.05 ) );
-
-    if( d1 < de.dist ) {
-        de.dist = d1;
-        de.mat = MAT_ALUMINIUM;
-    }
-
-    d1 = de_box( p, vec3( 0.0, -0.40, 0.13 ), vec3( 0.05, 0.20, 0.05 ) );
-
-    if( d1 < de.dist ) {
-        de.dist = d1;
-        de.mat = MAT_ALUMINIUM;
-    }
-
-    d1 = de_box( p, vec3( 0.0, -0.40, 0.00 ), vec3( 0.05, 0.20, 0.05 ) );
-
-    if( d1 < de.dist ) {
-        de.dist = d1;
-        de.mat = MAT_ALUMINIUM;
-    }
-
-    d1 = de_box( p, vec3( 0.0, -0.40, -0.13 ), vec3( 0.05, 0.20, 0.05 ) );
-
-    if( d1 < de.dist ) {
-        de.dist = d1;
-        de.mat = MAT_ALUMINIUM;
-    }
-
-    d1 = de_box( p, vec3( 0.0, -0.40, -0.26 ), vec3( 0.05, 0.20, 0.05 ) );
-
-    if( d1 < de.dist ) {
-        de.dist = d1;
-        de.mat = MAT_ALUMINIUM;
-    }
-
-    d1 = de_box( p, vec3( 0.0, -0.16, 0.0 ), vec3( 0.05, 0.04, 0.32 ) );
-
-    if( d1 < de.dist ) {
-        de.dist = d1;
-        de.mat = MAT_OBSIDIAN;
-    }    
-
-    vec3 q = rotate_y( p, 1.57079633 );
-    q -= vec3( 0.0, -0.10, 0.0 );
-    d1 = de_prism( q, vec2( 0.05, 0.05 ), vec3( 0.14, 0.4, 2.5 ) );
-
-    if( d1 < de.dist ) {
-        de.dist = d1;
-        de.mat = MAT_OBSIDIAN;
-    }   
-
-    return de;
-}
-
+/*library shapes below only compile for scenes that use them, see scene.h*/
+#ifdef SCENE_CLUSTER
 float
 cluster( const in vec3 p )
 {
@@ -517,59 +626,16 @@ cluster( const in vec3 p )
 
     return res;  
 }
+#endif
 
-de_t 
-gogu( const in vec3 p )
-{
-    de_t de;
-
-    de.mat = MAT_FLESH;
-
-    float sina = sinhalftime;
-    float cosa = coshalftime;
-      
-    float bump = 0.035*sin( 8.0*_time )*sin( 2.0*p.y )*sin( 16.0*p.z );
-    de.dist = length( p ) - 1.15 + bump;
-
-    float reye = length( p-vec3( 0.95,0.35,0.25 ) ) - 0.15;
-
-    if( reye < de.dist ) {
-        de.dist = reye;
-        de.mat = MAT_PEARL;
-    }
-
-    reye = length( p-vec3( 1.05,0.38,0.25 ) ) - 0.05;
-
-    if( reye < de.dist ) {
-        de.dist = reye;
-        de.mat = MAT_BLUE;
-    }
-
-    float leye = length( p-vec3( 0.95,0.35,-0.25 ) ) - 0.15;
-
-    if( leye < de.dist ) {
-        de.dist = leye;
-        de.mat = MAT_PEARL;
-    }
-
-    leye = length( p-vec3( 1.05,0.38,-0.25 ) ) - 0.05;
-
-    if( leye < de.dist ) {
-        de.dist = leye;
-        de.mat = MAT_BLUE;
-    }
-
-    de.dist = smin( de.dist, de_sphere( p, vec3( 0.0, 0.25, 0.0 ), 1.15 ), 0.05 );
-
-    return de;
-}
-
+#ifdef SCENE_WAVYFLOOR
 float 
 de_wavyfloor( const in vec3 p, const in float height )
 {
     float mod = sin( ( p.x*0.3 + _time ) * 0.75 ) + sin( ( p.z*0.63 + _time * 2 ) * 0.07 ) + 0.1;
     return p.y - height + mod;
 }
+#endif
 
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
@@ -579,6 +645,7 @@ de_wavyfloor( const in vec3 p, const in float height )
 ///////////////////////////////////////////////////////////////////////////////
 /*FRACTALS*/
 
+#ifdef SCENE_MENGER
 float fract3d_menger( vec3 z )
 {
     vec3    Offset = vec3( 10.0, 10.0, 10.0 );
@@ -598,7 +665,9 @@ float fract3d_menger( vec3 z )
     
     return abs( length( z )-0.0  ) * pow( Scale, float( -n ) );
 }
+#endif
 
+#ifdef SCENE_WEIRD
 float fract3d_weird( vec3 p )
 {
     vec3    CSize = vec3( .808, .8, 1.137 );
@@ -619,7 +688,9 @@ float fract3d_weird( vec3 p )
     rxy = max( rxy, -( n ) / ( length( p ) )-.07+sin( _time*2.0+p.x+p.y+23.5*p.z )*.02 );
     return ( rxy ) / abs( scale );    
 }
+#endif
 
+#ifdef SCENE_MANDELBULB
 float stime, ctime;
  void ry( inout vec3 p, float a ){  
     float c,s;vec3 q=p;  
@@ -675,7 +746,9 @@ float fract3d_mandelbulb( vec3 p ){
     ry( p, stime );
     return mb( p ).x; 
 } 
+#endif
 
+#ifdef SCENE_QJULIA
 float fract3d_qjulia( vec3 pos ) {
     vec4 C = vec4( 0.10, 0.63, -0.03, -0.06 );
     vec4 p = vec4( pos, 0.0 );
@@ -689,6 +762,7 @@ float fract3d_qjulia( vec3 pos ) {
     float r = length( p );
     return  0.5 * r * log( r ) / length( dp );
 }
+#endif
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
@@ -696,105 +770,7 @@ float fract3d_qjulia( vec3 pos ) {
 ///////////////////////////////////////////////////////////////////////////////
 
 
-#ifndef _PACKY
-de_t
-scene( const in vec3 p )
-{
-    de_t de, de2, de3;
-
-    /*de.mat  = MAT_OCEAN;
-    de.dist = de_wavyfloor( p, -1.0 );*/
-
-    de.dist = de_plane( p, vec3( 0.0, 1.0, 0.0 ), 1.0  );
-    de.mat = MAT_ALUMINIUM;
-
-    vec3 q = rotate_y( p - vec3( 15.0, 3.0, 15.0), _time ) / 5.0;
-    de2 = facult( q );
-    de2.dist *= 5.0;
-
-    de = de_union( de, de2 );
-
-    float bb = 0.0;
-
-    bb = de_sphere( p, vec3( 10.0, 0.0, 15.0), 1.5 );
-  
-    if( bb < de.dist ) {
-        vec3 q = rotate_y( p - vec3( 10.0, 0.0, 15.0), quartertime );
-        de_t obj_packy = packy( q );
-        de = de_union( obj_packy, de );
-    }
-
-    bb = de_sphere( p, vec3( 10.0, 0.0, 20.0), 1.5 );
-
-    if( bb < de.dist ) {
-        vec3 q = rotate_y( p - vec3( 10.0, 0.0, 20.0), -halftime );
-        de_t obj_gogu = gogu( q );
-        de = de_union( obj_gogu, de );
-    }   
- 
-/*    de2.dist = de_box( p, vec3( 15.0, 0.5, 20.0 ), vec3( 1.5 ) );
-    de2.mat = MAT_FLESH;
-
-    de = de_union( de, de2 );
-
-    de2.dist = de_rbox( p, vec3( 20.0, 2.0, 20.0 ), vec3( 0.75, 2.75, 0.75 ), 0.25 );
-    de2.mat = MAT_BLUE;
-
-    de = de_union( de, de2 );
-
-    q = rotate_z( p - vec3( 20.0, 0.0, 15.0), _time );
-    q = rotate_x( q, _time );
-    de2.dist = de_torus( q, vec3( 0.0 ), vec2( 1.0, 0.25 ) );
-    de2.mat = MAT_GREEN;
-
-    de = de_union( de, de2 );
-
-    de2.dist = de_cylinder( p - vec3( 15.0, 0.0, 10.0), vec2( 1.0, 1.0 ) ) + noise3d( p * 5.5 ) * 0.18;
-    de2.mat = MAT_EMERALD;
-
-    de = de_union( de, de2 );
-*/
-    
- 	//float desert = de_plane( p, vec3( 0.0, 1.0, 0.0 ), 1.0  ) + bump_noise;
-    //de.mat  = MAT_GOLD;
-    //de.dist = desert;
-
-    //float bump = 0.10*sin( 10.0*p.x )*sin( 8.0*_time )*sin( 10.0*p.z );
-    //float disco = de_sphere( p, vec3( 0.0, sin( _time )*5.0, 0.0 ), 5.25 ) + bump;
-    //de.mat  = MAT_GREEN;
-    //de.dist = disco;
-
-    //float bump = 0.10*sin( 10.0*p.x )*sin( 8.0*_time )*sin( 10.0*p.z );
-    //vec3 q = p;
-    //q.x = mod( q.x, 16.0) - 8.0;
-    //q.y = mod( q.y, 16.0) - 8.0;
-    //q.z = mod( q.z, 16.0) - 8.0;
-    //float disco = de_sphere( q, vec3(0.0), 1.0 ) + bump;
-    //de.mat  = MAT_GREEN;
-    //de.dist = disco;    
-
-    //float fractal = fract3d_menger( p );
-    //de2.mat  = MAT_TEX1_3D;
-    //de2.dist = fractal;    
-
-    //float fractal = fract3d_weird( p ); 
-    //de.mat  = MAT_FLESH;
-    //de.dist = fractal;    
-
-    //float fractal = fract3d_mandelbulb( p ); 
-	//de2.mat = MAT_OCEAN;
-    //de2.dist = fractal;    
-	//de = de_union( de, de2 );
-
-    //float fractal = fract3d_qjulia( rotate_y( p, _time/4 ) );
-    //de.mat  = MAT_GOLD;
-    //de.dist = fractal;  
-
-    return de;    
-}
-
-#else
-
+#ifdef SCENE_MOSS
 float
 moss_tile( const in vec3 p, const in vec3 o, const in vec3 dim )
 {
@@ -804,132 +780,50 @@ moss_tile( const in vec3 p, const in vec3 o, const in vec3 dim )
 
     if( z < length( dim ) ) {
         vec3 n = normalize( o - p );
-        bump = texture3D( _tex3, p, n, 0.005 ).r * 0.55;
+        bump = texture3D( 2.0, p, n, 0.005 ).r * 0.55;
     }
 
     de = de_box( p, o, dim ) + bump;
 
     return de;
 }
+#endif
 
-de_t
-scene( const in vec3 p )
-{
-    de_t de = de_t( de_box( p, vec3( 19.5, -1.5, 19.5 ), vec3( 19.5, 0.5, 19.5 ) ),
-                    MAT_FLOOR_TEX );
-
-    de_t barrier_north = de_t(      de_box( p, vec3( 19.5, -0.5, 37.5 ), vec3( 19.5, 1.05, 1.5 ) ),
-                                    MAT_TEX1_3D );
-    de_t barrier_south = de_t(      de_box( p, vec3( 19.5, -0.5, 1.5 ), vec3( 19.5, 1.05, 1.5 ) ),
-                                    MAT_TEX1_3D );
-    de_t barrier_east = de_t(       de_box( p, vec3( 1.5, -0.5, 19.5 ), vec3( 1.5, 1.05, 19.5 ) ),
-                                    MAT_TEX1_3D );
-    de_t barrier_west = de_t(       de_box( p, vec3( 37.5, -0.5, 19.5 ), vec3( 1.5, 1.05, 19.5 ) ),
-                                    MAT_TEX1_3D ); 
-
-    de_t elem_a = de_t(       de_rbox2( p, vec3( 33.0, -0.5, 15.0 ), vec3( 3.0, 1.05, 3.0 ) ),
-                              MAT_MOSS_TEX );
-    de_t elem_b = de_t(       de_rbox2( p, vec3( 31.5, -0.5, 27.0 ), vec3( 1.5, 1.05, 6.0 ) ),
-                              MAT_MOSS_TEX );    
-    de_t elem_c = de_t(       de_rbox2( p, vec3( 30.0, -0.5, 7.5 ), vec3( 3.0, 1.05, 1.5 ) ),
-                              MAT_MOSS_TEX );   
-    de_t elem_d = de_t(       de_rbox2( p, vec3( 30.0, -0.5, 31.5 ), vec3( 3.0, 1.05, 1.5 ) ),
-                              MAT_MOSS_TEX );    
-    de_t elem_e = de_t(       de_rbox2( p, vec3( 25.5, -0.5, 24.0 ), vec3( 1.5, 1.05, 3.0 ) ),
-                              MAT_MOSS_TEX );                                                              
-    de_t elem_f = de_t(       de_rbox2( p, vec3( 25.5, -0.5, 15.0 ), vec3( 1.5, 1.05, 3.0 ) ),
-                              MAT_MOSS_TEX );      
-    de_t elem_g = de_t(       de_rbox2( p, vec3( 19.5, -0.5, 31.5 ), vec3( 4.5, 1.05, 1.5 ) ),
-                              MAT_MOSS_TEX );                                 
-    de_t elem_h = de_t(       de_rbox2( p, vec3( 22.5, -0.5, 25.5 ), vec3( 1.5, 1.05, 1.5 ) ),
-                              MAT_MOSS_TEX );   
-    de_t elem_i = de_t(       de_rbox2( p, vec3( 22.5, -0.5, 7.5 ), vec3( 1.5, 1.05, 1.5 ) ),
-                              MAT_MOSS_TEX );   
-    de_t elem_j = de_t(       de_rbox2( p, vec3( 19.5, -0.5, 13.5 ), vec3( 1.5, 1.05, 1.5 ) ),
-                              MAT_MOSS_TEX );       
-    de_t elem_k = de_t(       de_rbox2( p, vec3( 19.5, -0.5, 19.5 ), vec3( 1.5, 1.05, 1.5 ) ),
-                              MAT_MOSS_TEX );       
-    de_t elem_l = de_t(       de_rbox2( p, vec3( 16.5, -0.5, 27.0 ), vec3( 1.5, 1.05, 3.0 ) ),
-                              MAT_MOSS_TEX );          
-    de_t elem_m = de_t(       de_rbox2( p, vec3( 16.5, -0.5, 13.5 ), vec3( 1.5, 1.05, 7.5 ) ),
-                              MAT_MOSS_TEX );              
-    de_t elem_n = de_t(       de_rbox2( p, vec3( 7.5, -0.5, 28.5 ), vec3( 4.5, 1.05, 1.5 ) ),
-                              MAT_MOSS_TEX );   
-    de_t elem_o = de_t(       de_rbox2( p, vec3( 7.5, -0.5, 13.5 ), vec3( 4.5, 1.05, 1.5 ) ),
-                              MAT_MOSS_TEX );  
-    de_t elem_p = de_t(       de_rbox2( p, vec3( 4.5, -0.5, 7.5 ), vec3( 1.5, 1.05, 1.5 ) ),
-                              MAT_MOSS_TEX );                                                                                               
-    de_t elem_r = de_t(       de_rbox2( p, vec3( 10.5, -0.5, 31.5 ), vec3( 1.5, 1.05, 1.5 ) ),
-                              MAT_MOSS_TEX );
-    de_t elem_s = de_t(       de_rbox2( p, vec3( 10.5, -0.5, 6.0 ), vec3( 1.5, 1.05, 3.0 ) ),
-                              MAT_MOSS_TEX );
-
-    de_t house = de_t(        de_box( p, vec3( 7.5, -0.5, 21.0 ), vec3( 4.5, 3.05, 3.0 ) ),
-                              MAT_TEX1_3D );    
-    de_t house_exit = de_t(        de_box( p, vec3( 7.5, 0.65, 17.5 ), vec3( 1.5, 1.5, 1.5 ) ),
-                                   MAT_OBSIDIAN );        
-
-    de = de_union( barrier_north, de );
-    de = de_union( barrier_south, de );
-    de = de_union( barrier_east, de );
-    de = de_union( barrier_west, de );
-
-    de = de_union( elem_a, de );
-    de = de_union( elem_b, de );
-    de = de_union( elem_c, de );
-    de = de_union( elem_d, de );
-    de = de_union( elem_e, de );
-    de = de_union( elem_f, de );
-    de = de_union( elem_g, de );
-    de = de_union( elem_h, de );
-    de = de_union( elem_i, de );
-    de = de_union( elem_j, de );
-    de = de_union( elem_k, de );
-    de = de_union( elem_l, de );
-    de = de_union( elem_m, de );
-    de = de_union( elem_n, de );
-    de = de_union( elem_o, de );
-    de = de_union( elem_p, de );
-    de = de_union( elem_r, de );
-    de = de_union( elem_s, de );
-
-    de = de_union( house, de );
-    de = de_carve( house_exit, de );
-
-    de_t moss;    
-
-    float bb = 0.0;
-
-    bb = de_sphere( p, _packy_pos, 1.5 );
-  
-    if( bb < de.dist ) {
-        vec3 q = rotate_y( p - _packy_pos, _packy_angles.y );
-        de_t obj_packy = packy( q );
-        de = de_union( obj_packy, de );
-    }
-
-    bb = de_sphere( p, _gogu_pos, 1.5 );
-
-    if( bb < de.dist ) {
-        vec3 q = rotate_y( p - _gogu_pos, _gogu_angles.y );
-        de_t obj_gogu = gogu( q );
-        de = de_union( obj_gogu, de );
-    }
-
-    /*vec3 q = p;
-    q.x = mod( q.x, 3.0 ) - 1.5;
-    q.z = mod( q.z, 3.0 ) - 1.5;
-    de_t pebble = de_t( cluster( q ),
-                        MAT_GOLD );
-
-    bb = de_box( p, vec3( 19.5, -0.5, 19.5 ), vec3( 19.5, 1.5, 19.5 ) );
-    if( pebble.dist > bb) {
-        de = de_union( pebble, de );
-    }*/
-
-    return de;
+/*scene objects and the scene generated from the .scene file, with materials, for hit points*/
+#define DE                  de_t
+#define DE_MAKE( d, m )     de_t( d, m )
+#define DE_DIST( de )       ( de ).dist
+#define DE_FN( name )       name
+#include "objects.glsl"
+#include <scene>
+#undef DE
+#undef DE_MAKE
+#undef DE_DIST
+#undef DE_FN
+
+/*the same objects without materials, for marching, normals, shadows and occlusion*/
+#define DE                  float
+#define DE_MAKE( d, m )     ( d )
+#define DE_DIST( de )       ( de )
+#define DE_FN( name )       name##_dist
+#if defined( SCENE_BAKE ) && defined( _BAKE_VOLUME )
+#define DE_BAKED
+#endif
+#include "objects.glsl"
+#include <scene>
+#undef DE
+#undef DE_MAKE
+#undef DE_DIST
+#undef DE_FN
+#undef DE_BAKED
+
+/*scene_march() is the lower bound trace() and cone_trace() step by, the exact distance without a bake*/
+#if !( defined( SCENE_BAKE ) && defined( _BAKE_VOLUME ) )
+float 
+scene_march( const in vec3 p )
+{
+    return scene_dist( p );
 }
-
 #endif
 
 /*---------------------------------------------------------------------------*/
@@ -939,149 +833,119 @@ normal( const in vec3 p )
     vec3 offset = vec3( NEPSILON, 0.0, 0.0 );
     vec3 n;
 
-    n.x = scene( p+offset.xyy ).dist - scene( p-offset.xyy ).dist;
-    n.y = scene( p+offset.yxy ).dist - scene( p-offset.yxy ).dist;
-    n.z = scene( p+offset.yyx ).dist - scene( p-offset.yyx ).dist;
+    n.x = scene_dist( p+offset.xyy ) - scene_dist( p-offset.xyy );
+    n.y = scene_dist( p+offset.yxy ) - scene_dist( p-offset.yxy );
+    n.z = scene_dist( p+offset.yyx ) - scene_dist( p-offset.yyx );
 
     return normalize( n );
 }
 
 /*---------------------------------------------------------------------------*/
 point_t 
-trace( const in vec3 ro, const in vec3 rd, const in float maxd )
+trace( const in vec3 ro, const in vec3 rd, const in float mind, const in float maxd )
 {
     point_t px;
 
     int     i = 0;
-    de_t    de = de_t( 0.0, MAT_SKY );
+    int     fallback = 0;
+    float   d = 0.0;
+    float   omega = _omega;
+    float   step = 0.0;
+    float   prevd = 0.0;
+    bool    fail;
 
     px.mat = MAT_SKY;
-    px.dist = EPSILON * 2.0;
-
+    px.dist = mind;
+
+    /*
+        over relaxed steps of omega * dist (Keinert et al., enhanced sphere tracing),
+        when the spheres of the last two points do not overlap the step may have
+        skipped a surface, so it is pulled back into the previous sphere and the
+        rest of the ray is marched plainly
+    */
     for( i=0; i<MAX_STEPS; i++ ) {
         px.pos = ro + rd * px.dist;
-        de = scene( px.pos );
-        px.mat = de.mat;
-        if( ( abs( de.dist ) < EPSILON ) || ( px.dist > maxd ) || ( i > MAX_STEPS ) ) {
-            break;
-        }        
-        px.dist += de.dist;
+        d = scene_march( px.pos );
+
+        fail = omega > 1.0 && ( abs( d ) + prevd ) < step;
+
+        if( fail ) {
+            step -= omega * step;
+            omega = 1.0;
+            fallback++;
+        }
+        else {
+            if( ( abs( d ) < EPSILON ) || ( px.dist > maxd ) ) {
+                break;
+            }
+            step = d * omega;
+        }
+
+        prevd = abs( d );
+
+#if defined( SCENE_BAKE ) && defined( _BAKE_VOLUME )
+        /*far from the baked surfaces a coarse cell of the pyramid can be crossed at once*/
+        if( !fail ) {
+            float skip = min( bake_skip( px.pos, rd, step ), scene_rest( px.pos ) );
+
+            /*the whole way there is clear, so the next sphere need not overlap this one*/
+            if( skip > step ) {
+                step = skip;
+                prevd = skip;
+            }
+        }
+#endif
+
+        px.dist += step;
     }
 
+    /*the material only matters where the march ended*/
     if( px.dist > maxd ) {
         px.mat = MAT_SKY;
         px.dist = maxd;
     }
+    else {
+        px.mat = scene( px.pos ).mat;
+    }
 
-#ifdef _ENABLE_DEBUG    
+#ifdef _DEBUG    
     px.iter = float( i )/float( MAX_STEPS );
+    px.fallback = float( fallback );
 #endif
 
     return px;
 }
 
 /*---------------------------------------------------------------------------*/
+/*
+    the row of the material table, textured ones are tinted by their layer, projected
+    on the three planes the normal faces or on xz alone; derivatives mean little after
+    the march, so the level comes from the size of a pixel dist away, stretched along
+    the surface as it turns away from the ray rd
+*/
 mat_t 
-object( const in vec3 p, const in vec3 n, const in float matid )
+object( const in vec3 p, const in vec3 n, const in vec3 rd, const in float matid, const in float dist )
 {
+    material_t m = _materials.m[int( matid )];
     mat_t mat;
 
-    if( matid == MAT_GREEN ) {
-        mat.albedo = vec3( 0.196078, 0.8, 0.196078 );
-        mat.gloss = 0.0;
-        mat.fr0 = 0.0;
-    }
+    mat.albedo = m.albedo.rgb;
+    mat.gloss = m.albedo.w;
+    mat.fr0 = m.surface.x;
 
-    if( matid == MAT_OBSIDIAN ) {
-        mat.albedo = vec3( 0.05, 0.05, 0.05 );
-        mat.gloss = 10.5;
-        mat.fr0 = 0.0;
-    }
-
-    if( matid == MAT_ALUMINIUM ) {
-        mat.albedo = vec3( 0.329412, 0.329412, 0.329412 );
-        mat.gloss = 1.5;
-        mat.fr0 = 1.0;
-    }    
+    if( m.surface.y >= 0.0 ) {
+        bool planar = m.surface.w > 0.0;
+        vec3 q = p * m.surface.z;
+        vec3 w = planar ? vec3( 0.0, 1.0, 0.0 ) : abs( n );
+        float lod = log2( dist * PIXEL_K * m.surface.z * float( textureSize( _textures, 0 ).x ) / max( abs( dot( n, rd ) ), TEX_GRAZING ) );
 
-    if( matid == MAT_PEARL ) {
-        mat.albedo = vec3( 0.95, 0.95, 0.95 );
-        mat.gloss = 1.5;
-        mat.fr0 = 0.0;
-    }
-
-    if( matid == MAT_GOLD ) {
-        mat.albedo = vec3( 0.85, 0.45, 0.0 );
-        mat.gloss = 5.0;
-        mat.fr0 = 0.3;
-    }
-
-    if( matid == MAT_RED ) {
-        mat.albedo = vec3( 0.9, 0.2, 0.2 );
-        mat.gloss = 0.0;
-        mat.fr0 = 0.0;
-    }    
-
-    if( matid == MAT_BLUE ) {
-        mat.albedo = vec3( 0.05, 0.05, 0.95 );
-        mat.gloss = 10.5;
-        mat.fr0 = 0.0;
-    }    
-
-    if( matid == MAT_FLESH ) {
-        mat.albedo = vec3( 0.9, 0.1, 0.1 );
-        mat.gloss = 1.0;
-        mat.fr0 = 0.5;
-    }    
-
-    if( matid == MAT_TEX2_2D ){
-        mat.albedo = texture2D( _tex2, p.xz * 0.10 ).xyz;
-        mat.gloss = 0.0;
-        mat.fr0 = 0.0;        
-    }    
-
-    if( matid == MAT_TEX1_3D ){
-        mat.albedo = texture3D( _tex1, p, n, 0.45 );
-        mat.gloss = 0.0;
-        mat.fr0 = 0.0;        
-    }
-
-    if( matid == MAT_TEX2_3D ){
-        mat.albedo = texture3D( _tex2, p, n, 0.2 );
-        mat.gloss = 0.0;
-        mat.fr0 = 0.0;        
-    }
+        vec3 x = textureLod( _textures, vec3( q.yz, m.surface.y ), lod ).xyz;
+        vec3 y = textureLod( _textures, vec3( planar ? q.xz : q.zx, m.surface.y ), lod ).xyz;
+        vec3 z = textureLod( _textures, vec3( q.xy, m.surface.y ), lod ).xyz;
 
-    if( matid == MAT_OCEAN ) {
-        mat.albedo = vec3( 0.0, 0.05, 0.05 );
-        mat.gloss = 1.0;
-        mat.fr0 = 0.2;
-    } 
-
-	if ( matid == MAT_EMERALD ) {
-		mat.albedo = vec3( 0.07568, 0.61424, 0.07568 );
-		mat.gloss = 0.6;
-		mat.fr0 = 0.2;
-	}
-
-    if( matid == MAT_MOSS ) {
-        mat.albedo = vec3( 0.15, 0.35, 0.15 );
-        mat.gloss = 0.025;
-        mat.fr0 = 0.0;
-    }     
-
-    if( matid == MAT_MOSS_TEX ) {
-        mat.albedo = texture3D( _tex3, p, n, 0.2 );
-        mat.gloss = 0.025;
-        mat.fr0 = 0.0;
+        mat.albedo *= x*w.x + y*w.y + z*w.z;
     }
 
-    if( matid == MAT_FLOOR_TEX ){
-        mat.albedo = texture2D( _tex2, p.xz * 0.2 ).xyz;
-        mat.gloss = 0.0;
-        mat.fr0 = 0.0;        
-    }    
-
     return mat;
 }
 
@@ -1117,17 +981,17 @@ fog( const in vec3 rgb, const in float dist )
 float 
 vis( const in vec3 ro, const in vec3 rd, const in float maxd )
 {
-    de_t    de = de_t( 0.0, MAT_SKY );
+    float   de = 0.0;
     float   d = VIS_START;
     float   visf = 1.0f;
 
     for( int i=0; i<VIS_STEPS; i++ ) {
         if( d < maxd ) {
             vec3 p = ro + rd * d;
-            de = scene( p );
-            //if(de.dist < EPSILON) return 0.0;
-            visf = min( visf, VIS_SS * de.dist/d );
-            d += de.dist;
+            de = scene_dist( p );
+            //if(de < EPSILON) return 0.0;
+            visf = min( visf, VIS_SS * de/d );
+            d += de;
         }
     }
 
@@ -1140,14 +1004,14 @@ occ( const in vec3 ro, const in vec3 rd )
 {
     float   occf = 1.0;
     float   occt = 0.0;
-    de_t    de = de_t( 0.0, MAT_SKY );
+    float   de = 0.0;
     float   d = 0.0;
     
     for( int i=0; i<OCC_STEPS; i++ ) {
         d = float( i ) * 0.05 + EPSILON;
         vec3 p = ro + rd * d;
-        de = scene( p );
-        occt += -( de.dist - d ) * occf;
+        de = scene_dist( p );
+        occt += -( de - d ) * occf;
         occf *= 0.75;
     }
 
@@ -1174,8 +1038,9 @@ blinnphong_spec( const in vec3 rd, const in vec3 n, const in vec3 l, const in fl
 }
 
 /*---------------------------------------------------------------------------*/
+/*sh and ao come from vis() and occ(), the deferred path computes them at lower resolution*/
 vec3 
-shade( const in point_t px, const in mat_t mat )
+shade( const in point_t px, const in mat_t mat, const in float sh, const in float ao )
 {
     vec3 p = px.pos;
     vec3 n = px.nor;
@@ -1185,10 +1050,8 @@ shade( const in point_t px, const in mat_t mat )
     float ks = mat.gloss;
     float kfr = mat.fr0;
     
-	float ao = occ( px.pos, px.nor );
     float amb = clamp( 0.5+0.5*n.y, 0.0, 1.0 );
     float dif = lambert_diffuse( n, SUN );
-	float sh = vis( px.pos, SUN, VIEW_DIST );
     
     vec3 brdf = vec3( 0.0 );
     brdf += 0.20*amb*HOR_COL*ao;
@@ -1221,17 +1084,14 @@ render( const in vec3 ro, const in vec3 rd )
     mat_t   mat;
     vec3    rgb = vec3( 1.0 );
     
-    px = trace( ro, rd, VIEW_DIST );
-
-#ifdef _ENABLE_DEBUG
-    if( _debug == 1 ) {
-        return vec3( px.iter, 0.0, 0.0 );
-    }
-
-    if( _debug == 3 ) {
-        float ndist = clamp( px.dist / VIEW_DIST, 0.0, 1.0 );
-        return vec3( ndist );
-    }
+    px = trace( ro, rd, EPSILON * 2.0, VIEW_DIST );
+
+#if defined( _DEBUG_ITERATIONS )
+    /*iterations in red, green where over relaxation fell back*/
+    return vec3( px.iter, px.fallback * 0.25, 0.0 );
+#elif defined( _DEBUG_DEPTH )
+    float ndist = clamp( px.dist / VIEW_DIST, 0.0, 1.0 );
+    return vec3( ndist );
 #endif
 
     if( px.mat < 0.0 ) {
@@ -1241,14 +1101,12 @@ render( const in vec3 ro, const in vec3 rd )
     px.nor = normal( px.pos );
     px.rd  = rd;
     
-#ifdef _ENABLE_DEBUG
-    if( _debug == 2 ) {
-        return px.nor;
-    }
+#ifdef _DEBUG_NORMALS
+    return px.nor;
 #endif
 
-    mat = object( px.pos, px.nor, px.mat );
-    rgb = shade( px, mat );
+    mat = object( px.pos, px.nor, px.rd, px.mat, px.dist );
+    rgb = shade( px, mat, vis( px.pos, SUN, VIEW_DIST ), occ( px.pos, px.nor ) );
 
 #ifdef _FOG    
     rgb = fog( rgb, px.dist );
@@ -1259,14 +1117,9 @@ render( const in vec3 ro, const in vec3 rd )
 
 /*---------------------------------------------------------------------------*/
 void 
-main( void )
-{  
-    color = vec4( 0.0 );
-
-    vec3 rgb    = vec3( 0.0 );
-    vec3 ro     = vec3( 0.0 );
-    vec3 rd     = vec3( 0.0 );  
-    vec2 uv     = uv_setup( gl_FragCoord.xy );
+camera( const in vec2 frag, out vec3 ro, out vec3 rd )
+{
+    vec2 uv = uv_setup( frag );
 
 #ifdef _ENABLE_FIXED_CAMERA    
     ro = vec3( 0.0, 0.0, -5.0 );
@@ -1286,9 +1139,405 @@ main( void )
 
     SUN = vec3( sin( time8 ), 0.45, cos( time8 ) );
     SUN = normalize( SUN );
+}
+
+/*---------------------------------------------------------------------------*/
+/*
+    k is the cone radius per unit of distance. Steps stay inside the empty sphere
+    around the axis, the march ends where the scene comes closer than the cone radius.
+    Only the stretch from t0 to t1 is marched, VIEW_DIST means it is empty and no
+    pixel of the tile can hit anything there
+*/
+float 
+cone_trace( const in vec3 ro, const in vec3 rd, const in float k, const in float t0, const in float t1 )
+{
+    float t = t0;
+    float d;
+
+    for( int i=0; i<CONE_STEPS; i++ ) {
+        d = scene_march( ro + rd * t );
+
+        if( d < k * t ) {
+            return t;
+        }
+
+        t += ( d - k * t ) / ( 1.0 + k );
+
+        if( t > t1 ) {
+            return VIEW_DIST;
+        }
+    }
+
+    return t;
+}
+
+#if defined( _PASS_GBUFFER ) || defined( _PASS_COMPUTE )
+/*---------------------------------------------------------------------------*/
+/*previous camera, false behind it or outside the previous frame*/
+bool 
+prev_project( const in vec3 p, out vec2 frag )
+{
+    vec3  v = p - _camera.prev_pos.xyz;
+    float z = dot( v, _camera.prev_dir.xyz );
+    vec2  uv;
+
+    if( z <= 0.0 ) {
+        return false;
+    }
+
+    uv.x = FOV * dot( v, _camera.prev_right.xyz ) / z;
+    uv.y = FOV * dot( v, _camera.prev_up.xyz ) / z;
+    uv.x /= _prev_resolution.x / _prev_resolution.y;
+
+    frag = ( uv * 0.5 + 0.5 ) * _prev_resolution.xy;
+
+    return all( greaterThanEqual( frag, vec2( 0.0 ) ) ) && all( lessThan( frag, _prev_resolution.xy ) );
+}
+
+vec3 
+prev_ray( const in vec2 frag )
+{
+    vec2 uv = ( frag / _prev_resolution.xy ) * 2.0 - 1.0;
+    uv.x *= _prev_resolution.x / _prev_resolution.y;
+
+    return normalize( FOV * _camera.prev_dir.xyz + uv.x*_camera.prev_right.xyz + uv.y*_camera.prev_up.xyz );
+}
+
+/*
+    distance along rd to the surface seen last frame, negative when there is none:
+    walks t -> previous pixel -> previous hit -> t until it settles, then rejects hits
+    further than a few pixels off the ray, those belong to a surface that was disoccluded
+*/
+float 
+reproject( const in vec2 pixel, const in vec3 ro, const in vec3 rd )
+{
+    vec2  frag = pixel * _prev_resolution.xy / _resolution.xy;
+    vec4  prev;
+    vec3  q;
+    float t = 0.0;
+    float footprint;
+
+    for( int i=0; i<REPROJ_ITER; i++ ) {
+        if( i > 0 && !prev_project( ro + rd * t, frag ) ) {
+            return -1.0;
+        }
+
+        frag = floor( frag ) + 0.5;
+        prev = texelFetch( _history, ivec2( frag ), 0 );
+
+        if( prev.y < 0.0 ) {
+            return -1.0;
+        }
+
+        q = _camera.prev_pos.xyz + prev_ray( frag ) * prev.x;
+        t = dot( q - ro, rd );
+
+        if( t <= 0.0 ) {
+            return -1.0;
+        }
+    }
+
+    footprint = t * REPROJ_PIXELS * 2.0 / ( FOV * _prev_resolution.y );
+    if( length( q - ( ro + rd * t ) ) > footprint ) {
+        return -1.0;
+    }
+
+    return t;
+}
+
+/*---------------------------------------------------------------------------*/
+/*
+    primary hit of one pixel, start is the cone distance of its tile, sky when
+    the cone got out of the scene. true marks pixels left for the light pass,
+    everything else is final in c
+*/
+bool 
+primary( const in vec2 frag, const in float start_cone, out vec4 c, out vec4 g0, out vec4 g1 )
+{
+    point_t px;
+    vec3 ro, rd;
+    float start = max( EPSILON * 2.0, start_cone );
+    bool  sky = start >= VIEW_DIST;
+
+    camera( frag, ro, rd );
+
+#ifndef _ENABLE_FIXED_CAMERA
+    /*a rotating 1 in REPROJ_REFRESH pixels marches from the camera, so surfaces
+      that moved in front of the reprojected one can not hide for long*/
+    ivec2 cell = ivec2( frag );
+    bool refresh = ( ( cell.x + cell.y * 3 + _frame ) % REPROJ_REFRESH ) == 0;
+
+    if( _reproject != 0 && !refresh && !sky ) {
+        float t = reproject( frag, ro, rd ) * ( 1.0 - REPROJ_BACKOFF );
+
+        /*landing inside something means the ray skipped a surface, march it all*/
+        if( t > start && scene_dist( ro + rd * t ) > 0.0 ) {
+            start = t;
+        }
+    }
+#endif
+
+    if( sky ) {
+        px.mat = MAT_SKY;
+        px.dist = VIEW_DIST;
+        px.pos = ro + rd * VIEW_DIST;
+#ifdef _DEBUG
+        px.iter = 0.0;
+        px.fallback = 0.0;
+#endif
+    }
+    else {
+        px = trace( ro, rd, start, VIEW_DIST );
+    }
+
+    c = vec4( 0.0 );
+    g0 = vec4( px.dist, px.mat, 0.0, 0.0 );
+    g1 = vec4( 0.0 );
+
+#ifdef _DEBUG
+    g0.z = px.iter;
+#endif
+
+#if defined( _DEBUG_ITERATIONS )
+    /*iterations in red, green where over relaxation fell back*/
+    c = vec4( postprocess( vec3( px.iter, px.fallback * 0.25, 0.0 ) ), 1.0 );
+    return false;
+#elif defined( _DEBUG_DEPTH )
+    c = vec4( postprocess( vec3( clamp( px.dist / VIEW_DIST, 0.0, 1.0 ) ) ), 1.0 );
+    return false;
+#endif
+
+    if( px.mat < 0.0 ) {
+        c = vec4( postprocess( background( px.pos, rd ) ), 1.0 );
+        return false;
+    }
+
+    px.nor = normal( px.pos );
+    g1 = vec4( px.nor, 0.0 );
+
+#ifdef _DEBUG_NORMALS
+    c = vec4( postprocess( px.nor ), 1.0 );
+    return false;
+#endif
+
+    g1.w = 1.0;
+
+    return true;
+}
+
+#endif
+
+#if defined( _PASS_CONE )
+/*---------------------------------------------------------------------------*/
+void 
+main( void )
+{
+    vec3 ro, rd;
+
+    /*pixel rays of the tile fan out from its center by half a tile diagonal*/
+    vec2  center = floor( gl_FragCoord.xy ) * float( CONE_TILE ) + float( CONE_TILE ) * 0.5;
+
+    camera( center, ro, rd );
+
+    color = vec4( cone_trace( ro, rd, CONE_K, EPSILON * 2.0, VIEW_DIST ) );
+}
+
+#elif defined( _PASS_GBUFFER )
+/*---------------------------------------------------------------------------*/
+/*depth 0 marks pixels left for the light pass*/
+void 
+main( void )
+{
+    float start = 0.0;
+
+    if( _cone_prepass != 0 ) {
+        start = texelFetch( _cone, ivec2( gl_FragCoord.xy ) / CONE_TILE, 0 ).x;
+    }
+
+    gl_FragDepth = primary( gl_FragCoord.xy, start, color, gbuffer0, gbuffer1 ) ? 0.0 : 1.0;
+}
+
+#elif defined( _PASS_COMPUTE )
+/*---------------------------------------------------------------------------*/
+/*
+    the gbuffer pass as one work group per cone tile. The tile cone is cut into one
+    stretch per invocation, spaced geometrically like the steps that march them, and
+    every invocation marches its own. The closest stop is where the cone is first
+    blocked, since all stretches before it are empty, and every pixel starts there
+*/
+layout( local_size_x = 8, local_size_y = 8 ) in;
+
+const int   CONE_SPANS = CONE_TILE * CONE_TILE;
+
+shared uint tile_start;
+
+void 
+main( void )
+{
+    vec3  ro, rd;
+    vec4  c, g0, g1;
+    ivec2 pixel = ivec2( gl_GlobalInvocationID.xy );
+    float t0, t1, start;
+
+    if( gl_LocalInvocationIndex == 0 ) {
+        tile_start = floatBitsToUint( _cone_prepass != 0 ? VIEW_DIST : 0.0 );
+    }
+
+    memoryBarrierShared();
+    barrier();
+
+    if( _cone_prepass != 0 ) {
+        t0 = EPSILON * 2.0 * pow( VIEW_DIST / ( EPSILON * 2.0 ), float( gl_LocalInvocationIndex ) / float( CONE_SPANS ) );
+        t1 = EPSILON * 2.0 * pow( VIEW_DIST / ( EPSILON * 2.0 ), float( gl_LocalInvocationIndex + 1 ) / float( CONE_SPANS ) );
+
+        camera( vec2( gl_WorkGroupID.xy ) * float( CONE_TILE ) + float( CONE_TILE ) * 0.5, ro, rd );
+
+        /*positive floats order like their bits*/
+        atomicMin( tile_start, floatBitsToUint( cone_trace( ro, rd, CONE_K, t0, t1 ) ) );
+    }
+
+    memoryBarrierShared();
+    barrier();
+
+    start = uintBitsToFloat( tile_start );
+
+    if( any( greaterThanEqual( pixel, ivec2( _resolution.xy ) ) ) ) {
+        return;
+    }
+
+    primary( vec2( pixel ) + 0.5, start, c, g0, g1 );
+
+    imageStore( _color_image, pixel, c );
+    imageStore( _gbuffer0_image, pixel, g0 );
+    imageStore( _gbuffer1_image, pixel, g1 );
+}
+
+#elif defined( _PASS_SHADOW )
+/*---------------------------------------------------------------------------*/
+/*each texel shades the lower left pixel of its block, the light pass knows which one*/
+void 
+main( void )
+{
+    vec3 ro, rd, pos, nor;
+
+    ivec2 texel = min( ivec2( gl_FragCoord.xy ) * _shadow_scale, ivec2( _resolution.xy ) - 1 );
+    vec4  g0 = texelFetch( _gbuffer0, texel, 0 );
+
+    nor = texelFetch( _gbuffer1, texel, 0 ).xyz;
+
+    /*sky and debug views have no normal*/
+    if( g0.y < 0.0 || dot( nor, nor ) < 0.5 ) {
+        color = vec4( 1.0 );
+        return;
+    }
+
+    camera( vec2( texel ) + 0.5, ro, rd );
+    pos = ro + rd * g0.x;
+
+    color = vec4( vis( pos, SUN, VIEW_DIST ), occ( pos, nor ), 0.0, 0.0 );
+}
+
+#elif defined( _PASS_LIGHT )
+/*---------------------------------------------------------------------------*/
+/*
+    joint bilateral upsample of the shadow pass, the four nearest low resolution
+    texels are weighted by how close their gbuffer distance and normal are to this
+    pixel, at edges where none of them belong to the surface, the terms are traced here
+*/
+void 
+shadow_upsample( const in point_t px, out float sh, out float ao )
+{
+    ivec2 size = ( ivec2( _resolution.xy ) + _shadow_scale - 1 ) / _shadow_scale;
+    vec2  uv = vec2( ivec2( gl_FragCoord.xy ) ) / float( _shadow_scale );
+    ivec2 base = ivec2( floor( uv ) );
+    vec2  f = fract( uv );
+    vec2  acc = vec2( 0.0 );
+    float wsum = 0.0;
+
+    for( int i=0; i<4; i++ ) {
+        ivec2 offset = ivec2( i & 1, i >> 1 );
+        ivec2 tap = min( base + offset, size - 1 );
+        ivec2 texel = min( tap * _shadow_scale, ivec2( _resolution.xy ) - 1 );
+
+        float dist = texelFetch( _gbuffer0, texel, 0 ).x;
+        vec3  nor = texelFetch( _gbuffer1, texel, 0 ).xyz;
+
+        vec2  b = mix( 1.0 - f, f, vec2( offset ) );
+        float w = b.x * b.y + 1e-3;
+        w *= exp( -abs( dist - px.dist ) / ( 0.02 * px.dist + EPSILON ) );
+        w *= pow( max( dot( nor, px.nor ), 0.0 ), 8.0 );
+
+        acc += texelFetch( _shadow, tap, 0 ).xy * w;
+        wsum += w;
+    }
+
+    if( wsum < 1e-4 ) {
+        sh = vis( px.pos, SUN, VIEW_DIST );
+        ao = occ( px.pos, px.nor );
+    }
+    else {
+        sh = acc.x / wsum;
+        ao = acc.y / wsum;
+    }
+}
+
+void 
+main( void )
+{
+    point_t px;
+    mat_t   mat;
+    vec3    rgb, ro, rd;
+    float   sh, ao;
+
+    ivec2 texel = ivec2( gl_FragCoord.xy );
+    vec4  g0 = texelFetch( _gbuffer0, texel, 0 );
+    vec4  g1 = texelFetch( _gbuffer1, texel, 0 );
+
+    /*the compute path writes no depth, so sky and debug pixels get here too*/
+    if( g1.w == 0.0 ) {
+        discard;
+    }
+
+    camera( gl_FragCoord.xy, ro, rd );
+
+    px.dist = g0.x;
+    px.mat  = g0.y;
+    px.pos  = ro + rd * px.dist;
+    px.nor  = g1.xyz;
+    px.rd   = rd;
+
+    if( _shadow_lowres != 0 ) {
+        shadow_upsample( px, sh, ao );
+    }
+    else {
+        sh = vis( px.pos, SUN, VIEW_DIST );
+        ao = occ( px.pos, px.nor );
+    }
+
+    mat = object( px.pos, px.nor, px.rd, px.mat, px.dist );
+    rgb = shade( px, mat, sh, ao );
+
+#ifdef _FOG    
+    rgb = fog( rgb, px.dist );
+#endif  
+
+    color = vec4( postprocess( rgb ), 1.0 );
+}
+
+#else
+/*---------------------------------------------------------------------------*/
+void 
+main( void )
+{  
+    vec3 rgb    = vec3( 0.0 );
+    vec3 ro     = vec3( 0.0 );
+    vec3 rd     = vec3( 0.0 );  
+
+    camera( gl_FragCoord.xy, ro, rd );
     
     rgb = render( ro, rd );
     rgb = postprocess( rgb );
 
     color = vec4( rgb, 1.0 );
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,138 @@
+/*
+    library objects for .scene files, included twice by frag.glsl before the
+    generated scene, each one only compiles when the scene uses it:
+    DE              de_t, or float for the distance only variant
+    DE_MAKE( d, m ) builds a DE from a distance and a material
+    DE_DIST( de )   the distance of a DE, assignable
+    DE_FN( name )   function name, suffixed with _dist for the distance only variant
+
+    de_union, de_intersect, de_carve and de_smooth have float overloads, so both
+    variants share the same code and the material selects compile away in the float one
+*/
+
+/*---------------------------------------------------------------------------*/
+#ifdef SCENE_PACKY
+DE 
+DE_FN( packy )( const in vec3 p )
+{
+    DE de = DE_MAKE( length( p ) - 1.0, MAT_GREEN );
+
+    vec3 q = p - vec3( 1.25 + sinpacky, -0.55, 0.0 );
+    q = rotate_z( q, 0.87 );
+
+    DE mouth = DE_MAKE(  de_prism( q, vec2( 0.5, 1.25 ), vec3( 0.50, 0.25, 1.0 ) ), 
+                        MAT_FLESH );
+    de = de_carve( mouth, de);
+
+    DE eye = DE_MAKE(    de_sphere( p, vec3( 0.65, 0.65, 0.35 ), 0.08 ), 
+                        MAT_OBSIDIAN );
+    de = de_union( eye, de);
+
+    eye = DE_MAKE(    de_sphere( p, vec3( 0.65, 0.65,-0.35 ), 0.08 ), 
+                   MAT_OBSIDIAN );
+    de = de_union( eye, de);
+
+    /* left arm */
+    float arm_1 = de_segment( p, vec3( 0.0,0.15,0.95 ), vec3( 0.05,0.0,1.25 ), 0.05 );
+    float arm_2 = de_segment( p, vec3( 0.05,0.0,1.25 ), vec3( 0.25,0.3,1.45 ), 0.05 );
+
+    DE arm = DE_MAKE(    smin( arm_1, arm_2, 0.05 ),
+                        MAT_GREEN );
+    de = de_union( arm, de);
+
+    /* right arm */
+    arm_1 = de_segment( p, vec3( 0.0,0.15,-0.95 ), vec3( 0.05,0.0,-1.25 ), 0.05 );
+    arm_2 = de_segment( p, vec3( 0.05,0.0,-1.25 ), vec3( 0.25,-0.3,-1.45 ), 0.05 );
+
+    arm = DE_MAKE(    smin( arm_1, arm_2, 0.05 ),
+                   MAT_GREEN );
+    de = de_union( arm, de);
+
+    return de;
+}
+#endif
+
+#ifdef SCENE_FACULT
+DE 
+DE_FN( facult )( const in vec3 p )
+{
+    DE de = DE_MAKE( de_box( p, vec3( 0.0, -0.75, 0.0 ), vec3( 0.05, 0.02, 0.40 ) ),
+                     MAT_OBSIDIAN );
+
+    float d1 = de_box( p, vec3( 0.0, -0.71, 0.0 ), vec3( 0.05, 0.02, 0.38 ) );
+
+    de = de_union( DE_MAKE( d1, MAT_ALUMINIUM ), de );
+
+    d1 = de_box( p, vec3( 0.0, -0.67, 0.0 ), vec3( 0.05, 0.02, 0.36 ) );
+
+    de = de_union( DE_MAKE( d1, MAT_OBSIDIAN ), de );
+
+    d1 = de_box( p, vec3( 0.0, -0.63, 0.0 ), vec3( 0.05, 0.04, 0.32 ) );
+
+    de = de_union( DE_MAKE( d1, MAT_PEARL ), de );
+
+    d1 = de_box( p, vec3( 0.0, -0.40, 0.26 ), vec3( 0.05, 0.20, 0.05 ) );
+
+    de = de_union( DE_MAKE( d1, MAT_ALUMINIUM ), de );
+
+    d1 = de_box( p, vec3( 0.0, -0.40, 0.13 ), vec3( 0.05, 0.20, 0.05 ) );
+
+    de = de_union( DE_MAKE( d1, MAT_ALUMINIUM ), de );
+
+    d1 = de_box( p, vec3( 0.0, -0.40, 0.00 ), vec3( 0.05, 0.20, 0.05 ) );
+
+    de = de_union( DE_MAKE( d1, MAT_ALUMINIUM ), de );
+
+    d1 = de_box( p, vec3( 0.0, -0.40, -0.13 ), vec3( 0.05, 0.20, 0.05 ) );
+
+    de = de_union( DE_MAKE( d1, MAT_ALUMINIUM ), de );
+
+    d1 = de_box( p, vec3( 0.0, -0.40, -0.26 ), vec3( 0.05, 0.20, 0.05 ) );
+
+    de = de_union( DE_MAKE( d1, MAT_ALUMINIUM ), de );
+
+    d1 = de_box( p, vec3( 0.0, -0.16, 0.0 ), vec3( 0.05, 0.04, 0.32 ) );
+
+    de = de_union( DE_MAKE( d1, MAT_OBSIDIAN ), de );
+
+    vec3 q = rotate_y( p, 1.57079633 );
+    q -= vec3( 0.0, -0.10, 0.0 );
+    d1 = de_prism( q, vec2( 0.05, 0.05 ), vec3( 0.14, 0.4, 2.5 ) );
+
+    de = de_union( DE_MAKE( d1, MAT_OBSIDIAN ), de );
+
+    return de;
+}
+#endif
+
+#ifdef SCENE_GOGU
+DE 
+DE_FN( gogu )( const in vec3 p )
+{
+    float sina = sinhalftime;
+    float cosa = coshalftime;
+      
+    float bump = 0.035*sin( 8.0*_time )*sin( 2.0*p.y )*sin( 16.0*p.z );
+    DE de = DE_MAKE( length( p ) - 1.15 + bump, MAT_FLESH );
+
+    float reye = length( p-vec3( 0.95,0.35,0.25 ) ) - 0.15;
+
+    de = de_union( DE_MAKE( reye, MAT_PEARL ), de );
+
+    reye = length( p-vec3( 1.05,0.38,0.25 ) ) - 0.05;
+
+    de = de_union( DE_MAKE( reye, MAT_BLUE ), de );
+
+    float leye = length( p-vec3( 0.95,0.35,-0.25 ) ) - 0.15;
+
+    de = de_union( DE_MAKE( leye, MAT_PEARL ), de );
+
+    leye = length( p-vec3( 1.05,0.38,-0.25 ) ) - 0.05;
+
+    de = de_union( DE_MAKE( leye, MAT_BLUE ), de );
+
+    DE_DIST( de ) = smin( DE_DIST( de ), de_sphere( p, vec3( 0.0, 0.25, 0.0 ), 1.15 ), 0.05 );
+
+    return de;
+}
+#endif
\ No newline at end of file
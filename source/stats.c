@@ -0,0 +1,338 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stats.h"
+
+/*queries of one frame, reused after STATS_LATENCY frames*/
+typedef struct
+{
+	GLuint			elapsed[STATS_STAGES];
+	GLuint			stamp[2];
+
+	double			cpu[STATS_STAGES];
+	double			cpu_frame;
+
+	unsigned int	used;
+	unsigned int	index;
+	bool			pending;
+} slot_t;
+
+static slot_t			slots[STATS_LATENCY];
+static bool				created = FALSE;
+static unsigned int		head = 0;
+static unsigned int		frame_count = 0;
+static unsigned int		dropped = 0;
+
+/*slot being recorded, NULL outside a frame or while the ring is full*/
+static slot_t			*current = NULL;
+static int				active = -1;
+static double			frame_start, stage_start;
+
+static stats_stage_t	stages[STATS_STAGES];
+static unsigned int		stage_count = 0;
+
+/*last collected frame, id 0 until the first one*/
+static unsigned int		frame_id = 0;
+static double			frame_cpu = 0.0;
+static double			frame_gpu = 0.0;
+
+static FILE				*csv = NULL;
+
+/*****************************************************************************/
+/*locals*/
+static bool 
+slot_ready( const slot_t *slot )
+{
+	GLuint			available;
+	unsigned int	i;
+
+	glGetQueryObjectuiv( slot->stamp[1], GL_QUERY_RESULT_AVAILABLE, &available );
+	if ( !available ) {
+		return FALSE;
+	}
+
+	for ( i = 0; i < stage_count; i++ ) {
+		if ( slot->used & ( 1 << i ) ) {
+			glGetQueryObjectuiv( slot->elapsed[i], GL_QUERY_RESULT_AVAILABLE, &available );
+			if ( !available ) {
+				return FALSE;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+static void 
+csv_row( const unsigned int index )
+{
+	unsigned int i;
+
+	fprintf( csv, "%u,%.4f,%.4f", index, frame_cpu, frame_gpu );
+	for ( i = 0; i < stage_count; i++ ) {
+		fprintf( csv, ",%.4f,%.4f", stages[i].cpu_ms, stages[i].gpu_ms );
+	}
+	fprintf( csv, "\n" );
+}
+
+/* publishes the slot if every query finished, never waits on the gpu */
+static bool 
+slot_collect( slot_t *slot )
+{
+	GLuint64		begin, end, elapsed;
+	unsigned int	i;
+
+	if ( !slot_ready( slot ) ) {
+		return FALSE;
+	}
+
+	for ( i = 0; i < stage_count; i++ ) {
+		stages[i].cpu_ms = 0.0;
+		stages[i].gpu_ms = 0.0;
+
+		if ( slot->used & ( 1 << i ) ) {
+			glGetQueryObjectui64v( slot->elapsed[i], GL_QUERY_RESULT, &elapsed );
+
+			stages[i].cpu_ms = slot->cpu[i];
+			stages[i].gpu_ms = (double)elapsed / 1000000.0;
+		}
+	}
+
+	glGetQueryObjectui64v( slot->stamp[0], GL_QUERY_RESULT, &begin );
+	glGetQueryObjectui64v( slot->stamp[1], GL_QUERY_RESULT, &end );
+
+	frame_id = slot->index + 1;
+	frame_cpu = slot->cpu_frame;
+	frame_gpu = (double)( end - begin ) / 1000000.0;
+
+	if ( csv != NULL ) {
+		csv_row( slot->index );
+	}
+
+	slot->pending = FALSE;
+
+	return TRUE;
+}
+
+/*oldest first so results are published in frame order*/
+static void 
+slots_poll( void )
+{
+	unsigned int i;
+	slot_t *slot;
+
+	for ( i = 0; i < STATS_LATENCY; i++ ) {
+		slot = &slots[( head + i ) % STATS_LATENCY];
+
+		if ( slot->pending && !slot_collect( slot ) ) {
+			break;
+		}
+	}
+}
+
+/*****************************************************************************/
+/*exports*/
+int 
+stats_stage( const char *name )
+{
+	unsigned int i;
+
+	for ( i = 0; i < stage_count; i++ ) {
+		if ( strcmp( stages[i].name, name ) == 0 ) {
+			return i;
+		}
+	}
+
+	if ( stage_count == STATS_STAGES ) {
+		return -1;
+	}
+
+	stages[stage_count].name = name;
+	stages[stage_count].cpu_ms = 0.0;
+	stages[stage_count].gpu_ms = 0.0;
+
+	return stage_count++;
+}
+
+void 
+stats_frame_begin( void )
+{
+	unsigned int i;
+	slot_t *slot;
+
+	if ( !created ) {
+		for ( i = 0; i < STATS_LATENCY; i++ ) {
+			glGenQueries( STATS_STAGES, slots[i].elapsed );
+			glGenQueries( 2, slots[i].stamp );
+			slots[i].pending = FALSE;
+		}
+
+		created = TRUE;
+	}
+
+	slot = &slots[head];
+
+	/*gpu is more than STATS_LATENCY frames behind, skip this one rather than stall*/
+	if ( slot->pending && !slot_collect( slot ) ) {
+		current = NULL;
+		dropped++;
+		return;
+	}
+
+	current = slot;
+	current->used = 0;
+	current->index = frame_count++;
+
+	glQueryCounter( current->stamp[0], GL_TIMESTAMP );
+	frame_start = glfwGetTime();
+}
+
+void 
+stats_frame_end( void )
+{
+	if ( current == NULL ) {
+		return;
+	}
+
+	if ( active >= 0 ) {
+		stats_end( active );
+	}
+
+	glQueryCounter( current->stamp[1], GL_TIMESTAMP );
+	current->cpu_frame = ( glfwGetTime() - frame_start ) * 1000.0;
+	current->pending = TRUE;
+	current = NULL;
+
+	head = ( head + 1 ) % STATS_LATENCY;
+
+	slots_poll();
+}
+
+void 
+stats_begin( const int stage )
+{
+	if ( current == NULL || stage < 0 || active >= 0 ) {
+		return;
+	}
+
+	glBeginQuery( GL_TIME_ELAPSED, current->elapsed[stage] );
+
+	active = stage;
+	stage_start = glfwGetTime();
+}
+
+void 
+stats_end( const int stage )
+{
+	if ( current == NULL || stage != active ) {
+		return;
+	}
+
+	glEndQuery( GL_TIME_ELAPSED );
+
+	current->cpu[stage] = ( glfwGetTime() - stage_start ) * 1000.0;
+	current->used |= 1 << stage;
+
+	active = -1;
+}
+
+void 
+stats_release( void )
+{
+	unsigned int i;
+
+	stats_csv_close();
+
+	if ( created ) {
+		for ( i = 0; i < STATS_LATENCY; i++ ) {
+			glDeleteQueries( STATS_STAGES, slots[i].elapsed );
+			glDeleteQueries( 2, slots[i].stamp );
+			slots[i].pending = FALSE;
+		}
+
+		created = FALSE;
+	}
+
+	if ( dropped > 0 ) {
+		fprintf( stderr, "stats: %u frames not measured, gpu more than %d frames behind\n", dropped, STATS_LATENCY );
+	}
+
+	current = NULL;
+	active = -1;
+	head = 0;
+	dropped = 0;
+}
+
+unsigned int 
+stats_count( void )
+{
+	return stage_count;
+}
+
+unsigned int 
+stats_frame_id( void )
+{
+	return frame_id;
+}
+
+const stats_stage_t* 
+stats_get( const int stage )
+{
+	if ( stage < 0 || stage >= (int)stage_count ) {
+		return NULL;
+	}
+
+	return &stages[stage];
+}
+
+double 
+stats_frame_cpu_ms( void )
+{
+	return frame_cpu;
+}
+
+double 
+stats_frame_gpu_ms( void )
+{
+	return frame_gpu;
+}
+
+int 
+stats_csv_open( const char *path )
+{
+	unsigned int i;
+
+	stats_csv_close();
+
+	fopen_s( &csv, path, "w" );
+	if ( csv == NULL ) {
+		fprintf( stderr, "stats: could not open \"%s\"\n", path );
+		return ERR;
+	}
+
+	fprintf( csv, "frame,frame_cpu_ms,frame_gpu_ms" );
+	for ( i = 0; i < stage_count; i++ ) {
+		fprintf( csv, ",%s_cpu_ms,%s_gpu_ms", stages[i].name, stages[i].name );
+	}
+	fprintf( csv, "\n" );
+
+	fprintf( stderr, "stats: writing \"%s\"\n", path );
+
+	return OK;
+}
+
+void 
+stats_csv_close( void )
+{
+	if ( csv != NULL ) {
+		fclose( csv );
+		csv = NULL;
+	}
+}
+
+bool 
+stats_csv_active( void )
+{
+	return csv != NULL;
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef __stats_h_
+#define __stats_h_
+
+#include "core.h"
+
+/*frames in flight before a query slot is reused, results lag this many frames behind*/
+#define STATS_LATENCY	4
+#define STATS_STAGES	8
+
+typedef struct
+{
+	const char	*name;
+	double		cpu_ms;
+	double		gpu_ms;
+} stats_stage_t;
+
+/* named stage, registered on first use; returns its index or -1 when the table is full */
+int		stats_stage( const char *name );
+
+/*
+	one frame_begin/frame_end pair per frame, stages inside must not nest and run once per frame
+	begin/end outside of a frame are ignored
+*/
+void	stats_frame_begin( void );
+void	stats_frame_end( void );
+void	stats_begin( const int stage );
+void	stats_end( const int stage );
+void	stats_release( void );
+
+/* latest frame whose queries completed */
+unsigned int			stats_count( void );
+unsigned int			stats_frame_id( void );
+const stats_stage_t*	stats_get( const int stage );
+double					stats_frame_cpu_ms( void );
+double					stats_frame_gpu_ms( void );
+
+/* one row per completed frame while open */
+int		stats_csv_open( const char *path );
+void	stats_csv_close( void );
+bool	stats_csv_active( void );
+
+#endif/*__stats_h_*/
\ No newline at end of file
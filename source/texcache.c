@@ -0,0 +1,543 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+	#include <direct.h>
+
+	#define make_dir( p )	_mkdir( p )
+#else
+	#include <sys/stat.h>
+
+	#define make_dir( p )	mkdir( p, 0755 )
+#endif/*_WIN32*/
+
+#include "texcache.h"
+
+/*bumped whenever the encoder or the file layout changes, so stale files are never read*/
+#define TEXCACHE_VERSION	1
+
+/*no texture is larger, the byte count of a whole chain this size still fits its unsigned int*/
+#define TEXCACHE_MAX_SIZE	16384
+
+#define FNV_OFFSET			14695981039346656037ULL
+#define FNV_PRIME			1099511628211ULL
+
+/*power iterations towards the principal axis of a block*/
+#define AXIS_ITERATIONS		4
+
+typedef struct
+{
+	char			magic[4];
+	unsigned int	version;
+	unsigned int	width;
+	unsigned int	height;
+	unsigned int	levels;
+	unsigned int	bytes;
+} header_t;
+
+unsigned int 
+texcache_level_bytes( const unsigned int format, const unsigned int width, const unsigned int height )
+{
+	if ( format == TEXCACHE_FORMAT_RGB ) {
+		return width * height * 3;
+	}
+
+	return ( ( width + 3 ) / 4 ) * ( ( height + 3 ) / 4 ) * 8;
+}
+
+static unsigned char* 
+file_read( const char *path, unsigned int *size )
+{
+	FILE			*file;
+	unsigned char	*data;
+
+	fopen_s( &file, path, "rb" );
+	if ( !file ) {
+		return NULL;
+	}
+
+	fseek( file, 0, SEEK_END );
+	*size = (unsigned int)ftell( file );
+	fseek( file, 0, SEEK_SET );
+
+	data = (unsigned char *)malloc( *size ? *size : 1 );
+	if ( data && fread( data, 1, *size, file ) != *size ) {
+		free( data );
+		data = NULL;
+	}
+
+	fclose( file );
+
+	return data;
+}
+
+static unsigned long long 
+fnv( unsigned long long hash, const unsigned char *data, const unsigned int size )
+{
+	unsigned int	i;
+
+	for ( i = 0; i < size; i++ ) {
+		hash = ( hash ^ data[i] ) * FNV_PRIME;
+	}
+
+	return hash;
+}
+
+/*img resized to width x height by nearest texels, freed; NULL when out of memory*/
+static unsigned char* 
+image_fit( unsigned char *img, const unsigned int w, const unsigned int h, const unsigned int width, const unsigned int height )
+{
+	unsigned char	*fit;
+	unsigned int	x, y;
+
+	fit = (unsigned char *)malloc( width * height * 3 );
+	if ( fit ) {
+		for ( y = 0; y < height; y++ ) {
+			for ( x = 0; x < width; x++ ) {
+				memcpy( fit + ( y * width + x ) * 3, img + ( ( y * h / height ) * w + x * w / width ) * 3, 3 );
+			}
+		}
+	}
+
+	free( img );
+
+	return fit;
+}
+
+/*next level of a mip chain in place, a box filter over 2x2 texels, odd edges repeat*/
+static void 
+image_half( unsigned char *img, const unsigned int w, const unsigned int h )
+{
+	const unsigned int	hw = w > 1 ? w / 2 : 1;
+	const unsigned int	hh = h > 1 ? h / 2 : 1;
+	unsigned int		x, y, c, x0, x1, y0, y1;
+
+	for ( y = 0; y < hh; y++ ) {
+		y0 = ( y * 2 < h ? y * 2 : h - 1 ) * w;
+		y1 = ( y * 2 + 1 < h ? y * 2 + 1 : h - 1 ) * w;
+
+		for ( x = 0; x < hw; x++ ) {
+			x0 = x * 2 < w ? x * 2 : w - 1;
+			x1 = x * 2 + 1 < w ? x * 2 + 1 : w - 1;
+
+			for ( c = 0; c < 3; c++ ) {
+				img[( y * hw + x ) * 3 + c] = (unsigned char)( ( img[( y0 + x0 ) * 3 + c] + img[( y0 + x1 ) * 3 + c] +
+					img[( y1 + x0 ) * 3 + c] + img[( y1 + x1 ) * 3 + c] + 2 ) / 4 );
+			}
+		}
+	}
+}
+
+static unsigned short 
+rgb565( const float rgb[3] )
+{
+	int		r, g, b;
+
+	r = (int)( rgb[0] * 31.0f / 255.0f + 0.5f );
+	g = (int)( rgb[1] * 63.0f / 255.0f + 0.5f );
+	b = (int)( rgb[2] * 31.0f / 255.0f + 0.5f );
+
+	r = r < 0 ? 0 : ( r > 31 ? 31 : r );
+	g = g < 0 ? 0 : ( g > 63 ? 63 : g );
+	b = b < 0 ? 0 : ( b > 31 ? 31 : b );
+
+	return (unsigned short)( ( r << 11 ) | ( g << 5 ) | b );
+}
+
+static void 
+rgb888( const unsigned short c, int rgb[3] )
+{
+	rgb[0] = ( ( c >> 11 ) & 31 ) << 3 | ( ( c >> 11 ) & 31 ) >> 2;
+	rgb[1] = ( ( c >> 5 ) & 63 ) << 2 | ( ( c >> 5 ) & 63 ) >> 4;
+	rgb[2] = ( c & 31 ) << 3 | ( c & 31 ) >> 2;
+}
+
+/*indices of the nearest palette color of c0, c1 for every texel, the squared error*/
+static unsigned int 
+bc1_indices( const unsigned char texels[16][3], const unsigned short c0, const unsigned short c1, unsigned int *indices )
+{
+	int				palette[4][3], e;
+	unsigned int	i, j, k, best, dist, least, error = 0;
+
+	rgb888( c0, palette[0] );
+	rgb888( c1, palette[1] );
+	for ( k = 0; k < 3; k++ ) {
+		palette[2][k] = ( palette[0][k] * 2 + palette[1][k] ) / 3;
+		palette[3][k] = ( palette[0][k] + palette[1][k] * 2 ) / 3;
+	}
+
+	*indices = 0;
+	for ( i = 0; i < 16; i++ ) {
+		best = 0;
+		least = ~0u;
+		for ( j = 0; j < 4; j++ ) {
+			dist = 0;
+			for ( k = 0; k < 3; k++ ) {
+				e = texels[i][k] - palette[j][k];
+				dist += e * e;
+			}
+			if ( dist < least ) {
+				least = dist;
+				best = j;
+			}
+		}
+		*indices |= best << ( i * 2 );
+		error += least;
+	}
+
+	return error;
+}
+
+/*endpoints that fit the texels best in the least squares sense for the given indices, FALSE when all share one*/
+static bool 
+bc1_refine( const unsigned char texels[16][3], const unsigned int indices, float hi[3], float lo[3] )
+{
+	static const float	weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+	float				aa = 0.0f, bb = 0.0f, ab = 0.0f, ax[3] = { 0.0f, 0.0f, 0.0f }, bx[3] = { 0.0f, 0.0f, 0.0f }, a, b, det;
+	unsigned int		i, k;
+
+	for ( i = 0; i < 16; i++ ) {
+		a = weights[( indices >> ( i * 2 ) ) & 3];
+		b = 1.0f - a;
+		aa += a * a;
+		bb += b * b;
+		ab += a * b;
+		for ( k = 0; k < 3; k++ ) {
+			ax[k] += a * texels[i][k];
+			bx[k] += b * texels[i][k];
+		}
+	}
+
+	det = aa * bb - ab * ab;
+	if ( det < 1e-6f ) {
+		return FALSE;
+	}
+
+	for ( k = 0; k < 3; k++ ) {
+		hi[k] = ( ax[k] * bb - bx[k] * ab ) / det;
+		lo[k] = ( bx[k] * aa - ax[k] * ab ) / det;
+	}
+
+	return TRUE;
+}
+
+/*c0 above c1 for the 4 color mode, equal ones select 3 colors where index 0 is still c0*/
+static void 
+bc1_order( unsigned short *c0, unsigned short *c1 )
+{
+	unsigned short	swap;
+
+	if ( *c0 < *c1 ) {
+		swap = *c0;
+		*c0 = *c1;
+		*c1 = swap;
+	}
+}
+
+/*
+	one BC1 block of 16 rgb texels: the endpoints start at the extremes of the texels along
+	their principal axis, then one least squares fit for the chosen indices is kept when it
+	lowers the error; every texel takes the nearest of the four palette colors
+*/
+static void 
+bc1_block( const unsigned char texels[16][3], unsigned char out[8] )
+{
+	float			mean[3] = { 0.0f, 0.0f, 0.0f };
+	float			cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+	float			axis[3], next[3], lo[3], hi[3], d[3], t, tmin, tmax, len, big;
+	unsigned short	c0, c1, r0, r1;
+	unsigned int	i, j, k, indices = 0, refined, error;
+
+	for ( i = 0; i < 16; i++ ) {
+		for ( k = 0; k < 3; k++ ) {
+			mean[k] += texels[i][k] / 16.0f;
+		}
+	}
+
+	for ( i = 0; i < 16; i++ ) {
+		for ( k = 0; k < 3; k++ ) {
+			d[k] = texels[i][k] - mean[k];
+		}
+		cov[0] += d[0] * d[0];
+		cov[1] += d[0] * d[1];
+		cov[2] += d[0] * d[2];
+		cov[3] += d[1] * d[1];
+		cov[4] += d[1] * d[2];
+		cov[5] += d[2] * d[2];
+	}
+
+	axis[0] = axis[1] = axis[2] = 1.0f;
+	for ( j = 0; j < AXIS_ITERATIONS; j++ ) {
+		next[0] = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+		next[1] = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+		next[2] = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+
+		big = 0.0f;
+		for ( k = 0; k < 3; k++ ) {
+			big = next[k] > big ? next[k] : ( -next[k] > big ? -next[k] : big );
+		}
+		if ( big < 1e-6f ) {
+			break;
+		}
+		for ( k = 0; k < 3; k++ ) {
+			axis[k] = next[k] / big;
+		}
+	}
+	len = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+
+	tmin = tmax = 0.0f;
+	for ( i = 0; i < 16; i++ ) {
+		t = ( texels[i][0] - mean[0] ) * axis[0] + ( texels[i][1] - mean[1] ) * axis[1] + ( texels[i][2] - mean[2] ) * axis[2];
+		tmin = t < tmin ? t : tmin;
+		tmax = t > tmax ? t : tmax;
+	}
+
+	for ( k = 0; k < 3; k++ ) {
+		hi[k] = mean[k] + axis[k] * tmax / len;
+		lo[k] = mean[k] + axis[k] * tmin / len;
+	}
+
+	c0 = rgb565( hi );
+	c1 = rgb565( lo );
+	bc1_order( &c0, &c1 );
+
+	if ( c0 != c1 ) {
+		error = bc1_indices( texels, c0, c1, &indices );
+
+		if ( bc1_refine( texels, indices, hi, lo ) ) {
+			r0 = rgb565( hi );
+			r1 = rgb565( lo );
+			bc1_order( &r0, &r1 );
+
+			if ( r0 != r1 && bc1_indices( texels, r0, r1, &refined ) < error ) {
+				c0 = r0;
+				c1 = r1;
+				indices = refined;
+			}
+		}
+	}
+
+	out[0] = (unsigned char)( c0 & 255 );
+	out[1] = (unsigned char)( c0 >> 8 );
+	out[2] = (unsigned char)( c1 & 255 );
+	out[3] = (unsigned char)( c1 >> 8 );
+	out[4] = (unsigned char)( indices & 255 );
+	out[5] = (unsigned char)( ( indices >> 8 ) & 255 );
+	out[6] = (unsigned char)( ( indices >> 16 ) & 255 );
+	out[7] = (unsigned char)( indices >> 24 );
+}
+
+/*a w x h level as BC1 blocks, texels past the edges of small levels repeat the last ones*/
+static void 
+bc1_level( const unsigned char *img, const unsigned int w, const unsigned int h, unsigned char *out )
+{
+	unsigned char	texels[16][3];
+	unsigned int	bx, by, x, y, sx, sy;
+
+	for ( by = 0; by < h; by += 4 ) {
+		for ( bx = 0; bx < w; bx += 4 ) {
+			for ( y = 0; y < 4; y++ ) {
+				sy = by + y < h ? by + y : h - 1;
+				for ( x = 0; x < 4; x++ ) {
+					sx = bx + x < w ? bx + x : w - 1;
+					memcpy( texels[y * 4 + x], img + ( sy * w + sx ) * 3, 3 );
+				}
+			}
+
+			bc1_block( (const unsigned char (*)[3])texels, out );
+			out += 8;
+		}
+	}
+}
+
+/* the number of levels down to 1x1 and the bytes of all of them */
+static unsigned int 
+chain_bytes( const unsigned int format, const unsigned int width, const unsigned int height, unsigned int *levels )
+{
+	unsigned int w = width, h = height, level, bytes = 0;
+
+	for ( *levels = 1; ( width | height ) >> *levels; ( *levels )++ );
+
+	for ( level = 0; level < *levels; level++ ) {
+		bytes += texcache_level_bytes( format, w > 1 ? w : 1, h > 1 ? h : 1 );
+		w >>= 1;
+		h >>= 1;
+	}
+
+	return bytes;
+}
+
+/*img, freed, as the blocks or the texels of every level of tex*/
+static int 
+transcode( unsigned char *img, texcache_t *tex )
+{
+	unsigned int	w, h, level;
+	unsigned char	*out;
+
+	tex->bytes = chain_bytes( tex->format, tex->width, tex->height, &tex->levels );
+
+	tex->blocks = (unsigned char *)malloc( tex->bytes );
+	if ( !tex->blocks ) {
+		free( img );
+		return ERR;
+	}
+
+	w = tex->width;
+	h = tex->height;
+	out = tex->blocks;
+	for ( level = 0; level < tex->levels; level++ ) {
+		if ( tex->format == TEXCACHE_FORMAT_RGB ) {
+			memcpy( out, img, w * h * 3 );
+		}
+		else {
+			bc1_level( img, w, h, out );
+		}
+		out += texcache_level_bytes( tex->format, w, h );
+
+		image_half( img, w, h );
+		w = w > 1 ? w / 2 : 1;
+		h = h > 1 ? h / 2 : 1;
+	}
+
+	free( img );
+
+	return OK;
+}
+
+/*
+	the header has to describe exactly the chain transcode() writes, uploads read every
+	level it promises; a file that does not, truncated or from another version, is deleted
+*/
+static int 
+cache_read( const char *path, texcache_t *tex )
+{
+	FILE			*file;
+	header_t		header;
+	unsigned int	levels;
+	bool			valid;
+
+	fopen_s( &file, path, "rb" );
+	if ( !file ) {
+		return ERR;
+	}
+
+	valid = fread( &header, sizeof(header), 1, file ) == 1 && memcmp( header.magic, "RDFT", 4 ) == 0 && header.version == TEXCACHE_VERSION &&
+		header.width > 0 && header.width <= TEXCACHE_MAX_SIZE && header.height > 0 && header.height <= TEXCACHE_MAX_SIZE &&
+		header.bytes == chain_bytes( TEXCACHE_FORMAT, header.width, header.height, &levels ) && header.levels == levels;
+
+	if ( valid ) {
+		tex->width = header.width;
+		tex->height = header.height;
+		tex->levels = header.levels;
+		tex->bytes = header.bytes;
+
+		tex->blocks = (unsigned char *)malloc( tex->bytes );
+		valid = tex->blocks && fread( tex->blocks, 1, tex->bytes, file ) == tex->bytes;
+	}
+
+	fclose( file );
+
+	if ( !valid ) {
+		fprintf( stderr, "Dropping the texture cache \"%s\"\n", path );
+		texcache_release( tex );
+		remove( path );
+		return ERR;
+	}
+
+	return OK;
+}
+
+static void 
+cache_write( const char *path, const texcache_t *tex )
+{
+	FILE		*file;
+	header_t	header;
+
+	make_dir( TEXCACHE_DIR );
+
+	fopen_s( &file, path, "wb" );
+	if ( !file ) {
+		fprintf( stderr, "Cannot write the texture cache \"%s\"\n", path );
+		return;
+	}
+
+	memcpy( header.magic, "RDFT", 4 );
+	header.version = TEXCACHE_VERSION;
+	header.width = tex->width;
+	header.height = tex->height;
+	header.levels = tex->levels;
+	header.bytes = tex->bytes;
+
+	fwrite( &header, sizeof(header), 1, file );
+	fwrite( tex->blocks, 1, tex->bytes, file );
+	fclose( file );
+}
+
+int 
+texcache_load( const char *path, const unsigned int width, const unsigned int height, const unsigned int format, texcache_t *tex )
+{
+	const unsigned int	fit[2] = { width, height };
+	unsigned char		*source, *img;
+	unsigned int		size;
+	unsigned long long	key;
+	char				cache[256];
+	int					w, h;
+
+	memset( tex, 0, sizeof(texcache_t) );
+	tex->format = format;
+
+	source = file_read( path, &size );
+	if ( !source ) {
+		fprintf( stderr, "File \"%s\" not found\n", path );
+		return ERR;
+	}
+
+	key = fnv( FNV_OFFSET, source, size );
+	key = fnv( key, (const unsigned char *)fit, sizeof(fit) );
+	_snprintf_s( cache, sizeof(cache), _TRUNCATE, TEXCACHE_DIR "%016llx.bc1", key );
+
+	if ( format == TEXCACHE_FORMAT && cache_read( cache, tex ) == OK ) {
+		free( source );
+		return OK;
+	}
+
+	img = SOIL_load_image_from_memory( source, size, &w, &h, 0, SOIL_LOAD_RGB );
+	free( source );
+	if ( !img ) {
+		fprintf( stderr, "Cannot decode \"%s\": %s\n", path, SOIL_last_result() );
+		return ERR;
+	}
+
+	/*SOIL allocates with malloc, so its images are freed like ours from here on; a dropped cache file cleared tex*/
+	tex->format = format;
+	tex->width = width ? width : (unsigned int)w;
+	tex->height = height ? height : (unsigned int)h;
+	if ( tex->width != (unsigned int)w || tex->height != (unsigned int)h ) {
+		img = image_fit( img, w, h, tex->width, tex->height );
+		if ( !img ) {
+			return ERR;
+		}
+	}
+
+	if ( transcode( img, tex ) != OK ) {
+		return ERR;
+	}
+
+	if ( format == TEXCACHE_FORMAT ) {
+		printf( "Transcoded \"%s\" to %u x %u BC1, %u levels, %u bytes\n", path, tex->width, tex->height, tex->levels, tex->bytes );
+		cache_write( cache, tex );
+	}
+
+	return OK;
+}
+
+void 
+texcache_release( texcache_t *tex )
+{
+	if ( tex->blocks ) {
+		free( tex->blocks );
+	}
+
+	memset( tex, 0, sizeof(texcache_t) );
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef __texcache_h_
+#define __texcache_h_
+
+#include "core.h"
+
+/*where transcoded textures are kept, relative to the working directory like the texture paths*/
+#define TEXCACHE_DIR		"../textures/cache/"
+
+/*the only block format written, 8 bytes per 4x4 texels of opaque rgb*/
+#define TEXCACHE_FORMAT		GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+/*3 bytes per texel, rows unpadded, for drivers without S3TC; decoded every time, never cached*/
+#define TEXCACHE_FORMAT_RGB	GL_RGB8
+
+/*
+	a texture as BC1 blocks with its full mip chain down to 1x1, level 0 first;
+	a level of w x h texels holds max( 1, w / 4 ) * max( 1, h / 4 ) blocks, rounded up,
+	or w * h rgb texels in TEXCACHE_FORMAT_RGB
+*/
+typedef struct
+{
+	unsigned int	format;
+	unsigned int	width;
+	unsigned int	height;
+	unsigned int	levels;
+
+	unsigned char	*blocks;
+	unsigned int	bytes;
+} texcache_t;
+
+/*
+	the texture at path in format, resized to width x height or at its own size when those
+	are 0; in TEXCACHE_FORMAT it is read from TEXCACHE_DIR when a file made from the same
+	source bytes and size is there, otherwise decoded, transcoded and written there for
+	the next run
+*/
+int				texcache_load( const char *path, const unsigned int width, const unsigned int height, const unsigned int format, texcache_t *tex );
+void			texcache_release( texcache_t *tex );
+
+/* bytes of one level of a width x height texture in format */
+unsigned int	texcache_level_bytes( const unsigned int format, const unsigned int width, const unsigned int height );
+
+#endif/*__texcache_h_*/
\ No newline at end of file
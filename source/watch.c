@@ -0,0 +1,221 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core.h"
+#include "watch.h"
+
+#ifdef _WIN32
+	#include <windows.h>
+
+	typedef HANDLE				thread_t;
+	typedef CRITICAL_SECTION	lock_t;
+
+	#define lock_init( l )		InitializeCriticalSection( l )
+	#define lock_free( l )		DeleteCriticalSection( l )
+	#define lock_enter( l )		EnterCriticalSection( l )
+	#define lock_leave( l )		LeaveCriticalSection( l )
+#else
+	#include <pthread.h>
+	#include <unistd.h>
+	#include <poll.h>
+	#include <sys/inotify.h>
+
+	typedef pthread_t			thread_t;
+	typedef pthread_mutex_t		lock_t;
+
+	#define lock_init( l )		pthread_mutex_init( l, NULL )
+	#define lock_free( l )		pthread_mutex_destroy( l )
+	#define lock_enter( l )		pthread_mutex_lock( l )
+	#define lock_leave( l )		pthread_mutex_unlock( l )
+#endif/*_WIN32*/
+
+/*how long the thread waits for changes before it looks at quit again*/
+#define WATCH_TIMEOUT_MS	100
+#define WATCH_SUFFIX		16
+
+struct watch_s
+{
+	thread_t	thread;
+	lock_t		lock;
+	bool		changed;
+	bool		quit;
+	char		suffix[WATCH_SUFFIX];
+
+#ifdef _WIN32
+	HANDLE		handle;
+#else
+	int			fd;
+#endif
+};
+
+/*****************************************************************************/
+/*locals*/
+static bool 
+watch_quit( watch_t *watch )
+{
+	bool quit;
+
+	lock_enter( &watch->lock );
+	quit = watch->quit;
+	lock_leave( &watch->lock );
+
+	return quit;
+}
+
+static void 
+watch_note( watch_t *watch )
+{
+	lock_enter( &watch->lock );
+	watch->changed = TRUE;
+	lock_leave( &watch->lock );
+}
+
+#ifdef _WIN32
+/* change notifications carry no names, every write in the directory counts */
+static DWORD WINAPI 
+watch_main( LPVOID arg )
+{
+	watch_t *watch = (watch_t *)arg;
+
+	while ( !watch_quit( watch ) ) {
+		if ( WaitForSingleObject( watch->handle, WATCH_TIMEOUT_MS ) == WAIT_OBJECT_0 ) {
+			watch_note( watch );
+			FindNextChangeNotification( watch->handle );
+		}
+	}
+
+	return 0;
+}
+#else
+static bool 
+watch_suffix( const watch_t *watch, const char *name )
+{
+	size_t len = strlen( name ), suffix = strlen( watch->suffix );
+
+	return len >= suffix && strcmp( name + len - suffix, watch->suffix ) == 0;
+}
+
+static void* 
+watch_main( void *arg )
+{
+	watch_t						*watch = (watch_t *)arg;
+	char						events[4096];
+	const struct inotify_event	*event;
+	struct pollfd				fds;
+	ssize_t						size, pos;
+
+	fds.fd = watch->fd;
+	fds.events = POLLIN;
+
+	while ( !watch_quit( watch ) ) {
+		if ( poll( &fds, 1, WATCH_TIMEOUT_MS ) <= 0 ) {
+			continue;
+		}
+
+		size = read( watch->fd, events, sizeof(events) );
+		for ( pos = 0; pos < size; pos += sizeof(struct inotify_event) + event->len ) {
+			event = (const struct inotify_event *)( events + pos );
+			if ( event->len && watch_suffix( watch, event->name ) ) {
+				watch_note( watch );
+			}
+		}
+	}
+
+	return NULL;
+}
+#endif
+
+/*****************************************************************************/
+/*exports*/
+watch_t* 
+watch_create( const char *dir, const char *suffix )
+{
+	watch_t	*watch;
+	bool	started;
+
+	watch = (watch_t *)calloc( 1, sizeof(watch_t) );
+	if ( !watch ) {
+		return NULL;
+	}
+
+	strncpy_s( watch->suffix, WATCH_SUFFIX, suffix, _TRUNCATE );
+
+#ifdef _WIN32
+	watch->handle = FindFirstChangeNotificationA( dir, FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME );
+	if ( watch->handle == INVALID_HANDLE_VALUE ) {
+		free( watch );
+		return NULL;
+	}
+#else
+	/*editors either write the file in place or move a new one over it*/
+	watch->fd = inotify_init();
+	if ( watch->fd < 0 || inotify_add_watch( watch->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO ) < 0 ) {
+		if ( watch->fd >= 0 ) {
+			close( watch->fd );
+		}
+		free( watch );
+		return NULL;
+	}
+#endif
+
+	lock_init( &watch->lock );
+
+#ifdef _WIN32
+	watch->thread = CreateThread( NULL, 0, watch_main, watch, 0, NULL );
+	started = watch->thread != NULL;
+#else
+	started = pthread_create( &watch->thread, NULL, watch_main, watch ) == 0;
+#endif
+
+	if ( !started ) {
+		lock_free( &watch->lock );
+#ifdef _WIN32
+		FindCloseChangeNotification( watch->handle );
+#else
+		close( watch->fd );
+#endif
+		free( watch );
+		return NULL;
+	}
+
+	return watch;
+}
+
+void 
+watch_destroy( watch_t *watch )
+{
+	if ( !watch ) {
+		return;
+	}
+
+	lock_enter( &watch->lock );
+	watch->quit = TRUE;
+	lock_leave( &watch->lock );
+
+#ifdef _WIN32
+	WaitForSingleObject( watch->thread, INFINITE );
+	CloseHandle( watch->thread );
+	FindCloseChangeNotification( watch->handle );
+#else
+	pthread_join( watch->thread, NULL );
+	close( watch->fd );
+#endif
+
+	lock_free( &watch->lock );
+
+	free( watch );
+}
+
+bool 
+watch_changed( watch_t *watch )
+{
+	bool changed;
+
+	lock_enter( &watch->lock );
+	changed = watch->changed;
+	watch->changed = FALSE;
+	lock_leave( &watch->lock );
+
+	return changed;
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#ifndef __watch_h_
+#define __watch_h_
+
+#include "core.h"
+
+typedef struct watch_s watch_t;
+
+/*
+	a thread noting every file in dir that is written or moved in, of the ones ending in
+	suffix where the platform tells names apart; NULL when files can not be watched
+*/
+watch_t*	watch_create( const char *dir, const char *suffix );
+void		watch_destroy( watch_t *watch );
+
+/* TRUE once for any number of writes since the last call, never waits */
+bool		watch_changed( watch_t *watch );
+
+#endif/*__watch_h_*/
\ No newline at end of file